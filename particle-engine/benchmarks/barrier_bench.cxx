@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <string>
+using namespace std::string_literals;
+
+#pragma warning(disable : 4275)
+#include <fmt/format.h>
+#pragma warning(default : 4275)
+
+#include "utility/barrier.hxx"
+#include "utility/spin_wait.hxx"
+
+
+namespace
+{
+    struct options final {
+        std::uint32_t rounds{20'000};
+
+        // Doubles up to it from two.
+        std::uint32_t max_threads{64};
+
+        // Of the timed runs.
+        std::uint32_t threads{std::max(std::thread::hardware_concurrency(), 2u)};
+
+        // ns spun between waits by the last thread, proportionally less by the others.
+        std::int64_t work{20'000};
+    };
+
+    std::int64_t now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    template<class T>
+    T parse_value(std::string_view name, std::string_view value)
+    {
+        T result{};
+
+        if (auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result); ec != std::errc{} || ptr != value.data() + value.size())
+            throw std::invalid_argument(fmt::format("invalid value '{}' for '{}'"s, value, name));
+
+        return result;
+    }
+
+    options parse_options(int argc, char **argv)
+    {
+        options options;
+
+        for (auto i = 1; i < argc; ++i) {
+            std::string_view argument{argv[i]};
+
+            auto separator = argument.find('=');
+
+            if (separator == std::string_view::npos)
+                throw std::invalid_argument(fmt::format("expected '--name=value', got '{}'"s, argument));
+
+            auto name = argument.substr(0, separator);
+            auto value = argument.substr(separator + 1);
+
+            if (name == "--rounds")
+                options.rounds = std::max(parse_value<std::uint32_t>(name, value), 1u);
+
+            else if (name == "--max-threads")
+                options.max_threads = std::max(parse_value<std::uint32_t>(name, value), 2u);
+
+            else if (name == "--threads")
+                options.threads = std::max(parse_value<std::uint32_t>(name, value), 1u);
+
+            else if (name == "--work")
+                options.work = parse_value<std::int64_t>(name, value);
+
+            else throw std::invalid_argument(fmt::format("unknown option '{}'"s, name));
+        }
+
+        return options;
+    }
+
+    // Every thread has to see the others at its round or the next. Returns the violations.
+    std::uint64_t stress(utility::barrier_kind kind, std::uint32_t threads_count, std::uint32_t rounds)
+    {
+        struct alignas(64) progress final {
+            std::atomic_uint32_t round{0};
+        };
+
+        auto progresses = std::make_unique<progress[]>(threads_count);
+
+        utility::barrier barrier{threads_count, kind};
+
+        std::atomic_uint64_t violations{0};
+
+        std::vector<std::thread> threads;
+
+        for (auto thread = 0u; thread < threads_count; ++thread) {
+            threads.emplace_back([&, thread]
+            {
+                for (auto round = 0u; round < rounds; ++round) {
+                    progresses[thread].round.store(round, std::memory_order_relaxed);
+
+                    barrier.wait(thread);
+
+                    for (auto other = 0u; other < threads_count; ++other) {
+                        auto const other_round = progresses[other].round.load(std::memory_order_relaxed);
+
+                        if (other_round != round && other_round != round + 1)
+                            violations.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+            });
+        }
+
+        for (auto &&thread : threads)
+            thread.join();
+
+        for (auto &&statistics : barrier.statistics()) {
+            if (statistics.waits_count != rounds)
+                violations.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        return violations.load();
+    }
+
+    // A dropped barrier releases every wait, present and future.
+    bool drop(utility::barrier_kind kind, std::uint32_t threads_count)
+    {
+        utility::barrier barrier{threads_count + 1, kind};
+
+        std::atomic_uint32_t released{0};
+
+        std::vector<std::thread> threads;
+
+        for (auto thread = 0u; thread < threads_count; ++thread) {
+            threads.emplace_back([&]
+            {
+                barrier.wait();
+
+                for (auto round = 0u; round < 100; ++round)
+                    barrier.wait();
+
+                released.fetch_add(1);
+            });
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds{20});
+
+        auto const early = released.load() != 0;
+
+        barrier.drop();
+
+        auto const deadline = now() + std::chrono::nanoseconds{std::chrono::seconds{5}}.count();
+
+        while (released.load() != threads_count && now() < deadline)
+            std::this_thread::yield();
+
+        // They would block the joins for good.
+        if (released.load() != threads_count) {
+            std::cerr << fmt::format("drop: {} of {} threads still waiting on a {} barrier\n"s, threads_count - released.load(), threads_count, utility::to_string(kind));
+            std::quick_exit(1);
+        }
+
+        for (auto &&thread : threads)
+            thread.join();
+
+        return !early;
+    }
+
+    void spin_for(std::int64_t ns) noexcept
+    {
+        for (auto const until = now() + ns; now() < until;)
+            utility::cpu_relax();
+    }
+
+    struct timing_result final {
+        double round_ns{0};
+
+        std::vector<utility::barrier_statistics> statistics;
+    };
+
+    timing_result time_rounds(utility::barrier_kind kind, std::uint32_t threads_count, std::uint32_t rounds, std::int64_t work)
+    {
+        utility::barrier barrier{threads_count, kind};
+
+        std::vector<std::thread> threads;
+
+        auto const start = now();
+
+        for (auto thread = 0u; thread < threads_count; ++thread) {
+            threads.emplace_back([&barrier, thread, threads_count, rounds, work]
+            {
+                auto const thread_work = work * (thread + 1) / threads_count;
+
+                for (auto round = 0u; round < rounds; ++round) {
+                    spin_for(thread_work);
+                    barrier.wait(thread);
+                }
+            });
+        }
+
+        for (auto &&thread : threads)
+            thread.join();
+
+        return timing_result{static_cast<double>(now() - start) / rounds, barrier.statistics()};
+    }
+
+    double to_us(std::int64_t ns)
+    {
+        return static_cast<double>(ns) * 1e-3;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    options options;
+
+    try {
+        options = parse_options(argc, argv);
+    }
+
+    catch (std::invalid_argument const &error) {
+        std::cerr << fmt::format("{}\nusage: barrier_bench [--rounds=N] [--max-threads=N] [--threads=N] [--work=ns]\n"s, error.what());
+        return 1;
+    }
+
+    auto failed = false;
+
+    auto const kinds = {utility::barrier_kind::blocking, utility::barrier_kind::hybrid};
+
+    // Keeps the oversubscribed runs short.
+    for (auto threads_count = 2u; threads_count <= options.max_threads; threads_count *= 2) {
+        auto const rounds = std::max(options.rounds * 2 / threads_count, 100u);
+
+        for (auto kind : kinds) {
+            auto const violations = stress(kind, threads_count, rounds);
+
+            std::cout << fmt::format("stress {:>8}: {:>4} threads, {:>6} rounds, {} violations\n"s, utility::to_string(kind), threads_count, rounds, violations);
+
+            failed = failed || violations != 0;
+        }
+    }
+
+    for (auto kind : kinds) {
+        auto const passed = drop(kind, std::min(options.max_threads, 16u));
+
+        std::cout << fmt::format("drop {:>10}: waiters released{}\n"s, utility::to_string(kind), passed ? ""s : ", but some before the drop"s);
+
+        failed = failed || !passed;
+    }
+
+    std::cout << fmt::format("\n{} threads, {} rounds, up to {} us of work between waits:\n"s, options.threads, options.rounds, to_us(options.work));
+    std::cout << fmt::format("{:>10} {:>12} {:>14} {:>14} {:>14} {:>14}\n"s, "kind", "us/round", "mean wait us", "max wait us", "mean skew us", "max skew us");
+
+    for (auto kind : kinds) {
+        auto const result = time_rounds(kind, options.threads, options.rounds, options.work);
+
+        utility::barrier_statistics total;
+
+        for (auto &&statistics : result.statistics) {
+            total.waits_count += statistics.waits_count;
+            total.total_wait += statistics.total_wait;
+            total.max_wait = std::max(total.max_wait, statistics.max_wait);
+            total.total_skew += statistics.total_skew;
+            total.max_skew = std::max(total.max_skew, statistics.max_skew);
+        }
+
+        auto const waits_count = static_cast<std::int64_t>(std::max(total.waits_count, std::uint64_t{1}));
+
+        std::cout << fmt::format("{:>10} {:>12.2f} {:>14.2f} {:>14.2f} {:>14.2f} {:>14.2f}\n"s, utility::to_string(kind), result.round_ns * 1e-3,
+                                 to_us(total.total_wait / waits_count), to_us(total.max_wait), to_us(total.total_skew / waits_count), to_us(total.max_skew));
+    }
+
+    return failed ? 1 : 0;
+}
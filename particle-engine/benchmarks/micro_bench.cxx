@@ -0,0 +1,1176 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include <string>
+using namespace std::string_literals;
+
+#pragma warning(disable : 4275)
+#include <fmt/format.h>
+#pragma warning(default : 4275)
+
+#include "particle_engine.hxx"
+#include "simulation/integrate.hxx"
+#include "utility/barrier.hxx"
+#include "utility/spin_wait.hxx"
+#include "utility/triple_buffer.hxx"
+
+
+namespace
+{
+    struct options final {
+        // One run per entry and workers count.
+        std::vector<std::uint32_t> counts{16'384, app::DEFAULT_PARTICLES_CAPACITY};
+
+        // Pool workers, barrier threads and frame exchange pairs.
+        std::vector<std::uint32_t> workers{1, app::particle_engine::default_workers_count()};
+
+        // The rest of the 'process_particles' input dies.
+        float survival{.9f};
+        float explosion{.01f};
+
+        // Per barrier thread and frame exchange pair.
+        std::uint32_t sync_operations{10'000};
+
+        double min_time{.2}; // s, per benchmark
+
+        std::string filter;
+
+        // Google Benchmark compatible, for its 'compare.py'.
+        std::string json_path;
+    };
+
+    struct benchmark_result final {
+        std::string name;
+
+        std::uint64_t iterations{0};
+
+        double real_time{0}; // ns per iteration
+        double cpu_time{0}; // ns per iteration, all threads
+        double min_real_time{0}; // ns, the fastest iteration
+
+        double items_per_second{0};
+    };
+
+    template<class T>
+    T parse_value(std::string_view name, std::string_view value)
+    {
+        T result{};
+
+        if (auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result); ec != std::errc{} || ptr != value.data() + value.size())
+            throw std::invalid_argument(fmt::format("invalid value '{}' for '{}'"s, value, name));
+
+        return result;
+    }
+
+    std::vector<std::uint32_t> parse_list(std::string_view name, std::string_view value)
+    {
+        std::vector<std::uint32_t> list;
+
+        for (std::size_t begin = 0, end = 0; begin <= value.size(); begin = end + 1) {
+            end = std::min(value.find(',', begin), value.size());
+            list.push_back(std::max(parse_value<std::uint32_t>(name, value.substr(begin, end - begin)), 1u));
+        }
+
+        return list;
+    }
+
+    options parse_options(int argc, char **argv)
+    {
+        options options;
+
+        for (auto i = 1; i < argc; ++i) {
+            std::string_view argument{argv[i]};
+
+            auto separator = argument.find('=');
+
+            if (separator == std::string_view::npos)
+                throw std::invalid_argument(fmt::format("expected '--name=value', got '{}'"s, argument));
+
+            auto name = argument.substr(0, separator);
+            auto value = argument.substr(separator + 1);
+
+            if (name == "--counts")
+                options.counts = parse_list(name, value);
+
+            else if (name == "--workers")
+                options.workers = parse_list(name, value);
+
+            else if (name == "--survival")
+                options.survival = parse_value<float>(name, value);
+
+            else if (name == "--explosion")
+                options.explosion = parse_value<float>(name, value);
+
+            else if (name == "--sync-operations")
+                options.sync_operations = std::max(parse_value<std::uint32_t>(name, value), 1u);
+
+            else if (name == "--min-time")
+                options.min_time = parse_value<double>(name, value);
+
+            else if (name == "--filter")
+                options.filter = value;
+
+            else if (name == "--json")
+                options.json_path = value;
+
+            else throw std::invalid_argument(fmt::format("unknown option '{}'"s, name));
+        }
+
+        if (options.survival < 0.f || options.explosion < 0.f || options.survival + options.explosion > 1.f)
+            throw std::invalid_argument("'--survival' and '--explosion' must be non-negative and add up to at most 1"s);
+
+        std::sort(std::begin(options.workers), std::end(options.workers));
+        options.workers.erase(std::unique(std::begin(options.workers), std::end(options.workers)), std::end(options.workers));
+
+        return options;
+    }
+
+    // After one untimed warm-up call.
+    template<class F>
+    benchmark_result measure(std::string name, double items_per_iteration, double min_time, F &&iteration)
+    {
+        iteration();
+
+        benchmark_result result{std::move(name)};
+        result.min_real_time = std::numeric_limits<double>::max();
+
+        auto const start = std::chrono::steady_clock::now();
+        auto const cpu_start = std::clock();
+
+        auto elapsed = 0.;
+
+        do {
+            auto const iteration_start = std::chrono::steady_clock::now();
+
+            iteration();
+
+            auto const iteration_end = std::chrono::steady_clock::now();
+
+            result.min_real_time = std::min(result.min_real_time, std::chrono::duration<double, std::nano>(iteration_end - iteration_start).count());
+
+            elapsed = std::chrono::duration<double>(iteration_end - start).count();
+
+            ++result.iterations;
+        } while (elapsed < min_time);
+
+        auto const iterations = static_cast<double>(result.iterations);
+
+        result.real_time = elapsed * 1e9 / iterations;
+        result.cpu_time = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC * 1e9 / iterations;
+        result.items_per_second = items_per_iteration * iterations / elapsed;
+
+        return result;
+    }
+
+    class xorshift final {
+    public:
+
+        explicit xorshift(std::uint32_t seed) : state{seed != 0 ? seed : 1u} { }
+
+        // xorshift32
+        float operator() () noexcept
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+
+            return static_cast<float>(state >> 8) * 0x1p-24f;
+        }
+
+    private:
+
+        std::uint32_t state;
+    };
+
+    enum class fate : std::uint8_t {
+        survives,
+        explodes,
+        dies
+    };
+
+    // Exact shares of the fates, shuffled.
+    std::vector<fate> make_fates(std::uint32_t count, float survival, float explosion)
+    {
+        auto const survivors_count = static_cast<std::uint32_t>(std::lround(static_cast<double>(count) * static_cast<double>(survival)));
+        auto const exploders_count = std::min(count - survivors_count, static_cast<std::uint32_t>(std::lround(static_cast<double>(count) * static_cast<double>(explosion))));
+
+        std::vector<fate> fates(count, fate::dies);
+
+        std::fill_n(std::begin(fates), survivors_count, fate::survives);
+        std::fill_n(std::begin(fates) + survivors_count, exploders_count, fate::explodes);
+
+        xorshift next{1};
+
+        for (auto i = count; i > 1; --i)
+            std::swap(fates[i - 1], fates[std::min(static_cast<std::uint32_t>(next() * static_cast<float>(i)), i - 1)]);
+
+        return fates;
+    }
+
+    // The first particle of the 'type'-th of 'types_count' even groups.
+    std::uint32_t type_offset(std::uint32_t count, std::uint32_t types_count, std::uint32_t type)
+    {
+        return static_cast<std::uint32_t>(std::uint64_t{count} * std::min(type, types_count) / types_count);
+    }
+
+    // Nothing for the types that vanish or cascade.
+    std::uint32_t explosion_count(std::uint32_t type)
+    {
+        return app::effect_types::visit(type, [] <class T> ()
+        {
+            if constexpr (T::on_death::kind == simulation::death_kind::explode)
+                return T::on_death::burst::count;
+
+            else return 0u;
+        });
+    }
+
+    // Split over 'types_count' types.
+    std::uint32_t output_count(std::vector<fate> const &fates, std::uint32_t types_count)
+    {
+        auto const count = static_cast<std::uint32_t>(fates.size());
+
+        auto output = 0u;
+
+        for (auto type = 0u; type < types_count; ++type) {
+            for (auto i = type_offset(count, types_count, type); i < type_offset(count, types_count, type + 1); ++i)
+                output += fates[i] == fate::survives ? 1u : fates[i] == fate::explodes ? explosion_count(type) : 0u;
+        }
+
+        return output;
+    }
+}
+
+namespace app
+{
+    // Runs one stage of a hand made step context, a step tag per run.
+    class micro_bench_access final {
+    public:
+
+        explicit micro_bench_access(app::particle_engine &engine) : engine{engine}
+        {
+            task = jobs::make_task(
+                [this] (std::uint32_t begin, std::uint32_t end, std::uint32_t worker_index)
+                {
+                    for (auto block = begin; block < end; ++block)
+                        body(block, worker_index);
+                },
+                [this] (std::uint32_t)
+                {
+                    done.store(true, std::memory_order_release);
+                }
+            );
+
+            auto &&step = engine.step;
+
+            step.read_frame_index = 0;
+            step.write_frame_index = 1;
+            step.read_frame = &engine.frames_data.at(0);
+            step.write_frame = &engine.frames_data.at(1);
+
+            step.from_start_time = std::chrono::seconds{100};
+            step.dt = std::chrono::milliseconds{1};
+
+            step.random_key = math::philox::key_type{1, particle_engine::RANDOM_SEED};
+        }
+
+        // In blocks of 'EFFECTS_PER_SPAWN_BLOCK' effects.
+        void prepare_spawn(std::uint32_t count)
+        {
+            auto &&step = engine.step;
+
+            step.effects.clear();
+
+            for (auto spawned = 0u; spawned < count; spawned += PER_EFFECT_PARTICLES_COUNT) {
+                auto const sequence = static_cast<std::uint32_t>(step.effects.size());
+
+                step.effects.push_back(app::effect{std::min(PER_EFFECT_PARTICLES_COUNT, count - spawned), sequence,
+                                                   glm::vec2{512.f, 384.f}, glm::vec4{1.f, .5f, .25f, 1.f}});
+            }
+
+            auto const effects_count = static_cast<std::uint32_t>(step.effects.size());
+            auto const spawn_blocks_count = std::max(1u, (effects_count + EFFECTS_PER_SPAWN_BLOCK - 1) / EFFECTS_PER_SPAWN_BLOCK);
+
+            // All of them of the first type.
+            for (auto &&blocks : step.types)
+                blocks = step_context::type_blocks{spawn_blocks_count, spawn_blocks_count, spawn_blocks_count, effects_count, effects_count};
+
+            step.types.front() = step_context::type_blocks{0, spawn_blocks_count, spawn_blocks_count, 0, effects_count};
+            step.blocks_count = spawn_blocks_count;
+
+            blocks_count = spawn_blocks_count;
+            preceding_block = false;
+
+            body = [this] (std::uint32_t block, std::uint32_t worker_index)
+            {
+                this->engine.process_block(this->engine.worker_contexts[worker_index], block);
+            };
+        }
+
+        // A particle per fate, ids picked to match the explosion draw.
+        void prepare_process(std::vector<fate> const &fates, std::uint32_t types_count = 1)
+        {
+            auto &&step = engine.step;
+
+            step.effects.clear();
+            auto const count = static_cast<std::uint32_t>(fates.size());
+
+            auto &&read_frame = engine.frames_data.at(0);
+            auto &&particles = read_frame.particles;
+
+            read_frame.particles_count = count;
+
+            step.degradation = {};
+
+            // An empty spawn block, then the simulate blocks.
+            for (auto type = 0u, block = 1u; type < app::effect_types::count; ++type) {
+                read_frame.type_offsets[type] = type_offset(count, types_count, type);
+                read_frame.type_offsets[type + 1] = type_offset(count, types_count, type + 1);
+
+                auto const simulate_begin = block;
+
+                block += (read_frame.type_offsets[type + 1] - read_frame.type_offsets[type] + PARTICLES_CHUNK_SIZE - 1) / PARTICLES_CHUNK_SIZE;
+
+                step.types[type] = step_context::type_blocks{type == 0 ? 0 : simulate_begin, simulate_begin, block, 0, 0};
+                step.blocks_count = block;
+            }
+
+            xorshift next{1};
+
+            auto const compact = particles.layout() == simulation::storage_layout::compact;
+
+            if (compact)
+                engine.palette[0] = 0xFF'40'80'FF;
+
+            auto candidate = 0u;
+
+            for (auto i = 0u; i < count; ++i) {
+                auto const alive = fates[i] == fate::survives;
+                auto const exploding = fates[i] == fate::explodes;
+
+                auto const x = next() * static_cast<float>(app::SCREEN_WIDTH);
+                auto const y = next() * static_cast<float>(app::SCREEN_HEIGHT);
+                auto const vx = next() * 100.f - 50.f;
+                auto const vy = next() * 100.f - 50.f;
+
+                auto const death_time = (step.from_start_time + (alive ? std::chrono::seconds{10} : -std::chrono::seconds{10})).count();
+
+                if (compact) {
+                    particles.packed_x[i] = particle_engine::pack_position_x(x);
+                    particles.packed_y[i] = particle_engine::pack_position_y(y);
+                    particles.packed_vx[i] = simulation::pack_half(vx);
+                    particles.packed_vy[i] = simulation::pack_half(vy);
+
+                    particles.death_tick[i] = simulation::pack_death_time(death_time);
+                    particles.palette_index[i] = 0;
+                }
+
+                else {
+                    particles.x[i] = x;
+                    particles.y[i] = y;
+                    particles.vx[i] = vx;
+                    particles.vy[i] = vy;
+
+                    particles.previous_x[i] = x;
+                    particles.previous_y[i] = y;
+
+                    particles.death_time[i] = death_time;
+                    particles.color[i] = 0xFF'40'80'FF;
+                }
+
+                // Nothing in place either way.
+                if (!alive && i < read_frame.type_offsets[1]) {
+                    while (explodes(candidate) != exploding)
+                        ++candidate;
+                }
+
+                particles.id[i] = candidate++;
+            }
+
+            read_frame.expiry->reset(++expiry_generation);
+            read_frame.expiry->insert(0, count, [this, &particles] (std::uint32_t i)
+            {
+                return particles.layout() == simulation::storage_layout::compact
+                     ? simulation::unpack_death_time(particles.death_tick[i], engine.step.from_start_time.count()) : particles.death_time[i];
+            });
+
+            blocks_count = step.blocks_count - 1;
+            preceding_block = true;
+
+            body = [this] (std::uint32_t block, std::uint32_t worker_index)
+            {
+                this->engine.process_block(this->engine.worker_contexts[worker_index], 1 + block);
+            };
+        }
+
+        // Aged bursts of the first type, a few dying this step. Returns the expected output.
+        std::uint32_t prepare_cull(std::uint32_t count, bool indexed)
+        {
+            using life_time = classic_effect::life_time;
+
+            prepare_process(std::vector<fate>(count, fate::survives));
+
+            auto &&step = engine.step;
+            auto &&particles = engine.frames_data.at(0).particles;
+
+            auto const now = step.from_start_time.count();
+            auto const dt = step.dt.count();
+
+            auto const min_life_time = static_cast<std::int64_t>(life_time::life_time(0.f));
+            auto const max_life_time = static_cast<std::int64_t>(life_time::life_time(1.f));
+
+            auto const bursts_count = (count + PER_EFFECT_PARTICLES_COUNT - 1) / PER_EFFECT_PARTICLES_COUNT;
+
+            xorshift next{2};
+
+            auto expected_count = 0u;
+
+            for (auto i = 0u; i < count; ++i) {
+                auto const burst = i / PER_EFFECT_PARTICLES_COUNT;
+                auto const age = static_cast<std::int64_t>((static_cast<double>(burst) + .5) / bursts_count * static_cast<double>(max_life_time));
+
+                // Those dying in an earlier step are gone.
+                auto const earliest = std::max(now - age + min_life_time, now - dt);
+                auto const latest = now - age + max_life_time;
+
+                particles.death_time[i] = earliest + static_cast<std::int64_t>(next() * static_cast<float>(latest - earliest));
+
+                expected_count += particles.death_time[i] >= now ? 1u : explodes(particles.id[i]) ? classic_effect::on_death::burst::count : 0u;
+            }
+
+            auto &&expiry = *engine.frames_data.at(0).expiry;
+
+            expiry.reset(++expiry_generation);
+
+            if (indexed)
+                expiry.insert(0, particles.death_time, count);
+
+            body = [this] (std::uint32_t block, std::uint32_t worker_index)
+            {
+                auto &&worker_context = this->engine.worker_contexts[worker_index];
+
+                worker_context.emitted.clear();
+
+                auto const output_count = this->engine.classify_particles<classic_effect, simulation::storage_layout::full>(worker_context, 1 + block, worker_context.emitted).first;
+
+                culled_output_count.fetch_add(output_count, std::memory_order_relaxed);
+            };
+
+            return expected_count;
+        }
+
+        // Returns how many particles an odd step and the next should move.
+        std::uint32_t prepare_integrate(std::uint32_t count, bool half_rate_old)
+        {
+            prepare_cull(count, true);
+
+            auto &&step = engine.step;
+            auto &&read_frame = engine.frames_data.at(0);
+            auto &&particles = read_frame.particles;
+
+            step.degradation.half_rate_old = half_rate_old;
+
+            if (read_frame.grid != nullptr)
+                particle_engine::build_grid(read_frame);
+
+            auto const old_life_time = static_cast<std::int64_t>(classic_effect::life_time::life_time(.5f)) / 2;
+
+            auto const old_count = half_rate_old && read_frame.grid != nullptr
+                                 ? static_cast<std::uint32_t>(std::count_if(particles.death_time, particles.death_time + count, [&step, old_life_time] (std::int64_t death_time)
+                                   {
+                                       return death_time - step.from_start_time.count() < old_life_time;
+                                   }))
+                                 : 0u;
+
+            integrated_x.resize(count);
+            integrated_y.resize(count);
+            integrated_vx.resize(count);
+            integrated_vy.resize(count);
+
+            body = [this] (std::uint32_t block, std::uint32_t worker_index)
+            {
+                auto &&worker_context = this->engine.worker_contexts[worker_index];
+
+                integrated_count.fetch_add(this->engine.integrate_particles<classic_effect, simulation::storage_layout::full>(worker_context, 1 + block), std::memory_order_relaxed);
+
+                // The other blocks may still be reading the frame.
+                if (write_back) {
+                    auto &&scratch = worker_context.scratch;
+
+                    auto const [begin, block_count] = this->engine.block_particles(0, 1 + block);
+
+                    std::copy_n(scratch.x, block_count, std::begin(integrated_x) + begin);
+                    std::copy_n(scratch.y, block_count, std::begin(integrated_y) + begin);
+                    std::copy_n(scratch.vx, block_count, std::begin(integrated_vx) + begin);
+                    std::copy_n(scratch.vy, block_count, std::begin(integrated_vy) + begin);
+                }
+            };
+
+            return 2 * count - old_count;
+        }
+
+        // Returns the particles an odd step and the next moved.
+        std::uint32_t integrate_pair()
+        {
+            auto &&step = engine.step;
+
+            if ((tag & 1) != 0)
+                run();
+
+            run();
+
+            auto const moved = integrated();
+
+            step.from_start_time += step.dt;
+            run();
+            step.from_start_time -= step.dt;
+
+            return moved + integrated();
+        }
+
+        // 'steps' steps of 'dt' on the frame; returns the final positions.
+        std::vector<glm::vec2> integrate_steps(std::uint32_t steps, std::chrono::nanoseconds dt)
+        {
+            auto &&step = engine.step;
+            auto &&read_frame = engine.frames_data.at(0);
+            auto &&particles = read_frame.particles;
+
+            auto const [from_start_time, previous_dt] = std::pair{step.from_start_time, step.dt};
+
+            step.dt = dt;
+            write_back = true;
+
+            for (auto i = 0u; i < steps; ++i) {
+                step.from_start_time += dt;
+                run();
+
+                std::copy(std::cbegin(integrated_x), std::cend(integrated_x), particles.x);
+                std::copy(std::cbegin(integrated_y), std::cend(integrated_y), particles.y);
+                std::copy(std::cbegin(integrated_vx), std::cend(integrated_vx), particles.vx);
+                std::copy(std::cbegin(integrated_vy), std::cend(integrated_vy), particles.vy);
+
+                if (read_frame.grid != nullptr)
+                    particle_engine::build_grid(read_frame);
+            }
+
+            write_back = false;
+
+            step.from_start_time = from_start_time;
+            step.dt = previous_dt;
+
+            std::vector<glm::vec2> positions;
+
+            for (auto i = 0u; i < read_frame.particles_count; ++i)
+                positions.emplace_back(particles.x[i], particles.y[i]);
+
+            return positions;
+        }
+
+        // 'count' draws in chunks.
+        void prepare_randomize(std::uint32_t count)
+        {
+            blocks_count = (count + PARTICLES_CHUNK_SIZE - 1) / PARTICLES_CHUNK_SIZE;
+            preceding_block = false;
+
+            body = [this, count] (std::uint32_t block, std::uint32_t worker_index)
+            {
+                auto &&scratch = this->engine.worker_contexts[worker_index].scratch;
+
+                for (auto i = block * PARTICLES_CHUNK_SIZE; i < std::min((block + 1) * PARTICLES_CHUNK_SIZE, count); ++i) {
+                    auto const k = i % PARTICLES_CHUNK_SIZE;
+
+                    this->engine.randomize_velocity_vector(particle_engine::EFFECT_STREAM, block, i, classic_effect::emission::speed,
+                                                           scratch.vx[k], scratch.vy[k], scratch.x[k]);
+                }
+            };
+        }
+
+        void run()
+        {
+            auto &&step = engine.step;
+
+            // As 'begin_step' does.
+            step.frozen_dt = step.degradation.half_rate_old && (step.step_tag & 1) != 0 ? step.dt : std::chrono::nanoseconds{0};
+            engine.set_drags();
+
+            step.step_tag = ++tag;
+
+            // Empty.
+            if (preceding_block) {
+                engine.block_births[0] = 0;
+                engine.block_offsets[0].store(std::uint64_t{tag} << 32, std::memory_order_release);
+            }
+
+            done.store(false, std::memory_order_relaxed);
+            culled_output_count.store(0, std::memory_order_relaxed);
+            integrated_count.store(0, std::memory_order_relaxed);
+
+            engine.pool->submit(*task, blocks_count);
+
+            while (!done.load(std::memory_order_acquire))
+                std::this_thread::yield();
+
+            for (auto &&worker_context : engine.worker_contexts)
+                worker_context.cascades.clear();
+        }
+
+        std::uint32_t output_count() const
+        {
+            return static_cast<std::uint32_t>(engine.block_offsets[engine.step.blocks_count - 1].load());
+        }
+
+        std::uint32_t culled_output() const
+        {
+            return culled_output_count.load();
+        }
+
+        std::uint32_t integrated() const
+        {
+            return integrated_count.load();
+        }
+
+        // Evicted particles of the last step, and whether they all die first.
+        std::pair<std::uint32_t, bool> last_eviction() const
+        {
+            auto &&step = engine.step;
+            auto &&read_particles = step.read_frame->particles;
+            auto &&write_frame = *step.write_frame;
+
+            std::vector<std::uint32_t> kept_ids(write_frame.particles.id, write_frame.particles.id + write_frame.particles_count);
+            std::sort(std::begin(kept_ids), std::end(kept_ids));
+
+            auto const cull_time = step.from_start_time.count() + step.degradation.cull_horizon;
+
+            auto evicted_count = 0u;
+
+            auto latest_evicted = std::numeric_limits<std::int64_t>::min();
+            auto earliest_kept = std::numeric_limits<std::int64_t>::max();
+
+            for (auto i = 0u; i < step.read_frame->particles_count; ++i) {
+                auto const death_time = read_particles.death_time[i];
+
+                if (death_time < cull_time || particle_engine::is_particle_outside(read_particles.x[i], read_particles.y[i]))
+                    continue;
+
+                if (std::binary_search(std::cbegin(kept_ids), std::cend(kept_ids), read_particles.id[i]))
+                    earliest_kept = std::min(earliest_kept, death_time);
+
+                else {
+                    latest_evicted = std::max(latest_evicted, death_time);
+                    ++evicted_count;
+                }
+            }
+
+            return {evicted_count, latest_evicted < earliest_kept};
+        }
+
+    private:
+
+        app::particle_engine &engine;
+
+        std::unique_ptr<jobs::task> task;
+        std::function<void(std::uint32_t, std::uint32_t)> body;
+
+        std::uint32_t blocks_count{0};
+        bool preceding_block{false};
+
+        std::uint32_t tag{0};
+        std::uint32_t expiry_generation{0};
+
+        std::atomic_bool done{false};
+        std::atomic_uint32_t culled_output_count{0};
+        std::atomic_uint32_t integrated_count{0};
+
+        bool write_back{false};
+
+        std::vector<float> integrated_x;
+        std::vector<float> integrated_y;
+        std::vector<float> integrated_vx;
+        std::vector<float> integrated_vy;
+
+        bool explodes(std::uint32_t id) const
+        {
+            auto const random = math::philox::generate(math::philox::counter_type{id, 0, particle_engine::DEATH_STREAM, 0}, engine.step.random_key);
+
+            return math::philox::to_unit_float(random[0]) < DEAD_PARTICLE_EXPLOSION_CHANCE;
+        }
+    };
+}
+
+namespace
+{
+    void print(benchmark_result const &result)
+    {
+        std::cout << fmt::format("{:<84}{:>14.0f} ns{:>14.0f} ns{:>12}{:>16.3f} M items/s\n"s,
+                                 result.name, result.real_time, result.min_real_time, result.iterations, result.items_per_second * 1e-6);
+    }
+
+    // px and px/s².
+    auto constexpr HALF_RATE_RADIUS = 4.f;
+    auto constexpr HALF_RATE_REPULSION = 20.f;
+
+    // About a second; a skipped step drifts further than this, px.
+    auto constexpr HALF_RATE_STEPS = 64u;
+    auto constexpr HALF_RATE_MAX_DRIFT = .2f;
+    auto constexpr HALF_RATE_DRIFT_REPULSION = .01f;
+
+    // 1 ms steps vs 5 ms; a drag by steps drifts tens of px, px.
+    auto constexpr STEP_RATE_STEPS = 1000u;
+    auto constexpr STEP_RATE_MAX_DRIFT = .5f;
+
+    // Effects per step, one per this many particles of capacity.
+    auto constexpr CAPACITY_EFFECTS_DIVISOR = 2048u;
+    auto constexpr CAPACITY_WARMUP_STEPS = 200u;
+    auto constexpr CAPACITY_CHECKED_STEPS = 50u;
+
+    void check_output(std::string const &name, std::uint32_t output_count, std::uint32_t expected_count, std::uint32_t &mismatches_count)
+    {
+        if (output_count == expected_count)
+            return;
+
+        std::cerr << fmt::format("{}: output {} particles, expected {}\n"s, name, output_count, expected_count);
+
+        ++mismatches_count;
+    }
+
+    std::vector<benchmark_result> run_engine_stages(options const &options, std::uint32_t count, std::uint32_t workers_count, std::uint32_t &mismatches_count)
+    {
+        std::vector<benchmark_result> results;
+
+        auto selected = [&options] (std::string const &name)
+        {
+            return options.filter.empty() || name.find(options.filter) != std::string::npos;
+        };
+
+        auto const fates = make_fates(count, options.survival, options.explosion);
+        auto const expected_count = output_count(fates, 1);
+        auto const mixed_expected_count = output_count(fates, app::effect_types::count);
+
+        // Room for every survivor and explosion.
+        app::engine_config config;
+        config.workers_count = workers_count;
+        config.capacity = std::max({count, expected_count, mixed_expected_count});
+        config.grow_on_demand = false;
+
+        app::particle_engine engine{config};
+        app::micro_bench_access access{engine};
+
+        auto const suffix = fmt::format("count:{}/workers:{}"s, count, workers_count);
+
+        if (auto name = "add_particles/"s + suffix; selected(name)) {
+            access.prepare_spawn(count);
+            results.push_back(measure(name, count, options.min_time, [&access] { access.run(); }));
+
+            check_output(name, access.output_count(), count, mismatches_count);
+        }
+
+        if (auto name = fmt::format("process_particles/{}/survival:{}/explosion:{}"s, suffix, options.survival, options.explosion); selected(name)) {
+            access.prepare_process(fates);
+            results.push_back(measure(name, count, options.min_time, [&access] { access.run(); }));
+
+            check_output(name, access.output_count(), expected_count, mismatches_count);
+        }
+
+        // Every type's blocks running its own kernel.
+        if (auto name = fmt::format("process_particles/{}/survival:{}/explosion:{}/types:{}"s, suffix, options.survival, options.explosion, app::effect_types::count);
+            app::effect_types::count > 1 && selected(name)) {
+            access.prepare_process(fates, app::effect_types::count);
+            results.push_back(measure(name, count, options.min_time, [&access] { access.run(); }));
+
+            check_output(name, access.output_count(), mixed_expected_count, mismatches_count);
+        }
+
+        // Quantized, in an engine of their own.
+        if (auto name = fmt::format("process_particles/{}/survival:{}/explosion:{}/storage:compact"s, suffix, options.survival, options.explosion); selected(name)) {
+            auto compact_config = config;
+            compact_config.storage = simulation::storage_layout::compact;
+
+            app::particle_engine compact_engine{compact_config};
+            app::micro_bench_access compact_access{compact_engine};
+
+            compact_access.prepare_process(fates);
+            results.push_back(measure(name, count, options.min_time, [&compact_access] { compact_access.run(); }));
+
+            check_output(name, compact_access.output_count(), expected_count, mismatches_count);
+        }
+
+        // The cull, with the expiry index and testing every particle.
+        for (auto indexed : {true, false}) {
+            if (auto name = fmt::format("cull_particles/{}/index:{}"s, suffix, indexed ? "on"s : "off"s); selected(name)) {
+                auto const expected_cull_count = access.prepare_cull(count, indexed);
+                results.push_back(measure(name, count, options.min_time, [&access] { access.run(); }));
+
+                check_output(name, access.culled_output(), expected_cull_count, mismatches_count);
+            }
+        }
+
+        // Repulsion, at the full rate and half rate; odd and even steps alternate.
+        if (auto name = fmt::format("integrate_particles/{}/repulsion"s, suffix); selected(name)) {
+            auto repulsion_config = config;
+            repulsion_config.interaction_radius = HALF_RATE_RADIUS;
+            repulsion_config.repulsion = HALF_RATE_REPULSION;
+
+            app::particle_engine repulsion_engine{repulsion_config};
+            app::micro_bench_access repulsion_access{repulsion_engine};
+
+            std::array<benchmark_result, 2> rates;
+
+            for (auto half_rate_old : {false, true}) {
+                auto const rate_name = fmt::format("{}/half_rate_old:{}"s, name, half_rate_old ? "on"s : "off"s);
+
+                auto const expected_moved_count = repulsion_access.prepare_integrate(count, half_rate_old);
+                rates[half_rate_old ? 1 : 0] = measure(rate_name, count, options.min_time, [&repulsion_access] { repulsion_access.run(); });
+
+                results.push_back(rates[half_rate_old ? 1 : 0]);
+
+                check_output(rate_name, repulsion_access.integrate_pair(), expected_moved_count, mismatches_count);
+            }
+
+            auto const time_ratio = rates[1].real_time / rates[0].real_time;
+
+            std::cout << fmt::format("{}: half_rate_old steps take {:.2f} of the full rate time\n"s, name, time_ratio);
+
+            if (time_ratio >= 1.) {
+                std::cerr << fmt::format("{}: half_rate_old saved no time\n"s, name);
+                ++mismatches_count;
+            }
+
+            // The half rate has to stay close to the full one.
+            auto drift_config = repulsion_config;
+            drift_config.repulsion = HALF_RATE_DRIFT_REPULSION;
+
+            app::particle_engine drift_engine{drift_config};
+            app::micro_bench_access drift_access{drift_engine};
+
+            auto constexpr dt = std::chrono::milliseconds{16};
+
+            drift_access.prepare_integrate(count, false);
+            auto const full_rate = drift_access.integrate_steps(HALF_RATE_STEPS, dt);
+
+            drift_access.prepare_integrate(count, true);
+            auto const half_rate = drift_access.integrate_steps(HALF_RATE_STEPS, dt);
+
+            auto max_drift = 0.f, total_drift = 0.f;
+
+            for (std::size_t i = 0; i < full_rate.size(); ++i) {
+                auto const drift = std::hypot(full_rate[i].x - half_rate[i].x, full_rate[i].y - half_rate[i].y);
+
+                max_drift = std::max(max_drift, drift);
+                total_drift += drift;
+            }
+
+            std::cout << fmt::format("{}: {} steps of {} ms, position drift px: mean {:.4f}, max {:.4f}\n"s, name, HALF_RATE_STEPS, dt.count(),
+                                     total_drift / static_cast<float>(std::max(full_rate.size(), std::size_t{1})), max_drift);
+
+            if (max_drift > HALF_RATE_MAX_DRIFT) {
+                std::cerr << fmt::format("{}: drifted up to {} px from the full rate, expected at most {} px\n"s, name, max_drift, HALF_RATE_MAX_DRIFT);
+                ++mismatches_count;
+            }
+        }
+
+        // At capacity every step evicts the soonest dying carried over particles only.
+        for (auto numa_aware : {false, true}) {
+            if (auto name = fmt::format("step_at_capacity/{}/numa:{}"s, suffix, numa_aware ? "on"s : "off"s); selected(name)) {
+                auto capacity_config = config;
+                capacity_config.capacity = count;
+                capacity_config.fixed_step = std::chrono::milliseconds{16};
+                capacity_config.numa_aware = numa_aware;
+                capacity_config.numa_nodes = numa_aware ? 2 : 0;
+
+                app::particle_engine capacity_engine{capacity_config};
+                app::micro_bench_access capacity_access{capacity_engine};
+
+                xorshift next{3};
+
+                auto const effects_per_type = std::max(count / CAPACITY_EFFECTS_DIVISOR, 1u);
+
+                auto step = [&capacity_engine, &capacity_config, &next, effects_per_type]
+                {
+                    for (auto type = 0u; type < app::effect_types::count; ++type) {
+                        for (auto e = 0u; e < effects_per_type; ++e) {
+                            capacity_engine.spawn_effect(glm::vec2{next() * static_cast<float>(app::SCREEN_WIDTH), next() * static_cast<float>(app::SCREEN_HEIGHT)},
+                                                         glm::vec4{1.f, .5f, .25f, 1.f}, type);
+                        }
+                    }
+
+                    capacity_engine.update(capacity_config.fixed_step);
+
+                    while (!capacity_engine.settled())
+                        std::this_thread::yield();
+                };
+
+                for (auto i = 0u; i < CAPACITY_WARMUP_STEPS; ++i)
+                    step();
+
+                results.push_back(measure(name, count, options.min_time, step));
+
+                auto evicted_count = std::uint64_t{0};
+                auto unordered_steps = 0u;
+
+                for (auto i = 0u; i < CAPACITY_CHECKED_STEPS; ++i) {
+                    auto const evicted_before = capacity_engine.spawn_stats().evicted;
+
+                    step();
+
+                    auto const [evicted, youngest_kept] = capacity_access.last_eviction();
+
+                    check_output(name + " evicted"s, static_cast<std::uint32_t>(capacity_engine.spawn_stats().evicted - evicted_before), evicted, mismatches_count);
+
+                    evicted_count += evicted;
+                    unordered_steps += youngest_kept ? 0u : 1u;
+                }
+
+                std::cout << fmt::format("{}: {} particles evicted over {} steps\n"s, name, evicted_count, CAPACITY_CHECKED_STEPS);
+
+                if (unordered_steps != 0 || evicted_count == 0) {
+                    std::cerr << fmt::format("{}: {} of {} steps kept a particle dying sooner than one they evicted, {} evicted in all\n"s,
+                                             name, unordered_steps, CAPACITY_CHECKED_STEPS, evicted_count);
+                    ++mismatches_count;
+                }
+            }
+        }
+
+        // The drag goes by time, so both step rates agree.
+        if (auto name = fmt::format("integrate_particles/{}/step_rate"s, suffix); selected(name)) {
+            access.prepare_integrate(count, false);
+            auto const fine = access.integrate_steps(STEP_RATE_STEPS, std::chrono::milliseconds{1});
+
+            access.prepare_integrate(count, false);
+            auto const coarse = access.integrate_steps(STEP_RATE_STEPS / 5, std::chrono::milliseconds{5});
+
+            auto max_drift = 0.f;
+
+            for (std::size_t i = 0; i < fine.size(); ++i)
+                max_drift = std::max(max_drift, std::hypot(fine[i].x - coarse[i].x, fine[i].y - coarse[i].y));
+
+            std::cout << fmt::format("{}: 1 ms and 5 ms steps over {} ms, position drift px: max {:.4f}\n"s, name, STEP_RATE_STEPS, max_drift);
+
+            if (max_drift > STEP_RATE_MAX_DRIFT) {
+                std::cerr << fmt::format("{}: 1 ms and 5 ms steps drifted {} px apart, expected at most {} px\n"s, name, max_drift, STEP_RATE_MAX_DRIFT);
+                ++mismatches_count;
+            }
+        }
+
+        if (auto name = "randomize_velocity_vector/"s + suffix; selected(name)) {
+            access.prepare_randomize(count);
+            results.push_back(measure(name, count, options.min_time, [&access] { access.run(); }));
+        }
+
+        return results;
+    }
+
+    // Both draws have to agree.
+    std::vector<benchmark_result> run_philox(options const &options, std::uint32_t count, std::uint32_t &mismatches_count)
+    {
+        std::vector<benchmark_result> results;
+
+        std::vector<std::uint32_t> ids(count);
+        std::vector<float> first(count), second(count), batch_first(count), batch_second(count);
+
+        for (auto i = 0u; i < count; ++i)
+            ids[i] = i * 7 + 3;
+
+        auto const key = math::philox::key_type{1, 0x5EED'0001};
+
+        auto draw = [&ids, &first, &second, key, count]
+        {
+            for (auto i = 0u; i < count; ++i) {
+                auto const random = math::philox::generate(math::philox::counter_type{ids[i], 0, 1, 0}, key);
+
+                first[i] = math::philox::to_unit_float(random[0]);
+                second[i] = math::philox::to_unit_float(random[1]);
+            }
+        };
+
+        auto draw_batch = [&ids, &batch_first, &batch_second, key, count]
+        {
+            math::philox::uniform_batch(ids.data(), count, 0, 1, key, batch_first.data(), batch_second.data());
+        };
+
+        auto const suffix = fmt::format("count:{}"s, count);
+
+        if (auto name = "philox_generate/"s + suffix; options.filter.empty() || name.find(options.filter) != std::string::npos)
+            results.push_back(measure(name, count, options.min_time, draw));
+
+        if (auto name = "philox_uniform_batch/"s + suffix; options.filter.empty() || name.find(options.filter) != std::string::npos) {
+            results.push_back(measure(name, count, options.min_time, draw_batch));
+
+            draw();
+
+            auto const differing = std::inner_product(std::cbegin(first), std::cend(first), std::cbegin(batch_first), 0u, std::plus<>{}, std::not_equal_to<>{}) +
+                                   std::inner_product(std::cbegin(second), std::cend(second), std::cbegin(batch_second), 0u, std::plus<>{}, std::not_equal_to<>{});
+
+            if (differing != 0) {
+                std::cerr << fmt::format("{}: {} draws differ from 'generate'\n"s, name, differing);
+                ++mismatches_count;
+            }
+        }
+
+        return results;
+    }
+
+    // A triple buffer per pair.
+    benchmark_result run_frame_exchange(options const &options, std::uint32_t pairs_count)
+    {
+        auto const operations = options.sync_operations;
+
+        auto iteration = [operations, pairs_count]
+        {
+            std::vector<std::thread> threads;
+
+            auto buffers = std::make_unique<utility::triple_buffer[]>(pairs_count);
+            auto payloads = std::make_unique<std::array<std::atomic_uint32_t, utility::triple_buffer::SLOTS_COUNT>[]>(pairs_count);
+
+            for (auto pair = 0u; pair < pairs_count; ++pair) {
+                threads.emplace_back([&buffer = buffers[pair], &payload = payloads[pair], operations]
+                {
+                    for (auto frame = 1u; frame <= operations; ++frame) {
+                        payload[buffer.back()].store(frame, std::memory_order_relaxed);
+                        buffer.publish();
+                    }
+                });
+
+                threads.emplace_back([&buffer = buffers[pair], &payload = payloads[pair], operations]
+                {
+                    for (utility::spin_wait spin_wait; payload[buffer.acquire()].load(std::memory_order_relaxed) != operations;)
+                        spin_wait();
+                });
+            }
+
+            for (auto &&thread : threads)
+                thread.join();
+        };
+
+        return measure(fmt::format("frame_exchange/operations:{}/pairs:{}"s, operations, pairs_count), static_cast<double>(operations) * pairs_count,
+                       options.min_time, iteration);
+    }
+
+    // Every thread passes the barrier 'operations' times.
+    benchmark_result run_barrier(options const &options, std::uint32_t threads_count, utility::barrier_kind kind)
+    {
+        auto const operations = options.sync_operations;
+
+        auto iteration = [operations, threads_count, kind]
+        {
+            utility::barrier barrier{threads_count, kind};
+
+            std::vector<std::thread> threads;
+
+            for (auto thread = 0u; thread < threads_count; ++thread) {
+                threads.emplace_back([&barrier, operations]
+                {
+                    for (auto round = 0u; round < operations; ++round)
+                        barrier.wait();
+                });
+            }
+
+            for (auto &&thread : threads)
+                thread.join();
+        };
+
+        return measure(fmt::format("barrier_wait/operations:{}/threads:{}/kind:{}"s, operations, threads_count, utility::to_string(kind)), operations,
+                       options.min_time, iteration);
+    }
+
+    void write_json(std::string const &path, std::vector<benchmark_result> const &results, char const *executable)
+    {
+        std::ofstream file{path};
+
+        auto const time = std::time(nullptr);
+
+        char date[32];
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&time));
+
+#ifdef NDEBUG
+        auto const build_type = "release"s;
+#else
+        auto const build_type = "debug"s;
+#endif
+
+        file << fmt::format("{{\n  \"context\": {{\n    \"date\": \"{}\",\n    \"executable\": \"{}\",\n    \"num_cpus\": {},\n"
+                            "    \"library_build_type\": \"{}\",\n    \"integration_isa\": \"{}\"\n  }},\n  \"benchmarks\": [\n"s,
+                            date, executable, std::thread::hardware_concurrency(), build_type, simulation::integration_isa());
+
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            auto &&result = results[i];
+
+            file << fmt::format("    {{\n      \"name\": \"{0}\",\n      \"run_name\": \"{0}\",\n      \"run_type\": \"iteration\",\n"
+                                "      \"iterations\": {1},\n      \"real_time\": {2:.3f},\n      \"cpu_time\": {3:.3f},\n      \"min_real_time\": {4:.3f},\n"
+                                "      \"time_unit\": \"ns\",\n      \"items_per_second\": {5:.3f}\n    }}{6}\n"s,
+                                result.name, result.iterations, result.real_time, result.cpu_time, result.min_real_time, result.items_per_second,
+                                i + 1 < results.size() ? ","s : ""s);
+        }
+
+        file << "  ]\n}\n";
+
+        if (!file)
+            throw std::runtime_error(fmt::format("failed to write '{}'"s, path));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    options options;
+
+    try {
+        options = parse_options(argc, argv);
+    }
+
+    catch (std::invalid_argument const &error) {
+        std::cerr << fmt::format("{}\nusage: micro_bench [--counts=N[,N...]] [--workers=N[,N...]] [--survival=0..1] [--explosion=0..1] [--sync-operations=N] [--min-time=s] [--filter=text] [--json=path]\n"s, error.what());
+        return 1;
+    }
+
+    std::cout << fmt::format("{:<84}{:>17}{:>17}{:>12}{:>26}\n"s, "benchmark"s, "time"s, "min"s, "iterations"s, "throughput"s);
+
+    std::vector<benchmark_result> results;
+
+    auto mismatches_count = 0u;
+
+    auto collect = [&results] (benchmark_result result)
+    {
+        print(result);
+        results.push_back(std::move(result));
+    };
+
+    for (auto count : options.counts) {
+        for (auto workers_count : options.workers) {
+            for (auto &&result : run_engine_stages(options, count, workers_count, mismatches_count))
+                collect(std::move(result));
+        }
+
+        for (auto &&result : run_philox(options, count, mismatches_count))
+            collect(std::move(result));
+    }
+
+    for (auto workers_count : options.workers) {
+        if (auto name = fmt::format("frame_exchange/operations:{}/pairs:{}"s, options.sync_operations, workers_count); options.filter.empty() || name.find(options.filter) != std::string::npos)
+            collect(run_frame_exchange(options, workers_count));
+
+        for (auto kind : {utility::barrier_kind::blocking, utility::barrier_kind::hybrid}) {
+            if (auto name = fmt::format("barrier_wait/operations:{}/threads:{}/kind:{}"s, options.sync_operations, workers_count, utility::to_string(kind));
+                options.filter.empty() || name.find(options.filter) != std::string::npos)
+                collect(run_barrier(options, workers_count, kind));
+        }
+    }
+
+    if (!options.json_path.empty())
+        write_json(options.json_path, results, argv[0]);
+
+    return mismatches_count == 0 ? 0 : 1;
+}
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <array>
+#include <vector>
+
+#include <string>
+using namespace std::string_literals;
+
+#pragma warning(disable : 4275)
+#include <fmt/format.h>
+#pragma warning(default : 4275)
+
+#include "gfx/software_rasterizer.hxx"
+#include "jobs/job_system.hxx"
+#include "screen.hxx"
+
+
+namespace
+{
+    struct resolution final {
+        std::uint32_t width;
+        std::uint32_t height;
+    };
+
+    struct options final {
+        std::uint32_t particles{131'072};
+
+        // One run per entry.
+        std::vector<std::uint32_t> workers{std::max(std::thread::hardware_concurrency(), 1u)};
+
+        std::uint32_t tile_size{64};
+        std::uint32_t frames{20};
+
+        bool depth_test{true};
+
+        std::uint32_t seed{1};
+
+        // If not empty, the frame of the first run at every resolution.
+        std::string image_prefix;
+    };
+
+    auto constexpr RESOLUTIONS = std::array{resolution{1024, 768}, resolution{3840, 2160}};
+
+    template<class T>
+    T parse_value(std::string_view name, std::string_view value)
+    {
+        T result{};
+
+        if (auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result); ec != std::errc{} || ptr != value.data() + value.size())
+            throw std::invalid_argument(fmt::format("invalid value '{}' for '{}'"s, value, name));
+
+        return result;
+    }
+
+    options parse_options(int argc, char **argv)
+    {
+        options options;
+
+        for (auto i = 1; i < argc; ++i) {
+            std::string_view argument{argv[i]};
+
+            auto separator = argument.find('=');
+
+            if (separator == std::string_view::npos)
+                throw std::invalid_argument(fmt::format("expected '--name=value', got '{}'"s, argument));
+
+            auto name = argument.substr(0, separator);
+            auto value = argument.substr(separator + 1);
+
+            if (name == "--particles")
+                options.particles = parse_value<std::uint32_t>(name, value);
+
+            else if (name == "--workers") {
+                options.workers.clear();
+
+                for (std::size_t begin = 0, end = 0; begin <= value.size(); begin = end + 1) {
+                    end = std::min(value.find(',', begin), value.size());
+                    options.workers.push_back(std::max(parse_value<std::uint32_t>(name, value.substr(begin, end - begin)), 1u));
+                }
+            }
+
+            else if (name == "--tile-size")
+                options.tile_size = std::max(parse_value<std::uint32_t>(name, value), 2u);
+
+            else if (name == "--frames")
+                options.frames = std::max(parse_value<std::uint32_t>(name, value), 1u);
+
+            else if (name == "--depth-test")
+                options.depth_test = parse_value<std::uint32_t>(name, value) != 0;
+
+            else if (name == "--seed")
+                options.seed = parse_value<std::uint32_t>(name, value);
+
+            else if (name == "--image-prefix")
+                options.image_prefix = value;
+
+            else throw std::invalid_argument(fmt::format("unknown option '{}'"s, name));
+        }
+
+        return options;
+    }
+
+    class xorshift final {
+    public:
+
+        explicit xorshift(std::uint32_t seed) : state{seed != 0 ? seed : 1u} { }
+
+        // xorshift32
+        std::uint32_t operator() () noexcept
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+
+            return state;
+        }
+
+        float unit() noexcept { return static_cast<float>((*this)() >> 8) * 0x1p-24f; }
+
+    private:
+
+        std::uint32_t state;
+    };
+
+    // A few points a little off screen.
+    std::vector<simulation::point_vertex> make_points(std::uint32_t count, std::uint32_t seed)
+    {
+        xorshift next{seed};
+
+        std::vector<simulation::point_vertex> points(count);
+
+        for (auto &&point : points) {
+            point.x = (next.unit() * 1.02f - .01f) * static_cast<float>(app::SCREEN_WIDTH);
+            point.y = (next.unit() * 1.02f - .01f) * static_cast<float>(app::SCREEN_HEIGHT);
+            point.color = next();
+        }
+
+        return points;
+    }
+
+    // Reference one point at a time rasterization.
+    std::vector<std::uint32_t> reference_image(std::vector<simulation::point_vertex> const &points, resolution resolution, bool depth_test)
+    {
+        auto const width = static_cast<std::int32_t>(resolution.width);
+        auto const height = static_cast<std::int32_t>(resolution.height);
+
+        std::vector<std::uint32_t> image(std::size_t{resolution.width} * resolution.height, gfx::software_rasterizer::CLEAR_COLOR);
+        std::vector<bool> covered(image.size(), false);
+
+        auto const scale_x = static_cast<float>(width) / static_cast<float>(app::SCREEN_WIDTH);
+        auto const scale_y = static_cast<float>(height) / static_cast<float>(app::SCREEN_HEIGHT);
+
+        for (auto &&point : points) {
+            auto const column = static_cast<std::int32_t>(std::floor(point.x * scale_x - .5f));
+            auto const row = height - 2 - static_cast<std::int32_t>(std::floor(point.y * scale_y - .5f));
+
+            for (auto y = std::max(row, 0); y < std::min(row + 2, height); ++y) {
+                for (auto x = std::max(column, 0); x < std::min(column + 2, width); ++x) {
+                    auto const index = static_cast<std::size_t>(y) * resolution.width + static_cast<std::size_t>(x);
+
+                    if (depth_test && covered[index])
+                        continue;
+
+                    covered[index] = true;
+
+                    auto const alpha = point.color >> 24;
+                    auto pixel = 0u;
+
+                    for (auto shift = 0u; shift < 32; shift += 8) {
+                        auto const s = (point.color >> shift) & 0xFF;
+                        auto const d = (image[index] >> shift) & 0xFF;
+
+                        pixel |= ((s * alpha + d * (255 - alpha) + 127) / 255) << shift;
+                    }
+
+                    image[index] = pixel;
+                }
+            }
+        }
+
+        return image;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    options options;
+
+    try {
+        options = parse_options(argc, argv);
+    }
+
+    catch (std::invalid_argument const &error) {
+        std::cerr << fmt::format("{}\nusage: raster_bench [--particles=N] [--workers=N[,N...]] [--tile-size=px] [--frames=N] [--depth-test=0|1] [--seed=N] [--image-prefix=path]\n"s, error.what());
+        return 1;
+    }
+
+    std::cout << fmt::format("particles: {}, tile size: {} px, frames: {}, depth test: {}\n"s,
+                             options.particles, options.tile_size, options.frames, options.depth_test ? "yes"s : "no"s);
+
+    auto const points = make_points(options.particles, options.seed);
+
+    auto mismatches_count = 0u;
+
+    for (auto resolution : RESOLUTIONS) {
+        auto const reference = reference_image(points, resolution, options.depth_test);
+
+        std::cout << fmt::format("\nresolution: {}x{}\n"s, resolution.width, resolution.height);
+
+        for (auto workers_count : options.workers) {
+            jobs::job_system pool{workers_count};
+
+            gfx::software_rasterizer rasterizer{resolution.width, resolution.height, options.depth_test, options.tile_size};
+
+            auto draw = [&]
+            {
+                rasterizer.draw(pool, points.data(), static_cast<std::uint32_t>(points.size()),
+                                static_cast<float>(app::SCREEN_WIDTH), static_cast<float>(app::SCREEN_HEIGHT));
+            };
+
+            draw();
+
+            auto const start = std::chrono::steady_clock::now();
+
+            for (auto frame = 0u; frame < options.frames; ++frame)
+                draw();
+
+            auto const frame_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / options.frames;
+
+            auto const matches = std::equal(std::begin(reference), std::end(reference), rasterizer.pixels());
+
+            mismatches_count += matches ? 0u : 1u;
+
+            std::cout << fmt::format("workers: {}, {:.3f} ms/frame, {:.1f} M pixels/sec, {:.1f} M particles/sec, matches reference: {}\n"s,
+                                     pool.workers_count(), frame_time * 1e3,
+                                     static_cast<double>(resolution.width) * resolution.height / frame_time * 1e-6,
+                                     static_cast<double>(points.size()) / frame_time * 1e-6, matches ? "yes"s : "no"s);
+
+            if (!options.image_prefix.empty() && workers_count == options.workers.front())
+                rasterizer.write_ppm(fmt::format("{}{}x{}.ppm"s, options.image_prefix, resolution.width, resolution.height));
+        }
+    }
+
+    return mismatches_count == 0 ? 0 : 1;
+}
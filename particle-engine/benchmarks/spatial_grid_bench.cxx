@@ -0,0 +1,310 @@
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include <string>
+using namespace std::string_literals;
+
+#pragma warning(disable : 4275)
+#include <fmt/format.h>
+#pragma warning(default : 4275)
+
+#include "jobs/job_system.hxx"
+#include "simulation/spatial_grid.hxx"
+#include "utility/aligned_allocator.hxx"
+#include "screen.hxx"
+
+
+namespace
+{
+    struct options final {
+        // One run per entry.
+        std::vector<std::uint32_t> counts{10'000, 100'000, 1'000'000};
+
+        std::uint32_t workers{std::max(std::thread::hardware_concurrency(), 1u)};
+
+        float cell_size{8.f};
+        float radius{8.f};
+
+        std::uint32_t builds{20};
+        std::uint32_t queries{100'000};
+
+        std::uint32_t seed{1};
+    };
+
+    auto constexpr PARTICLES_PER_JOB = 4096u;
+    auto constexpr CELLS_PER_JOB = 1024u;
+
+    template<class T>
+    T parse_value(std::string_view name, std::string_view value)
+    {
+        T result{};
+
+        if (auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result); ec != std::errc{} || ptr != value.data() + value.size())
+            throw std::invalid_argument(fmt::format("invalid value '{}' for '{}'"s, value, name));
+
+        return result;
+    }
+
+    options parse_options(int argc, char **argv)
+    {
+        options options;
+
+        for (auto i = 1; i < argc; ++i) {
+            std::string_view argument{argv[i]};
+
+            auto separator = argument.find('=');
+
+            if (separator == std::string_view::npos)
+                throw std::invalid_argument(fmt::format("expected '--name=value', got '{}'"s, argument));
+
+            auto name = argument.substr(0, separator);
+            auto value = argument.substr(separator + 1);
+
+            if (name == "--counts") {
+                options.counts.clear();
+
+                for (std::size_t begin = 0, end = 0; begin <= value.size(); begin = end + 1) {
+                    end = std::min(value.find(',', begin), value.size());
+                    options.counts.push_back(std::max(parse_value<std::uint32_t>(name, value.substr(begin, end - begin)), 1u));
+                }
+            }
+
+            else if (name == "--workers")
+                options.workers = std::max(parse_value<std::uint32_t>(name, value), 1u);
+
+            else if (name == "--cell-size")
+                options.cell_size = parse_value<float>(name, value);
+
+            else if (name == "--radius")
+                options.radius = parse_value<float>(name, value);
+
+            else if (name == "--builds")
+                options.builds = std::max(parse_value<std::uint32_t>(name, value), 1u);
+
+            else if (name == "--queries")
+                options.queries = std::max(parse_value<std::uint32_t>(name, value), 1u);
+
+            else if (name == "--seed")
+                options.seed = parse_value<std::uint32_t>(name, value);
+
+            else throw std::invalid_argument(fmt::format("unknown option '{}'"s, name));
+        }
+
+        if (options.cell_size <= 0.f || options.radius < 0.f)
+            throw std::invalid_argument("'--cell-size' must be positive and '--radius' non-negative"s);
+
+        return options;
+    }
+
+    class xorshift final {
+    public:
+
+        explicit xorshift(std::uint32_t seed) : state{seed != 0 ? seed : 1u} { }
+
+        // xorshift32
+        float operator() () noexcept
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+
+            return static_cast<float>(state >> 8) * 0x1p-24f;
+        }
+
+    private:
+
+        std::uint32_t state;
+    };
+
+    // count -> prefix sum -> scatter -> sort cells.
+    class grid_builder final {
+    public:
+
+        grid_builder(jobs::job_system &pool, simulation::spatial_grid &grid, float const *x, float const *y, std::uint32_t count)
+            : pool{pool}, grid{grid}
+        {
+            auto const blocks_count = (count + PARTICLES_PER_JOB - 1) / PARTICLES_PER_JOB;
+
+            count_task = jobs::make_task(
+                [this, x, y, count] (std::uint32_t begin, std::uint32_t end, std::uint32_t)
+                {
+                    this->grid.count(x, y, begin * PARTICLES_PER_JOB, std::min(end * PARTICLES_PER_JOB, count));
+                },
+                [this, blocks_count] (std::uint32_t)
+                {
+                    this->grid.prefix_sum();
+                    this->pool.submit(*scatter_task, blocks_count);
+                }
+            );
+
+            scatter_task = jobs::make_task(
+                [this, count] (std::uint32_t begin, std::uint32_t end, std::uint32_t)
+                {
+                    this->grid.scatter(begin * PARTICLES_PER_JOB, std::min(end * PARTICLES_PER_JOB, count));
+                },
+                [this] (std::uint32_t)
+                {
+                    this->pool.submit(*sort_task, (this->grid.cells_count() + CELLS_PER_JOB - 1) / CELLS_PER_JOB);
+                }
+            );
+
+            sort_task = jobs::make_task(
+                [this] (std::uint32_t begin, std::uint32_t end, std::uint32_t)
+                {
+                    this->grid.sort_cells(begin * CELLS_PER_JOB, std::min(end * CELLS_PER_JOB, this->grid.cells_count()));
+                },
+                [this] (std::uint32_t)
+                {
+                    done.store(true, std::memory_order_release);
+                }
+            );
+
+            this->blocks_count = blocks_count;
+        }
+
+        void operator() ()
+        {
+            done = false;
+
+            grid.clear();
+            pool.submit(*count_task, blocks_count);
+
+            while (!done.load(std::memory_order_acquire))
+                std::this_thread::yield();
+        }
+
+    private:
+
+        jobs::job_system &pool;
+        simulation::spatial_grid &grid;
+
+        std::uint32_t blocks_count{0};
+
+        std::unique_ptr<jobs::task> count_task;
+        std::unique_ptr<jobs::task> scatter_task;
+        std::unique_ptr<jobs::task> sort_task;
+
+        std::atomic_bool done{false};
+    };
+
+    struct run_result final {
+        double build_time{0}; // s, per build
+        double query_time{0}; // s, all queries
+
+        std::uint64_t neighbours_count{0};
+        std::uint32_t mismatches_count{0};
+    };
+
+    run_result run(options const &options, jobs::job_system &pool, std::uint32_t count)
+    {
+        auto constexpr width = static_cast<float>(app::SCREEN_WIDTH);
+        auto constexpr height = static_cast<float>(app::SCREEN_HEIGHT);
+
+        xorshift next{options.seed};
+
+        utility::aligned_vector<float> x(count), y(count);
+
+        for (auto i = 0u; i < count; ++i) {
+            x[i] = next() * width;
+            y[i] = next() * height;
+        }
+
+        simulation::spatial_grid grid{width, height, options.cell_size, count};
+        grid_builder build{pool, grid, x.data(), y.data(), count};
+
+        run_result result;
+
+        build();
+
+        auto const build_start = std::chrono::steady_clock::now();
+
+        for (auto i = 0u; i < options.builds; ++i)
+            build();
+
+        result.build_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - build_start).count() / options.builds;
+
+        std::vector<float> query_x(options.queries), query_y(options.queries);
+
+        for (auto i = 0u; i < options.queries; ++i) {
+            query_x[i] = next() * width;
+            query_y[i] = next() * height;
+        }
+
+        auto const query_start = std::chrono::steady_clock::now();
+
+        for (auto i = 0u; i < options.queries; ++i) {
+            grid.for_each_neighbour(x.data(), y.data(), query_x[i], query_y[i], options.radius, [&result] (std::uint32_t, float, float, float)
+            {
+                ++result.neighbours_count;
+            });
+        }
+
+        result.query_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - query_start).count();
+
+        // Brute force cross-check of the first few queries.
+        for (auto i = 0u; i < std::min(options.queries, 64u); ++i) {
+            auto expected = 0u, found = 0u;
+
+            for (auto j = 0u; j < count; ++j) {
+                auto const dx = query_x[i] - x[j];
+                auto const dy = query_y[i] - y[j];
+
+                expected += dx * dx + dy * dy <= options.radius * options.radius ? 1u : 0u;
+            }
+
+            grid.for_each_neighbour(x.data(), y.data(), query_x[i], query_y[i], options.radius, [&found] (std::uint32_t, float, float, float) { ++found; });
+
+            result.mismatches_count += expected != found ? 1u : 0u;
+        }
+
+        return result;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    options options;
+
+    try {
+        options = parse_options(argc, argv);
+    }
+
+    catch (std::invalid_argument const &error) {
+        std::cerr << fmt::format("{}\nusage: spatial_grid_bench [--counts=N[,N...]] [--workers=N] [--cell-size=px] [--radius=px] [--builds=N] [--queries=N] [--seed=N]\n"s, error.what());
+        return 1;
+    }
+
+    jobs::job_system pool{options.workers};
+
+    std::cout << fmt::format("workers: {}, domain: {}x{}, cell size: {} px, query radius: {} px\n"s,
+                             pool.workers_count(), app::SCREEN_WIDTH, app::SCREEN_HEIGHT, options.cell_size, options.radius);
+
+    auto mismatches_count = 0u;
+
+    for (auto count : options.counts) {
+        auto const result = run(options, pool, count);
+
+        std::cout << fmt::format("\nparticles: {}\n"s, count);
+        std::cout << fmt::format("build: {:.3f} ms, {:.1f} M particles/sec\n"s,
+                                 result.build_time * 1e3, static_cast<double>(count) / result.build_time * 1e-6);
+        std::cout << fmt::format("queries: {:.2f} M/sec, {:.1f} neighbours per query, {:.1f} M neighbours/sec\n"s,
+                                 static_cast<double>(options.queries) / result.query_time * 1e-6,
+                                 static_cast<double>(result.neighbours_count) / static_cast<double>(options.queries),
+                                 static_cast<double>(result.neighbours_count) / result.query_time * 1e-6);
+
+        if (result.mismatches_count != 0)
+            std::cout << fmt::format("brute force mismatches: {}\n"s, result.mismatches_count);
+
+        mismatches_count += result.mismatches_count;
+    }
+
+    return mismatches_count == 0 ? 0 : 1;
+}
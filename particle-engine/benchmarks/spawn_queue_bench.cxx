@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include <string>
+using namespace std::string_literals;
+
+#pragma warning(disable : 4275)
+#include <fmt/format.h>
+#pragma warning(default : 4275)
+
+#include "particle_engine.hxx"
+
+
+namespace
+{
+    struct options final {
+        std::uint32_t producers{4};
+
+        std::int64_t duration{2'000}; // ms
+        std::int64_t dt{5}; // ms
+
+        std::uint32_t workers{app::particle_engine::default_workers_count()};
+
+        // Requests/s of all producers, zero unpaced; none sweeps.
+        std::vector<std::uint64_t> rates;
+    };
+
+    // Doubles or halves the rate, then bisects, /s.
+    auto constexpr SWEEP_FIRST_RATE = std::uint64_t{50'000};
+    auto constexpr SWEEP_MIN_RATE = std::uint64_t{1'000};
+    auto constexpr SWEEP_MAX_RATE = std::uint64_t{100'000'000};
+    auto constexpr SWEEP_BISECTIONS = 4u;
+
+    struct run_result final {
+        std::uint64_t requested{0};
+        std::uint64_t steps{0};
+
+        app::spawn_statistics stats;
+
+        double elapsed{0}; // s
+    };
+
+    template<class T>
+    T parse_value(std::string_view name, std::string_view value)
+    {
+        T result{};
+
+        if (auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result); ec != std::errc{} || ptr != value.data() + value.size())
+            throw std::invalid_argument(fmt::format("invalid value '{}' for '{}'"s, value, name));
+
+        return result;
+    }
+
+    options parse_options(int argc, char **argv)
+    {
+        options options;
+
+        for (auto i = 1; i < argc; ++i) {
+            std::string_view argument{argv[i]};
+
+            auto separator = argument.find('=');
+
+            if (separator == std::string_view::npos)
+                throw std::invalid_argument(fmt::format("expected '--name=value', got '{}'"s, argument));
+
+            auto name = argument.substr(0, separator);
+            auto value = argument.substr(separator + 1);
+
+            if (name == "--producers")
+                options.producers = std::max(parse_value<std::uint32_t>(name, value), 1u);
+
+            else if (name == "--duration")
+                options.duration = parse_value<std::int64_t>(name, value);
+
+            else if (name == "--dt")
+                options.dt = parse_value<std::int64_t>(name, value);
+
+            else if (name == "--workers")
+                options.workers = std::max(parse_value<std::uint32_t>(name, value), 1u);
+
+            else if (name == "--rates") {
+                options.rates.clear();
+
+                for (std::size_t begin = 0, end = 0; begin <= value.size(); begin = end + 1) {
+                    end = std::min(value.find(',', begin), value.size());
+                    options.rates.push_back(parse_value<std::uint64_t>(name, value.substr(begin, end - begin)));
+                }
+            }
+
+            else throw std::invalid_argument(fmt::format("unknown option '{}'"s, name));
+        }
+
+        if (options.dt <= 0 || options.duration <= 0)
+            throw std::invalid_argument("'--dt' and '--duration' must be positive"s);
+
+        return options;
+    }
+
+    void step(app::particle_engine &engine, std::int64_t dt)
+    {
+        auto const target_step = engine.steps() + 1;
+
+        engine.update(std::chrono::milliseconds{dt});
+
+        while (engine.steps() < target_step)
+            std::this_thread::yield();
+    }
+
+    // Paced producers against back to back steps, until every request is taken.
+    run_result run(options const &options, std::uint64_t rate)
+    {
+        app::engine_config config;
+        config.workers_count = options.workers;
+
+        app::particle_engine engine{config};
+
+        std::atomic_bool stop{false};
+        std::atomic_uint64_t requested{0};
+
+        std::vector<std::thread> producers;
+
+        auto const start = std::chrono::steady_clock::now();
+
+        for (auto producer = 0u; producer < options.producers; ++producer) {
+            producers.emplace_back([&, producer]
+            {
+                auto const period = rate != 0 ? std::chrono::nanoseconds{1'000'000'000ll * options.producers / static_cast<std::int64_t>(rate)} : std::chrono::nanoseconds{0};
+
+                auto count = std::uint64_t{0};
+
+                for (auto next = start; !stop.load(std::memory_order_relaxed); next += period) {
+                    if (rate != 0) {
+                        while (std::chrono::steady_clock::now() < next && !stop.load(std::memory_order_relaxed))
+                            std::this_thread::yield();
+                    }
+
+                    auto const x = static_cast<float>((count * 97 + producer * 13) % app::SCREEN_WIDTH);
+                    auto const y = static_cast<float>((count * 89 + producer * 7) % app::SCREEN_HEIGHT);
+
+                    engine.spawn_effect(glm::vec2{x, y}, glm::vec4{1.f, .5f, .25f, 1.f});
+
+                    ++count;
+                }
+
+                requested.fetch_add(count);
+            });
+        }
+
+        run_result result;
+
+        auto const deadline = start + std::chrono::milliseconds{options.duration};
+
+        while (std::chrono::steady_clock::now() < deadline) {
+            step(engine, options.dt);
+            ++result.steps;
+        }
+
+        stop = true;
+
+        for (auto &&producer : producers)
+            producer.join();
+
+        result.elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.requested = requested.load();
+
+        for (auto stats = engine.spawn_stats(); stats.ingested + stats.dropped < result.requested; stats = engine.spawn_stats())
+            step(engine, options.dt);
+
+        result.stats = engine.spawn_stats();
+
+        return result;
+    }
+
+    // True if nothing was dropped.
+    bool try_rate(options const &options, std::uint64_t rate)
+    {
+        auto const result = run(options, rate);
+        auto const &stats = result.stats;
+
+        std::cout << fmt::format("\nrate: {}\n"s, rate != 0 ? fmt::format("{}/s"s, rate) : "unbounded"s);
+        std::cout << fmt::format("requested: {}, ingested: {}, dropped: {} ({:.2f}%)\n"s,
+                                 result.requested, stats.ingested, stats.dropped,
+                                 result.requested != 0 ? static_cast<double>(stats.dropped) * 100. / static_cast<double>(result.requested) : 0.);
+        std::cout << fmt::format("ingested spawns/sec: {:.0f}, steps/sec: {:.1f}, max effects per step: {}\n"s,
+                                 static_cast<double>(stats.ingested) / result.elapsed, static_cast<double>(result.steps) / result.elapsed,
+                                 stats.max_per_step);
+        std::cout << fmt::format("lossless: {}\n"s, stats.dropped == 0 ? "yes"s : "no"s);
+
+        return stats.dropped == 0;
+    }
+
+    // Zero if none.
+    std::uint64_t sweep(options const &options)
+    {
+        std::uint64_t lossless = 0, lossy = 0;
+
+        for (auto rate = SWEEP_FIRST_RATE;;) {
+            if (try_rate(options, rate)) {
+                lossless = rate;
+
+                if (lossy != 0 || rate >= SWEEP_MAX_RATE)
+                    break;
+
+                rate *= 2;
+            }
+
+            else {
+                lossy = rate;
+
+                if (lossless != 0 || rate <= SWEEP_MIN_RATE)
+                    break;
+
+                rate /= 2;
+            }
+        }
+
+        for (auto bisection = 0u; bisection < SWEEP_BISECTIONS && lossless != 0 && lossy != 0; ++bisection) {
+            auto const rate = lossless + (lossy - lossless) / 2;
+
+            (try_rate(options, rate) ? lossless : lossy) = rate;
+        }
+
+        return lossless;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    options options;
+
+    try {
+        options = parse_options(argc, argv);
+    }
+
+    catch (std::invalid_argument const &error) {
+        std::cerr << fmt::format("{}\nusage: spawn_queue_bench [--producers=N] [--duration=ms] [--dt=ms] [--workers=N] [--rates=N[,N...]]\n"s, error.what());
+        return 1;
+    }
+
+    std::cout << fmt::format("producers: {}, workers: {}, duration: {} ms, dt: {} ms, spawn queue capacity: {}\n"s,
+                             options.producers, options.workers, options.duration, options.dt, app::SPAWN_QUEUE_CAPACITY);
+
+    // Unbounded ranks above every paced rate.
+    auto highest = std::uint64_t{0};
+    auto any_lossless = false;
+
+    if (options.rates.empty()) {
+        highest = sweep(options);
+        any_lossless = highest != 0;
+    }
+
+    for (auto rate : options.rates) {
+        if (try_rate(options, rate) && (!any_lossless || (highest != 0 && (rate == 0 || rate > highest)))) {
+            highest = rate;
+            any_lossless = true;
+        }
+    }
+
+    if (!any_lossless) {
+        std::cerr << "\nno rate tried was lossless\n";
+        return 1;
+    }
+
+    std::cout << fmt::format("\nhighest lossless rate: {}\n"s, highest != 0 ? fmt::format("{} spawns/s"s, highest) : "unbounded"s);
+
+    return 0;
+}
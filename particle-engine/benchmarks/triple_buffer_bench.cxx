@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <array>
+
+#include <string>
+using namespace std::string_literals;
+
+#pragma warning(disable : 4275)
+#include <fmt/format.h>
+#pragma warning(default : 4275)
+
+#include "utility/triple_buffer.hxx"
+
+
+namespace
+{
+    struct options final {
+        std::uint64_t iterations{1'000'000};
+    };
+
+    // Derived from the sequence number, so a torn slot mismatches.
+    struct alignas(64) slot final {
+        std::uint64_t sequence{0};
+        std::array<std::uint64_t, 14> payload{};
+        std::int64_t published_time{0}; // ns
+    };
+
+    std::uint64_t payload_word(std::uint64_t sequence, std::size_t index) noexcept
+    {
+        return sequence * 0x9E3779B97F4A7C15 + index;
+    }
+
+    std::int64_t now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    options parse_options(int argc, char **argv)
+    {
+        options options;
+
+        for (auto i = 1; i < argc; ++i) {
+            std::string_view argument{argv[i]};
+
+            if (argument.substr(0, 13) != "--iterations=")
+                throw std::invalid_argument(fmt::format("unknown option '{}'"s, argument));
+
+            auto value = argument.substr(13);
+
+            if (auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), options.iterations); ec != std::errc{} || ptr != value.data() + value.size())
+                throw std::invalid_argument(fmt::format("invalid value '{}' for '--iterations'"s, value));
+        }
+
+        return options;
+    }
+
+    std::int64_t percentile(std::vector<std::int64_t> const &sorted, double fraction)
+    {
+        if (sorted.empty())
+            return 0;
+
+        auto index = static_cast<std::size_t>(fraction * static_cast<double>(sorted.size() - 1) + .5);
+
+        return sorted.at(index);
+    }
+
+    struct stress_result final {
+        std::uint64_t torn_reads{0};
+        std::uint64_t stale_reads{0};
+        std::uint64_t fresh_reads{0};
+
+        // ns, sorted.
+        std::vector<std::int64_t> latencies;
+    };
+
+    // The consumer checks for torn slots and backwards sequences.
+    stress_result stress(std::uint64_t iterations)
+    {
+        std::array<slot, utility::triple_buffer::SLOTS_COUNT> slots;
+        utility::triple_buffer exchange;
+
+        std::atomic_bool done{false};
+
+        std::thread producer([&]
+        {
+            for (std::uint64_t sequence = 1; sequence <= iterations; ++sequence) {
+                auto &&back = slots[exchange.back()];
+
+                back.sequence = sequence;
+
+                for (std::size_t i = 0; i < back.payload.size(); ++i)
+                    back.payload[i] = payload_word(sequence, i);
+
+                back.published_time = now();
+
+                exchange.publish();
+            }
+
+            done = true;
+        });
+
+        stress_result result;
+        result.latencies.reserve(static_cast<std::size_t>(std::min(iterations, std::uint64_t{1'000'000})));
+
+        std::uint64_t last_sequence = 0;
+        auto last_index = exchange.front();
+
+        for (auto finished = false; !finished;) {
+            finished = done.load();
+
+            auto const index = exchange.acquire();
+            auto &&front = slots[index];
+
+            auto const sequence = front.sequence;
+
+            if (index == last_index || sequence == 0)
+                continue;
+
+            for (std::size_t i = 0; i < front.payload.size(); ++i) {
+                if (front.payload[i] != payload_word(sequence, i)) {
+                    ++result.torn_reads;
+                    break;
+                }
+            }
+
+            if (front.sequence != sequence)
+                ++result.torn_reads;
+
+            if (sequence < last_sequence)
+                ++result.stale_reads;
+
+            if (result.latencies.size() < result.latencies.capacity())
+                result.latencies.push_back(now() - front.published_time);
+
+            last_sequence = sequence;
+            last_index = index;
+
+            ++result.fresh_reads;
+        }
+
+        producer.join();
+
+        std::sort(std::begin(result.latencies), std::end(result.latencies));
+
+        return result;
+    }
+
+    template<class F>
+    double measure_ns_per_op(std::uint64_t iterations, F &&operation)
+    {
+        auto const start = now();
+
+        for (std::uint64_t i = 0; i < iterations; ++i)
+            operation();
+
+        return static_cast<double>(now() - start) / static_cast<double>(std::max(iterations, std::uint64_t{1}));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    options options;
+
+    try {
+        options = parse_options(argc, argv);
+    }
+
+    catch (std::invalid_argument const &error) {
+        std::cerr << fmt::format("{}\nusage: triple_buffer_bench [--iterations=N]\n"s, error.what());
+        return 1;
+    }
+
+    utility::triple_buffer exchange;
+
+    auto const publish_ns = measure_ns_per_op(options.iterations, [&exchange] { exchange.publish(); });
+    auto const acquire_ns = measure_ns_per_op(options.iterations, [&exchange] { exchange.acquire(); });
+    auto const round_trip_ns = measure_ns_per_op(options.iterations, [&exchange] { exchange.publish(); exchange.acquire(); });
+
+    std::cout << fmt::format("uncontended ns/op: publish {:.2f}, acquire (nothing new) {:.2f}, publish + acquire {:.2f}\n"s,
+                             publish_ns, acquire_ns, round_trip_ns);
+
+    auto const result = stress(options.iterations);
+    auto const &latencies = result.latencies;
+
+    std::cout << fmt::format("stress: {} publishes, {} fresh acquires, {} torn, {} out of order\n"s,
+                             options.iterations, result.fresh_reads, result.torn_reads, result.stale_reads);
+    std::cout << fmt::format("publish to acquire latency ns: p50 {}, p90 {}, p99 {}, max {}\n"s,
+                             percentile(latencies, .50), percentile(latencies, .90), percentile(latencies, .99),
+                             latencies.empty() ? 0 : latencies.back());
+
+    return result.torn_reads == 0 && result.stale_reads == 0 ? 0 : 1;
+}
@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <string>
+using namespace std::string_literals;
+
+#pragma warning(disable : 4275)
+#include <fmt/format.h>
+#pragma warning(default : 4275)
+
+#include "particle_engine.hxx"
+
+
+namespace
+{
+    struct options final {
+        // One run per entry.
+        std::vector<std::uint32_t> counts{10'000, app::DEFAULT_PARTICLES_CAPACITY, 1'000'000};
+
+        std::uint32_t workers{app::particle_engine::default_workers_count()};
+
+        std::uint32_t frames{50};
+    };
+
+    template<class T>
+    T parse_value(std::string_view name, std::string_view value)
+    {
+        T result{};
+
+        if (auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result); ec != std::errc{} || ptr != value.data() + value.size())
+            throw std::invalid_argument(fmt::format("invalid value '{}' for '{}'"s, value, name));
+
+        return result;
+    }
+
+    options parse_options(int argc, char **argv)
+    {
+        options options;
+
+        for (auto i = 1; i < argc; ++i) {
+            std::string_view argument{argv[i]};
+
+            auto separator = argument.find('=');
+
+            if (separator == std::string_view::npos)
+                throw std::invalid_argument(fmt::format("expected '--name=value', got '{}'"s, argument));
+
+            auto name = argument.substr(0, separator);
+            auto value = argument.substr(separator + 1);
+
+            if (name == "--counts") {
+                options.counts.clear();
+
+                for (std::size_t begin = 0, end = 0; begin <= value.size(); begin = end + 1) {
+                    end = std::min(value.find(',', begin), value.size());
+                    options.counts.push_back(std::max(parse_value<std::uint32_t>(name, value.substr(begin, end - begin)), 1u));
+                }
+            }
+
+            else if (name == "--workers")
+                options.workers = std::max(parse_value<std::uint32_t>(name, value), 1u);
+
+            else if (name == "--frames")
+                options.frames = std::max(parse_value<std::uint32_t>(name, value), 1u);
+
+            else throw std::invalid_argument(fmt::format("unknown option '{}'"s, name));
+        }
+
+        return options;
+    }
+
+    // An opaque entry point per call, like 'glVertex2f'; through pointers.
+    struct immediate_mode final {
+        std::vector<float> commands;
+
+        static void color4f(immediate_mode &self, float r, float g, float b, float a) { self.commands.insert(std::end(self.commands), {r, g, b, a}); }
+        static void vertex2f(immediate_mode &self, float x, float y) { self.commands.insert(std::end(self.commands), {x, y}); }
+    };
+
+    void (* volatile color4f)(immediate_mode &, float, float, float, float) = immediate_mode::color4f;
+    void (* volatile vertex2f)(immediate_mode &, float, float) = immediate_mode::vertex2f;
+
+    std::uint64_t fnv1a(void const *data, std::size_t size, std::uint64_t hash = 0xCBF29CE484222325)
+    {
+        for (auto bytes = static_cast<unsigned char const *>(data); size != 0; --size, ++bytes)
+            hash = (hash ^ *bytes) * 0x100000001B3;
+
+        return hash;
+    }
+
+    struct run_result final {
+        std::uint32_t particles_count{0};
+
+        double per_particle_time{0}; // s, per frame
+        double stream_time{0}; // s, per frame
+
+        bool checksums_match{false};
+    };
+
+    run_result run(options const &options, std::uint32_t count)
+    {
+        app::engine_config config;
+        config.workers_count = options.workers;
+        config.capacity = count;
+
+        app::particle_engine engine{config};
+
+        // The spawn queue takes at most its capacity per step.
+        for (auto spawned = 0u; spawned < count; ) {
+            auto const target_step = engine.steps() + 1;
+
+            for (auto i = 0u; i < app::SPAWN_QUEUE_CAPACITY && spawned < count; ++i, spawned += app::PER_EFFECT_PARTICLES_COUNT) {
+                auto const x = static_cast<float>((spawned / app::PER_EFFECT_PARTICLES_COUNT * 97) % app::SCREEN_WIDTH);
+                auto const y = static_cast<float>((spawned / app::PER_EFFECT_PARTICLES_COUNT * 89) % app::SCREEN_HEIGHT);
+
+                engine.spawn_effect(glm::vec2{x, y}, glm::vec4{1.f, .5f, .25f, .75f});
+            }
+
+            engine.update(std::chrono::microseconds{100});
+
+            while (engine.steps() < target_step)
+                std::this_thread::yield();
+        }
+
+        run_result result;
+        result.particles_count = engine.particles_count();
+
+        immediate_mode driver;
+        driver.commands.reserve(std::size_t{count} * 6);
+
+        auto const per_particle_start = std::chrono::steady_clock::now();
+
+        for (auto frame = 0u; frame < options.frames; ++frame) {
+            driver.commands.clear();
+
+            engine.render([&driver] (float x, float y, float r, float g, float b, float a)
+            {
+                color4f(driver, r, g, b, a);
+                vertex2f(driver, x, y);
+            });
+        }
+
+        result.per_particle_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - per_particle_start).count() / options.frames;
+
+        // One copy into what would be the mapped buffer.
+        std::vector<simulation::point_vertex> uploaded(count);
+
+        auto const stream_start = std::chrono::steady_clock::now();
+
+        for (auto frame = 0u; frame < options.frames; ++frame) {
+            engine.render_vertices([&uploaded] (simulation::point_vertex const *vertices, std::uint32_t count)
+            {
+                std::memcpy(uploaded.data(), vertices, count * sizeof(simulation::point_vertex));
+            });
+        }
+
+        result.stream_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - stream_start).count() / options.frames;
+
+        // Both paths have to hand over the same points.
+        std::vector<simulation::point_vertex> repacked;
+        repacked.reserve(result.particles_count);
+
+        for (std::size_t i = 0; i + 6 <= driver.commands.size(); i += 6) {
+            auto &&c = driver.commands;
+            repacked.push_back(simulation::point_vertex{c[i + 4], c[i + 5], simulation::pack_color(glm::vec4{c[i], c[i + 1], c[i + 2], c[i + 3]})});
+        }
+
+        auto const stream_checksum = fnv1a(uploaded.data(), result.particles_count * sizeof(simulation::point_vertex));
+        auto const per_particle_checksum = fnv1a(repacked.data(), repacked.size() * sizeof(simulation::point_vertex));
+
+        result.checksums_match = repacked.size() == result.particles_count && stream_checksum == per_particle_checksum;
+
+        return result;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    options options;
+
+    try {
+        options = parse_options(argc, argv);
+    }
+
+    catch (std::invalid_argument const &error) {
+        std::cerr << fmt::format("{}\nusage: vertex_stream_bench [--counts=N[,N...]] [--workers=N] [--frames=N]\n"s, error.what());
+        return 1;
+    }
+
+    std::cout << fmt::format("workers: {}, frames: {}, vertex: {} bytes\n"s, options.workers, options.frames, sizeof(simulation::point_vertex));
+
+    auto mismatches_count = 0u;
+
+    for (auto count : options.counts) {
+        auto const result = run(options, count);
+
+        auto const particles = static_cast<double>(std::max(result.particles_count, 1u));
+
+        std::cout << fmt::format("\nparticles: {}\n"s, result.particles_count);
+        std::cout << fmt::format("per particle: {:.3f} ms/frame, {:.2f} ns/particle\n"s, result.per_particle_time * 1e3, result.per_particle_time * 1e9 / particles);
+        std::cout << fmt::format("vertex stream: {:.3f} ms/frame, {:.2f} ns/particle, {:.1f} GB/s\n"s, result.stream_time * 1e3, result.stream_time * 1e9 / particles,
+                                 particles * sizeof(simulation::point_vertex) / result.stream_time * 1e-9);
+        std::cout << fmt::format("speedup: {:.1f}x, checksums match: {}\n"s, result.per_particle_time / result.stream_time, result.checksums_match ? "yes"s : "no"s);
+
+        mismatches_count += result.checksums_match ? 0u : 1u;
+    }
+
+    return mismatches_count == 0 ? 0 : 1;
+}
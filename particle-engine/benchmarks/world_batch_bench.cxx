@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <string>
+using namespace std::string_literals;
+
+#pragma warning(disable : 4275)
+#include <fmt/format.h>
+#pragma warning(default : 4275)
+
+#include "particle_engine.hxx"
+#include "world_batch.hxx"
+
+
+namespace
+{
+    struct options final {
+        // ms, for the 99th percentile of the steps.
+        double slo{16.};
+
+        std::uint32_t warmup{60};
+        std::uint32_t steps{120};
+
+        std::int64_t dt{16}; // ms
+
+        std::uint32_t spawns{1};
+        std::uint32_t capacity{8192};
+
+        std::uint32_t workers{app::particle_engine::default_workers_count()};
+        std::uint32_t engine_workers{app::particle_engine::default_workers_count()};
+
+        std::uint32_t max_worlds{1024};
+
+        // For the results check.
+        std::uint32_t check_worlds{4};
+    };
+
+    enum class mode : std::uint8_t {
+        // One 'app::world_batch'.
+        batch,
+
+        // Each with a pool of its own.
+        engines
+    };
+
+    struct run_result final {
+        std::vector<std::int64_t> latencies; // ns, sorted
+
+        std::uint64_t particles_count{0};
+        std::size_t committed_bytes{0};
+
+        std::uint32_t threads_count{0};
+
+        std::vector<std::uint64_t> hashes;
+    };
+
+    template<class T>
+    T parse_value(std::string_view name, std::string_view value)
+    {
+        T result{};
+
+        if (auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result); ec != std::errc{} || ptr != value.data() + value.size())
+            throw std::invalid_argument(fmt::format("invalid value '{}' for '{}'"s, value, name));
+
+        return result;
+    }
+
+    options parse_options(int argc, char **argv)
+    {
+        options options;
+
+        for (auto i = 1; i < argc; ++i) {
+            std::string_view argument{argv[i]};
+
+            auto separator = argument.find('=');
+
+            if (separator == std::string_view::npos)
+                throw std::invalid_argument(fmt::format("expected '--name=value', got '{}'"s, argument));
+
+            auto name = argument.substr(0, separator);
+            auto value = argument.substr(separator + 1);
+
+            if (name == "--slo")
+                options.slo = parse_value<double>(name, value);
+
+            else if (name == "--warmup")
+                options.warmup = parse_value<std::uint32_t>(name, value);
+
+            else if (name == "--steps")
+                options.steps = std::max(parse_value<std::uint32_t>(name, value), 1u);
+
+            else if (name == "--dt")
+                options.dt = parse_value<std::int64_t>(name, value);
+
+            else if (name == "--spawns")
+                options.spawns = parse_value<std::uint32_t>(name, value);
+
+            else if (name == "--capacity")
+                options.capacity = std::max(parse_value<std::uint32_t>(name, value), 1u);
+
+            else if (name == "--workers")
+                options.workers = std::max(parse_value<std::uint32_t>(name, value), 1u);
+
+            else if (name == "--engine-workers")
+                options.engine_workers = std::max(parse_value<std::uint32_t>(name, value), 1u);
+
+            else if (name == "--max-worlds")
+                options.max_worlds = std::max(parse_value<std::uint32_t>(name, value), 1u);
+
+            else if (name == "--check-worlds")
+                options.check_worlds = parse_value<std::uint32_t>(name, value);
+
+            else throw std::invalid_argument(fmt::format("unknown option '{}'"s, name));
+        }
+
+        if (options.dt <= 0 || options.slo <= 0.)
+            throw std::invalid_argument("'--dt' and '--slo' must be positive"s);
+
+        return options;
+    }
+
+    // The same spawns for the same world and step whatever the mode.
+    void spawn(app::particle_engine &world, std::uint32_t world_index, std::uint32_t step, std::uint32_t spawns)
+    {
+        for (auto k = 0u; k < spawns; ++k) {
+            auto const x = static_cast<float>((step * 97 + world_index * 13 + k * 31) % app::SCREEN_WIDTH);
+            auto const y = static_cast<float>((step * 89 + world_index * 7 + k * 17) % app::SCREEN_HEIGHT);
+
+            world.spawn_effect(glm::vec2{x, y}, glm::vec4{1.f, .5f, .25f, 1.f});
+        }
+    }
+
+    // FNV-1a over the id and position of every particle of the published frame.
+    std::uint64_t hash_world(app::particle_engine &world)
+    {
+        std::uint64_t hash = 0xCBF29CE484222325;
+
+        world.for_each_particle([&hash] (std::uint32_t id, float x, float y)
+        {
+            for (auto bits : {id, std::bit_cast<std::uint32_t>(x), std::bit_cast<std::uint32_t>(y)})
+                hash = (hash ^ bits) * 0x100000001B3;
+        });
+
+        return hash;
+    }
+
+    // From the first spawn to the last world's publication.
+    run_result run(options const &options, mode run_mode, std::uint32_t worlds_count)
+    {
+        app::engine_config config;
+        config.capacity = options.capacity;
+        config.page_policy = utility::page_policy::regular;
+
+        std::unique_ptr<app::world_batch> batch;
+        std::vector<std::unique_ptr<app::particle_engine>> engines;
+
+        std::vector<app::particle_engine *> worlds;
+
+        run_result result;
+
+        if (run_mode == mode::batch) {
+            config.workers_count = options.workers;
+
+            batch = std::make_unique<app::world_batch>(worlds_count, config);
+
+            for (auto world_index = 0u; world_index < worlds_count; ++world_index)
+                worlds.push_back(&batch->world(world_index));
+
+            result.threads_count = batch->workers_count();
+        }
+
+        else {
+            config.workers_count = options.engine_workers;
+
+            for (auto world_index = 0u; world_index < worlds_count; ++world_index) {
+                engines.push_back(std::make_unique<app::particle_engine>(config));
+                worlds.push_back(engines.back().get());
+
+                result.threads_count += engines.back()->workers_count();
+            }
+        }
+
+        auto const dt = std::chrono::milliseconds{options.dt};
+
+        std::function<void()> step = [&batch, dt] { batch->update(dt); };
+
+        if (run_mode == mode::engines) {
+            step = [&worlds, dt]
+            {
+                auto const target_step = worlds.front()->steps() + 1;
+
+                for (auto &&world : worlds)
+                    world->update(dt);
+
+                for (auto &&world : worlds) {
+                    while (world->steps() < target_step)
+                        std::this_thread::yield();
+                }
+            };
+        }
+
+        result.latencies.reserve(options.steps);
+
+        for (auto step_index = 0u; step_index < options.warmup + options.steps; ++step_index) {
+            auto const start = std::chrono::steady_clock::now();
+
+            for (auto world_index = 0u; world_index < worlds_count; ++world_index)
+                spawn(*worlds[world_index], world_index, step_index, options.spawns);
+
+            step();
+
+            if (step_index >= options.warmup)
+                result.latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        std::sort(std::begin(result.latencies), std::end(result.latencies));
+
+        for (auto &&world : worlds) {
+            result.particles_count += world->particles_count();
+            result.committed_bytes += world->memory_stats().committed_bytes;
+
+            result.hashes.push_back(hash_world(*world));
+        }
+
+        return result;
+    }
+
+    std::int64_t percentile(std::vector<std::int64_t> const &sorted, double fraction)
+    {
+        auto index = static_cast<std::size_t>(fraction * static_cast<double>(sorted.size() - 1) + .5);
+
+        return sorted.at(index);
+    }
+
+    double to_ms(std::int64_t ns)
+    {
+        return static_cast<double>(ns) * 1e-6;
+    }
+
+    // Doubles the worlds, then bisects; returns the most that passed.
+    std::uint32_t sessions_per_host(options const &options, mode run_mode)
+    {
+        std::cout << fmt::format("\n{}\n"s, run_mode == mode::batch ? fmt::format("world batch, {} workers:"s, options.workers)
+                                                                : fmt::format("engine per world, {} workers each:"s, options.engine_workers));
+        std::cout << fmt::format("{:>8} {:>8} {:>10} {:>10} {:>10} {:>12} {:>14}\n"s, "worlds", "threads", "p50 ms", "p99 ms", "max ms", "particles", "committed MiB");
+
+        auto passes = [&options, run_mode] (std::uint32_t worlds_count)
+        {
+            auto const result = run(options, run_mode, worlds_count);
+            auto const p99 = to_ms(percentile(result.latencies, .99));
+
+            std::cout << fmt::format("{:>8} {:>8} {:>10.2f} {:>10.2f} {:>10.2f} {:>12} {:>14.1f}\n"s, worlds_count, result.threads_count,
+                                     to_ms(percentile(result.latencies, .50)), p99, to_ms(result.latencies.back()), result.particles_count,
+                                     static_cast<double>(result.committed_bytes) / static_cast<double>(1 << 20));
+
+            return p99 <= options.slo;
+        };
+
+        auto passed = 0u, failed = 0u;
+
+        for (auto worlds_count = 1u; worlds_count <= options.max_worlds; worlds_count = std::min(worlds_count * 2, options.max_worlds + 1)) {
+            if (!passes(worlds_count)) {
+                failed = worlds_count;
+                break;
+            }
+
+            passed = worlds_count;
+        }
+
+        while (failed != 0 && failed - passed > std::max(passed / 8, 1u)) {
+            auto const worlds_count = passed + (failed - passed) / 2;
+
+            (passes(worlds_count) ? passed : failed) = worlds_count;
+        }
+
+        return passed;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    options options;
+
+    try {
+        options = parse_options(argc, argv);
+    }
+
+    catch (std::invalid_argument const &error) {
+        std::cerr << fmt::format("{}\nusage: world_batch_bench [--slo=ms] [--warmup=N] [--steps=N] [--dt=ms] [--spawns=N] [--capacity=N] [--workers=N] "
+                                 "[--engine-workers=N] [--max-worlds=N] [--check-worlds=N]\n"s, error.what());
+        return 1;
+    }
+
+    std::cout << fmt::format("per world: capacity {}, {} spawns per step; dt: {} ms, steps: {} after {} warmup, p99 objective: {} ms\n"s,
+                             options.capacity, options.spawns, options.dt, options.steps, options.warmup, options.slo);
+
+    // A batched world steps exactly like an engine of its own fed the same.
+    if (options.check_worlds != 0) {
+        auto const batched = run(options, mode::batch, options.check_worlds);
+        auto const standalone = run(options, mode::engines, options.check_worlds);
+
+        auto const match = batched.hashes == standalone.hashes;
+
+        std::cout << fmt::format("batched worlds match engines of their own: {}\n"s, match ? "yes"s : "no"s);
+
+        if (!match)
+            return 1;
+    }
+
+    auto const batch_sessions = sessions_per_host(options, mode::batch);
+    auto const engine_sessions = sessions_per_host(options, mode::engines);
+
+    std::cout << fmt::format("\nsessions per host at p99 <= {} ms: world batch {}{}, engine per world {}{}\n"s, options.slo,
+                             batch_sessions, batch_sessions == options.max_worlds ? "+"s : ""s, engine_sessions, engine_sessions == options.max_worlds ? "+"s : ""s);
+}
@@ -0,0 +1,34 @@
+#include "budget_controller.hxx"
+
+
+namespace app
+{
+    using namespace std::chrono_literals;
+
+    std::array<app::degradation, budget_controller::MAX_LEVEL + 1> const budget_controller::LEVELS{
+        app::degradation{0, false, 0},
+        app::degradation{1, false, 0},
+        app::degradation{2, true, 0},
+        app::degradation{3, true, std::chrono::nanoseconds{250ms}.count()},
+        app::degradation{app::degradation::NO_FAN_OUT, true, std::chrono::nanoseconds{1s}.count()}
+    };
+
+    std::uint32_t budget_controller::update(std::chrono::nanoseconds cost) noexcept
+    {
+        smoothed_cost += (static_cast<double>(cost.count()) - smoothed_cost) * SMOOTHING;
+
+        ++level_steps;
+
+        if (cost.count() > budget && level_ < MAX_LEVEL) {
+            ++level_;
+            level_steps = 0;
+        }
+
+        else if (smoothed_cost < static_cast<double>(budget) * LOWER_FRACTION && level_ > 0 && level_steps >= LOWER_INTERVAL) {
+            --level_;
+            level_steps = 0;
+        }
+
+        return level_;
+    }
+}
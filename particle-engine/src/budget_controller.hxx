@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+#include <array>
+#include <algorithm>
+
+
+namespace app
+{
+    // What the steps give up at a degradation level, the least important first.
+    struct degradation final {
+        // Explosions and cascades make 'count >> fan_out_shift' particles.
+        std::uint32_t fan_out_shift{0};
+
+        // With repulsion, old particles move every other step only.
+        bool half_rate_old{false};
+
+        // ns.
+        std::int64_t cull_horizon{0};
+
+        static std::uint32_t constexpr NO_FAN_OUT{32};
+
+        std::uint32_t fan_out(std::uint32_t count) const noexcept
+        {
+            return fan_out_shift >= NO_FAN_OUT ? 0u : std::max(count >> fan_out_shift, 1u);
+        }
+    };
+
+    // Picks the degradation level of the next step from the measured cost.
+    class budget_controller final {
+    public:
+
+        static std::uint32_t constexpr MAX_LEVEL{4};
+
+        static std::array<app::degradation, MAX_LEVEL + 1> const LEVELS;
+
+        explicit budget_controller(std::chrono::nanoseconds budget) noexcept : budget{budget.count()} { }
+
+        // Returns the level of the next step.
+        std::uint32_t update(std::chrono::nanoseconds cost) noexcept;
+
+        std::uint32_t level() const noexcept { return level_; }
+
+    private:
+
+        static auto constexpr LOWER_FRACTION{.5};
+
+        static std::uint32_t constexpr LOWER_INTERVAL{32};
+
+        static auto constexpr SMOOTHING{.125};
+
+        std::int64_t budget;
+
+        double smoothed_cost{0};
+
+        std::uint32_t level_{0};
+        std::uint32_t level_steps{0};
+    };
+}
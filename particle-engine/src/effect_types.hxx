@@ -0,0 +1,60 @@
+#pragma once
+
+#include "simulation/effect_policies.hxx"
+
+
+namespace app
+{
+    // A slow drifting burst, a quarter of which bursts again.
+    struct classic_effect final : simulation::effect_type<
+        simulation::drag_and_gravity<.999f, 9.81f>,
+        simulation::jittered_life_time<2'000, .5f>,
+        simulation::explode<.25f, simulation::burst<64, 100.f>>,
+        simulation::burst<64, 100.f>
+    > {
+        static auto constexpr name = "classic";
+    };
+
+    // Fast, heavy and short-lived.
+    struct sparks_effect final : simulation::effect_type<
+        simulation::drag_and_gravity<.99f, 120.f>,
+        simulation::jittered_life_time<600, .6f>,
+        simulation::vanish,
+        simulation::burst<24, 180.f>
+    > {
+        static auto constexpr name = "sparks";
+    };
+
+    // Slow, rising and long-lived.
+    struct smoke_effect final : simulation::effect_type<
+        simulation::drag_and_gravity<.995f, -15.f>,
+        simulation::jittered_life_time<3'000, .3f>,
+        simulation::vanish,
+        simulation::burst<32, 25.f>
+    > {
+        static auto constexpr name = "smoke";
+    };
+
+    // The second stage of 'fireworks_effect'.
+    struct firework_stars_effect final : simulation::effect_type<
+        simulation::drag_and_gravity<.995f, 30.f>,
+        simulation::jittered_life_time<900, .3f>,
+        simulation::cascade<.3f, sparks_effect>,
+        simulation::burst<48, 120.f>
+    > {
+        static auto constexpr name = "firework_stars";
+    };
+
+    // Shells that burst into stars.
+    struct fireworks_effect final : simulation::effect_type<
+        simulation::drag_and_gravity<.999f, 20.f>,
+        simulation::jittered_life_time<1'200, .2f>,
+        simulation::cascade<1.f, firework_stars_effect>,
+        simulation::burst<6, 90.f>
+    > {
+        static auto constexpr name = "fireworks";
+    };
+
+    // Frames group the particles by type in this order.
+    using effect_types = simulation::effect_registry<classic_effect, sparks_effect, smoke_effect, firework_stars_effect, fireworks_effect>;
+}
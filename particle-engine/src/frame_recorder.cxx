@@ -0,0 +1,510 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "frame_recorder.hxx"
+#include "utility/profiler.hxx"
+
+
+namespace
+{
+    // 'FILE_MAGIC', version, position scale, then 'frame_header' and payload per frame.
+    auto constexpr FILE_MAGIC = std::array<char, 8>{'P', 'E', 'R', 'E', 'C', '\0', '\0', '\0'};
+
+    struct frame_header final {
+        std::uint64_t step;
+        std::int64_t end_time;
+        std::uint64_t hash;
+
+        std::uint32_t particles_count;
+        std::uint32_t payload_size;
+    };
+
+    // How far ahead a particle is looked for in the previous frame.
+    auto constexpr MATCH_LOOKAHEAD = 64u;
+
+    std::int64_t now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    template<class T>
+    void append(std::vector<std::uint8_t> &bytes, T const &value)
+    {
+        auto const offset = bytes.size();
+
+        bytes.resize(offset + sizeof(value));
+        std::memcpy(bytes.data() + offset, &value, sizeof(value));
+    }
+
+    void append_varint(std::vector<std::uint8_t> &bytes, std::uint32_t value)
+    {
+        for (; value >= 0x80; value >>= 7)
+            bytes.push_back(static_cast<std::uint8_t>(value | 0x80));
+
+        bytes.push_back(static_cast<std::uint8_t>(value));
+    }
+
+    std::uint32_t zigzag(std::int32_t value) noexcept
+    {
+        return (static_cast<std::uint32_t>(value) << 1) ^ static_cast<std::uint32_t>(value >> 31);
+    }
+
+    std::int32_t unzigzag(std::uint32_t value) noexcept
+    {
+        return static_cast<std::int32_t>(value >> 1) ^ -static_cast<std::int32_t>(value & 1);
+    }
+
+    // Reads the payload of one frame; every read past its end throws.
+    class payload_cursor final {
+    public:
+
+        payload_cursor(std::vector<std::uint8_t> const &bytes) : bytes{bytes} { }
+
+        std::uint32_t varint()
+        {
+            std::uint32_t value = 0;
+
+            for (auto shift = 0u; shift < 35; shift += 7) {
+                auto const byte = next();
+
+                value |= static_cast<std::uint32_t>(byte & 0x7F) << shift;
+
+                if ((byte & 0x80) == 0)
+                    return value;
+            }
+
+            throw std::runtime_error("the recording is corrupt");
+        }
+
+        std::uint32_t word()
+        {
+            std::uint32_t value = 0;
+
+            for (auto shift = 0u; shift < 32; shift += 8)
+                value |= static_cast<std::uint32_t>(next()) << shift;
+
+            return value;
+        }
+
+        bool done() const noexcept { return offset == bytes.size(); }
+
+    private:
+
+        std::vector<std::uint8_t> const &bytes;
+
+        std::size_t offset{0};
+
+        std::uint8_t next()
+        {
+            if (offset == bytes.size())
+                throw std::runtime_error("the recording is corrupt");
+
+            return bytes[offset++];
+        }
+    };
+}
+
+namespace app
+{
+    char const *to_string(record_policy policy) noexcept
+    {
+        switch (policy) {
+            case record_policy::block:
+                return "block";
+
+            default:
+                return "drop";
+        }
+    }
+
+    std::uint16_t quantize_color(std::uint32_t color) noexcept
+    {
+        std::uint16_t quantized = 0;
+
+        for (auto channel = 0u; channel < 4; ++channel)
+            quantized |= static_cast<std::uint16_t>(((color >> (channel * 8 + 4)) & 0xF) << (channel * 4));
+
+        return quantized;
+    }
+
+    std::uint32_t dequantize_color(std::uint16_t color) noexcept
+    {
+        std::uint32_t dequantized = 0;
+
+        // 0xF -> 0xFF: a nibble repeated.
+        for (auto channel = 0u; channel < 4; ++channel)
+            dequantized |= ((color >> (channel * 4)) & 0xFu) * 0x11u << (channel * 8);
+
+        return dequantized;
+    }
+
+    frame_recorder::frame_recorder(std::string const &path, std::uint32_t capacity, app::recorder_config const &config)
+        : config{config}, file{path, std::ios::binary | std::ios::trunc}
+    {
+        this->config.slots_count = std::max(config.slots_count, 1u);
+        this->config.position_scale = std::max(config.position_scale, 1u);
+
+        if (!file)
+            throw std::runtime_error("failed to create '" + path + "'");
+
+        slots.resize(this->config.slots_count);
+
+        for (auto &&slot : slots) {
+            slot.x.resize(capacity);
+            slot.y.resize(capacity);
+            slot.color.resize(capacity);
+            slot.id.resize(capacity);
+        }
+
+        chunk.reserve(this->config.chunk_size + std::size_t{capacity} * 16);
+
+        chunk.insert(std::end(chunk), std::begin(FILE_MAGIC), std::end(FILE_MAGIC));
+        append(chunk, FORMAT_VERSION);
+        append(chunk, this->config.position_scale);
+
+        writer = std::thread{[this] { write_frames(); }};
+    }
+
+    frame_recorder::~frame_recorder()
+    {
+        stopping.store(true, std::memory_order_release);
+        wake_writer();
+
+        writer.join();
+    }
+
+    void frame_recorder::wake_writer() noexcept
+    {
+        wake_epoch.fetch_add(1, std::memory_order_release);
+        wake_epoch.notify_one();
+    }
+
+    void frame_recorder::submit(app::frame_data const &frame, std::uint64_t step, std::uint32_t const *palette)
+    {
+        PROFILE_SCOPE(record_submit);
+
+        auto const start = now();
+
+        frames_submitted.fetch_add(1, std::memory_order_relaxed);
+
+        auto const submitted = submitted_count.load(std::memory_order_relaxed);
+
+        for (auto released = released_count.load(std::memory_order_acquire); submitted - released == slots.size();) {
+            if (config.policy == record_policy::drop) {
+                frames_dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            released_count.wait(released, std::memory_order_acquire);
+            released = released_count.load(std::memory_order_acquire);
+        }
+
+        auto &&slot = slots[submitted % slots.size()];
+        auto &&particles = frame.particles;
+
+        slot.step = step;
+        slot.end_time = frame.end_time;
+        slot.particles_count = frame.particles_count;
+
+        if (particles.layout() == simulation::storage_layout::full) {
+            std::copy_n(particles.x, frame.particles_count, std::begin(slot.x));
+            std::copy_n(particles.y, frame.particles_count, std::begin(slot.y));
+            std::copy_n(particles.color, frame.particles_count, std::begin(slot.color));
+        }
+
+        // Quantized, decoded as they would be drawn.
+        else {
+            for (auto i = 0u; i < frame.particles_count; ++i) {
+                auto const vertex = app::particle_engine::compact_vertex(particles, i, palette);
+
+                slot.x[i] = vertex.x;
+                slot.y[i] = vertex.y;
+                slot.color[i] = vertex.color;
+            }
+        }
+
+        std::copy_n(particles.id, frame.particles_count, std::begin(slot.id));
+
+        submitted_count.store(submitted + 1, std::memory_order_release);
+        wake_writer();
+
+        auto const duration = now() - start;
+
+        submit_time.fetch_add(duration, std::memory_order_relaxed);
+
+        if (duration > max_submit_time.load(std::memory_order_relaxed))
+            max_submit_time.store(duration, std::memory_order_relaxed);
+    }
+
+    void frame_recorder::flush()
+    {
+        auto const target = submitted_count.load(std::memory_order_acquire);
+
+        if (target > flush_target.load(std::memory_order_relaxed))
+            flush_target.store(target, std::memory_order_release);
+
+        wake_writer();
+
+        // Dropped frames never take a slot.
+        for (auto flushed = flushed_count.load(std::memory_order_acquire); flushed < target; flushed = flushed_count.load(std::memory_order_acquire))
+            flushed_count.wait(flushed, std::memory_order_acquire);
+
+        if (failed.load(std::memory_order_acquire))
+            throw std::runtime_error("failed to write the recording");
+    }
+
+    recorder_statistics frame_recorder::stats() const noexcept
+    {
+        recorder_statistics stats;
+
+        stats.frames_submitted = frames_submitted.load(std::memory_order_relaxed);
+        stats.frames_recorded = released_count.load(std::memory_order_relaxed);
+        stats.frames_dropped = frames_dropped.load(std::memory_order_relaxed);
+        stats.raw_bytes = raw_bytes.load(std::memory_order_relaxed);
+        stats.written_bytes = written_bytes.load(std::memory_order_relaxed);
+        stats.writer_time = writer_time.load(std::memory_order_relaxed);
+        stats.submit_time = submit_time.load(std::memory_order_relaxed);
+        stats.max_submit_time = max_submit_time.load(std::memory_order_relaxed);
+
+        return stats;
+    }
+
+    void frame_recorder::write_frames()
+    {
+        PROFILE_THREAD_NAME("recorder");
+
+        for (std::uint64_t encoded = 0;;) {
+            auto const epoch = wake_epoch.load(std::memory_order_acquire);
+
+            if (encoded == submitted_count.load(std::memory_order_acquire)) {
+                auto const stop = stopping.load(std::memory_order_acquire);
+
+                if (flushed_count.load(std::memory_order_relaxed) != encoded && (stop || flush_target.load(std::memory_order_acquire) > flushed_count.load(std::memory_order_relaxed))) {
+                    auto const start = now();
+
+                    write_chunk();
+                    file.flush();
+
+                    writer_time.fetch_add(now() - start, std::memory_order_relaxed);
+
+                    if (!file)
+                        failed.store(true, std::memory_order_release);
+
+                    flushed_count.store(encoded, std::memory_order_release);
+                    flushed_count.notify_all();
+                }
+
+                if (stop)
+                    break;
+
+                wake_epoch.wait(epoch, std::memory_order_acquire);
+                continue;
+            }
+
+            auto const start = now();
+
+            encode(slots[encoded % slots.size()]);
+
+            released_count.store(++encoded, std::memory_order_release);
+            released_count.notify_one();
+
+            if (chunk.size() >= config.chunk_size)
+                write_chunk();
+
+            writer_time.fetch_add(now() - start, std::memory_order_relaxed);
+        }
+
+        // Nothing was ever recorded: still a valid, empty, recording.
+        write_chunk();
+        file.flush();
+    }
+
+    void frame_recorder::encode(slot const &slot)
+    {
+        auto const count = slot.particles_count;
+        auto const scale = static_cast<float>(config.position_scale);
+
+        auto const header_offset = chunk.size();
+        chunk.resize(header_offset + sizeof(frame_header));
+
+        auto const payload_offset = chunk.size();
+
+        auto &&x = current_x;
+        auto &&y = current_y;
+        auto &&color = current_color;
+
+        x.resize(count);
+        y.resize(count);
+        color.resize(count);
+
+        std::uint64_t hash = 0xCBF29CE484222325;
+
+        auto const previous_count = static_cast<std::uint32_t>(previous_id.size());
+
+        auto cursor = 0u;
+
+        std::int32_t literal_x = 0, literal_y = 0;
+        std::uint16_t literal_color = 0;
+
+        for (auto i = 0u; i < count; ++i) {
+            for (auto word : {std::bit_cast<std::uint32_t>(slot.x[i]), std::bit_cast<std::uint32_t>(slot.y[i]), slot.color[i], slot.id[i]})
+                hash = (hash ^ word) * 0x100000001B3;
+
+            x[i] = static_cast<std::int32_t>(std::lrint(slot.x[i] * scale));
+            y[i] = static_cast<std::int32_t>(std::lrint(slot.y[i] * scale));
+            color[i] = quantize_color(slot.color[i]);
+
+            auto match = cursor;
+
+            for (auto const end = std::min(cursor + MATCH_LOOKAHEAD, previous_count); match < end && previous_id[match] != slot.id[i];)
+                ++match;
+
+            if (match < previous_count && previous_id[match] == slot.id[i]) {
+                append_varint(chunk, match - cursor + 1);
+                append_varint(chunk, zigzag(x[i] - previous_x[match]));
+                append_varint(chunk, zigzag(y[i] - previous_y[match]));
+                append_varint(chunk, static_cast<std::uint32_t>(color[i] ^ previous_color[match]));
+
+                cursor = match + 1;
+            }
+
+            else {
+                append_varint(chunk, 0);
+
+                for (auto shift = 0u; shift < 32; shift += 8)
+                    chunk.push_back(static_cast<std::uint8_t>(slot.id[i] >> shift));
+
+                append_varint(chunk, zigzag(x[i] - std::exchange(literal_x, x[i])));
+                append_varint(chunk, zigzag(y[i] - std::exchange(literal_y, y[i])));
+                append_varint(chunk, static_cast<std::uint32_t>(color[i] ^ std::exchange(literal_color, color[i])));
+            }
+        }
+
+        frame_header header{slot.step, slot.end_time, hash, count, static_cast<std::uint32_t>(chunk.size() - payload_offset)};
+        std::memcpy(chunk.data() + header_offset, &header, sizeof(header));
+
+        std::swap(previous_x, current_x);
+        std::swap(previous_y, current_y);
+        std::swap(previous_color, current_color);
+        previous_id.assign(std::begin(slot.id), std::begin(slot.id) + count);
+
+        raw_bytes.fetch_add(std::uint64_t{count} * 16, std::memory_order_relaxed);
+    }
+
+    void frame_recorder::write_chunk()
+    {
+        if (chunk.empty())
+            return;
+
+        file.write(reinterpret_cast<char const *>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+
+        if (!file)
+            failed.store(true, std::memory_order_release);
+
+        written_bytes.fetch_add(chunk.size(), std::memory_order_relaxed);
+
+        chunk.clear();
+    }
+
+    recording_reader::recording_reader(std::string const &path) : file{path, std::ios::binary}
+    {
+        if (!file)
+            throw std::runtime_error("failed to open '" + path + "'");
+
+        std::array<char, 8> magic{};
+        std::uint32_t version = 0;
+
+        file.read(magic.data(), magic.size());
+        file.read(reinterpret_cast<char *>(&version), sizeof(version));
+        file.read(reinterpret_cast<char *>(&scale), sizeof(scale));
+
+        if (!file || magic != FILE_MAGIC)
+            throw std::runtime_error("'" + path + "' is not a recording");
+
+        if (version != frame_recorder::FORMAT_VERSION || scale == 0)
+            throw std::runtime_error("'" + path + "' is a recording of another version");
+    }
+
+    bool recording_reader::next(app::recorded_frame &frame)
+    {
+        frame_header header;
+
+        file.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+        if (file.gcount() == 0 && file.eof())
+            return false;
+
+        payload.resize(header.payload_size);
+        file.read(reinterpret_cast<char *>(payload.data()), static_cast<std::streamsize>(payload.size()));
+
+        if (!file)
+            throw std::runtime_error("the recording is truncated");
+
+        auto const count = header.particles_count;
+        auto const inverse_scale = 1.f / static_cast<float>(scale);
+
+        frame.step = header.step;
+        frame.end_time = header.end_time;
+        frame.hash = header.hash;
+
+        frame.x.resize(count);
+        frame.y.resize(count);
+        frame.color.resize(count);
+        frame.id.resize(count);
+
+        std::vector<std::int32_t> x(count), y(count);
+        std::vector<std::uint16_t> color(count);
+
+        payload_cursor cursor{payload};
+
+        auto const previous_count = static_cast<std::uint32_t>(previous_id.size());
+
+        auto expected = 0u;
+
+        std::int32_t literal_x = 0, literal_y = 0;
+        std::uint16_t literal_color = 0;
+
+        for (auto i = 0u; i < count; ++i) {
+            if (auto const skip = cursor.varint(); skip != 0) {
+                auto const match = expected + skip - 1;
+
+                if (match >= previous_count)
+                    throw std::runtime_error("the recording is corrupt");
+
+                frame.id[i] = previous_id[match];
+                x[i] = previous_x[match] + unzigzag(cursor.varint());
+                y[i] = previous_y[match] + unzigzag(cursor.varint());
+                color[i] = static_cast<std::uint16_t>(previous_color[match] ^ cursor.varint());
+
+                expected = match + 1;
+            }
+
+            else {
+                frame.id[i] = cursor.word();
+                x[i] = literal_x += unzigzag(cursor.varint());
+                y[i] = literal_y += unzigzag(cursor.varint());
+                color[i] = literal_color = static_cast<std::uint16_t>(literal_color ^ cursor.varint());
+            }
+
+            frame.x[i] = static_cast<float>(x[i]) * inverse_scale;
+            frame.y[i] = static_cast<float>(y[i]) * inverse_scale;
+            frame.color[i] = dequantize_color(color[i]);
+        }
+
+        if (!cursor.done())
+            throw std::runtime_error("the recording is corrupt");
+
+        previous_x = std::move(x);
+        previous_y = std::move(y);
+        previous_color = std::move(color);
+        previous_id = frame.id;
+
+        return true;
+    }
+}
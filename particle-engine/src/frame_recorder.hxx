@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "particle_engine.hxx"
+
+
+namespace app
+{
+    enum class record_policy : std::uint8_t {
+        // Drop a frame when every slot is taken; the steps never wait.
+        drop = 0,
+
+        // Wait for a slot: the steps slow down to the writer's pace.
+        block
+    };
+
+    char const *to_string(record_policy policy) noexcept;
+
+    struct recorder_config final {
+        std::uint32_t slots_count{4};
+
+        record_policy policy{record_policy::drop};
+
+        std::size_t chunk_size{std::size_t{1} << 20};
+
+        // Colors are quantized to 4 bits per channel.
+        std::uint32_t position_scale{16};
+    };
+
+    struct recorder_statistics final {
+        std::uint64_t frames_submitted{0};
+        std::uint64_t frames_recorded{0};
+        std::uint64_t frames_dropped{0};
+
+        // In memory and on disk.
+        std::uint64_t raw_bytes{0};
+        std::uint64_t written_bytes{0};
+
+        // ns.
+        std::int64_t writer_time{0};
+
+        // ns.
+        std::int64_t submit_time{0};
+        std::int64_t max_submit_time{0};
+    };
+
+    // Delta encodes the frames an engine publishes to a file on a writer thread.
+    class frame_recorder final {
+    public:
+
+        // Throws std::runtime_error if the file can not be created.
+        frame_recorder(std::string const &path, std::uint32_t capacity, app::recorder_config const &config = {});
+
+        ~frame_recorder();
+
+        frame_recorder(frame_recorder const &) = delete;
+        frame_recorder &operator= (frame_recorder const &) = delete;
+
+        // Called by the engine, one frame at a time.
+        void submit(app::frame_data const &frame, std::uint64_t step, std::uint32_t const *palette = nullptr);
+
+        // Throws std::runtime_error if writing failed.
+        void flush();
+
+        recorder_statistics stats() const noexcept;
+
+        static std::uint32_t constexpr FORMAT_VERSION{1};
+
+    private:
+
+        struct slot final {
+            std::uint64_t step{0};
+            std::int64_t end_time{0};
+
+            std::uint32_t particles_count{0};
+
+            std::vector<float> x;
+            std::vector<float> y;
+            std::vector<std::uint32_t> color;
+            std::vector<std::uint32_t> id;
+        };
+
+        app::recorder_config config;
+
+        std::ofstream file;
+
+        std::vector<slot> slots;
+
+        // Their difference is the slots taken.
+        alignas(64) std::atomic_uint64_t submitted_count{0};
+        alignas(64) std::atomic_uint64_t released_count{0};
+
+        std::atomic_uint64_t flush_target{0};
+        std::atomic_uint64_t flushed_count{0};
+
+        // Wakes the writer up.
+        std::atomic_uint32_t wake_epoch{0};
+        std::atomic_bool stopping{false};
+
+        std::atomic_bool failed{false};
+
+        // Each with a single writer.
+        std::atomic_uint64_t frames_submitted{0};
+        std::atomic_uint64_t frames_dropped{0};
+        std::atomic_uint64_t raw_bytes{0};
+        std::atomic_uint64_t written_bytes{0};
+        std::atomic_int64_t writer_time{0};
+        std::atomic_int64_t submit_time{0};
+        std::atomic_int64_t max_submit_time{0};
+
+        // Writer thread only.
+        std::vector<std::int32_t> previous_x;
+        std::vector<std::int32_t> previous_y;
+        std::vector<std::uint16_t> previous_color;
+        std::vector<std::uint32_t> previous_id;
+
+        std::vector<std::int32_t> current_x;
+        std::vector<std::int32_t> current_y;
+        std::vector<std::uint16_t> current_color;
+
+        std::vector<std::uint8_t> chunk;
+
+        std::thread writer;
+
+        void write_frames();
+
+        void encode(slot const &slot);
+
+        void write_chunk();
+
+        void wake_writer() noexcept;
+    };
+
+    // A decoded frame: positions and colors as quantized by the recorder.
+    struct recorded_frame final {
+        std::uint64_t step{0};
+        std::int64_t end_time{0};
+
+        // Of the exact frame particles.
+        std::uint64_t hash{0};
+
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<std::uint32_t> color; // RGBA8, red in the lowest byte
+        std::vector<std::uint32_t> id;
+    };
+
+    // Decodes a 'frame_recorder' file frame by frame.
+    class recording_reader final {
+    public:
+
+        // Throws std::runtime_error if the file can not be read as a recording.
+        explicit recording_reader(std::string const &path);
+
+        // False at the end; throws std::runtime_error if the file is corrupt.
+        bool next(app::recorded_frame &frame);
+
+        std::uint32_t position_scale() const noexcept { return scale; }
+
+    private:
+
+        std::ifstream file;
+
+        std::uint32_t scale{1};
+
+        std::vector<std::uint8_t> payload;
+
+        std::vector<std::int32_t> previous_x;
+        std::vector<std::int32_t> previous_y;
+        std::vector<std::uint16_t> previous_color;
+        std::vector<std::uint32_t> previous_id;
+    };
+
+    // What the recorder keeps of a color, and what the reader restores from it.
+    std::uint16_t quantize_color(std::uint32_t color) noexcept;
+    std::uint32_t dequantize_color(std::uint16_t color) noexcept;
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
 #include <string>
 using namespace std::string_literals;
 
@@ -32,6 +35,7 @@ using namespace std::string_literals;
 #endif
 
 #include "platform/window.hxx"
+#include "simulation/particle_storage.hxx"
 
 
 namespace gfx {
@@ -70,4 +74,42 @@ namespace gfx {
         glColor4f(r, g, b, a);
         glVertex2f(x, y);
     }
+
+    // One streaming buffer, one draw call.
+    class point_stream final {
+    public:
+
+        point_stream() { glGenBuffers(1, &buffer); }
+        ~point_stream() { glDeleteBuffers(1, &buffer); }
+
+        point_stream(point_stream const &) = delete;
+        point_stream &operator=(point_stream const &) = delete;
+
+        void draw(simulation::point_vertex const *vertices, std::uint32_t count)
+        {
+            auto constexpr stride = static_cast<GLsizei>(sizeof(simulation::point_vertex));
+
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+            // Orphans last frame's storage, so the upload does not wait for the draw.
+            glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(count * sizeof(simulation::point_vertex)), vertices, GL_STREAM_DRAW);
+
+            glEnableClientState(GL_VERTEX_ARRAY);
+            glEnableClientState(GL_COLOR_ARRAY);
+
+            glVertexPointer(2, GL_FLOAT, stride, reinterpret_cast<void const *>(offsetof(simulation::point_vertex, x)));
+            glColorPointer(4, GL_UNSIGNED_BYTE, stride, reinterpret_cast<void const *>(offsetof(simulation::point_vertex, color)));
+
+            glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(count));
+
+            glDisableClientState(GL_COLOR_ARRAY);
+            glDisableClientState(GL_VERTEX_ARRAY);
+
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+    private:
+
+        GLuint buffer{0};
+    };
 }
@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "software_rasterizer.hxx"
+
+
+namespace
+{
+    // GL blending on unorm8 channels, two at a time in 16 bit lanes.
+    inline std::uint32_t blend(std::uint32_t source, std::uint32_t destination) noexcept
+    {
+        auto constexpr LANES_MASK = 0x00FF'00FFu;
+
+        auto const alpha = source >> 24;
+
+        auto lanes = [alpha] (std::uint32_t s, std::uint32_t d)
+        {
+            auto const v = s * alpha + d * (255 - alpha) + 0x007F'007Fu;
+
+            return ((v + 0x0001'0001u + ((v >> 8) & LANES_MASK)) >> 8) & LANES_MASK;
+        };
+
+        return lanes(source & LANES_MASK, destination & LANES_MASK) | (lanes((source >> 8) & LANES_MASK, (destination >> 8) & LANES_MASK) << 8);
+    }
+}
+
+namespace gfx
+{
+    software_rasterizer::software_rasterizer(std::uint32_t width, std::uint32_t height, bool depth_test, std::uint32_t tile_size)
+        : width_{std::max(width, 1u)}, height_{std::max(height, 1u)}, depth_test{depth_test}, tile_size{std::max(tile_size, 2u)},
+          columns{(width_ + this->tile_size - 1) / this->tile_size}, rows{(height_ + this->tile_size - 1) / this->tile_size},
+          image(std::size_t{width_} * height_, CLEAR_COLOR), tile_begin(std::size_t{columns} * rows + 1, 0)
+    {
+        count_task = jobs::make_task(
+            [this] (std::uint32_t begin, std::uint32_t end, std::uint32_t)
+            {
+                for (auto job = begin; job < end; ++job)
+                    count_points(job);
+            },
+            [this] (std::uint32_t)
+            {
+                prefix_sum();
+
+                pool->submit(*scatter_task, jobs_count);
+            }
+        );
+
+        scatter_task = jobs::make_task(
+            [this] (std::uint32_t begin, std::uint32_t end, std::uint32_t)
+            {
+                for (auto job = begin; job < end; ++job)
+                    scatter_points(job);
+            },
+            [this] (std::uint32_t)
+            {
+                pool->submit(*raster_task, columns * rows);
+            }
+        );
+
+        raster_task = jobs::make_task(
+            [this] (std::uint32_t begin, std::uint32_t end, std::uint32_t worker_index)
+            {
+                for (auto tile = begin; tile < end; ++tile)
+                    rasterize_tile(tile, worker_index);
+            },
+            [this] (std::uint32_t)
+            {
+                done.store(true, std::memory_order_release);
+            }
+        );
+    }
+
+    software_rasterizer::~software_rasterizer() = default;
+
+    void software_rasterizer::draw(jobs::job_system &pool, simulation::point_vertex const *vertices, std::uint32_t count, float view_width, float view_height)
+    {
+        this->pool = &pool;
+        this->vertices = vertices;
+        this->count = count;
+
+        scale_x = static_cast<float>(width_) / view_width;
+        scale_y = static_cast<float>(height_) / view_height;
+
+        // At least one job, so that an empty stream still clears the image.
+        jobs_count = std::max((count + POINTS_PER_JOB - 1) / POINTS_PER_JOB, 1u);
+
+        if (points.size() < count)
+            points.resize(count);
+
+        job_tile_offsets.assign(std::size_t{jobs_count} * columns * rows, 0);
+
+        if (covered.size() < pool.workers_count())
+            covered.resize(pool.workers_count(), std::vector<std::uint8_t>(std::size_t{tile_size} * tile_size));
+
+        done.store(false, std::memory_order_relaxed);
+
+        pool.submit(*count_task, jobs_count);
+
+        while (!done.load(std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+
+    software_rasterizer::binned_point software_rasterizer::bin(simulation::point_vertex const &vertex) const noexcept
+    {
+        // The 2x2 within 1 px of the point, clamped to fit 16 bits.
+        auto const limit = static_cast<float>(std::max(width_, height_)) + 4.f;
+
+        auto const x = std::clamp(vertex.x * scale_x - .5f, -limit, limit);
+        auto const y = std::clamp(vertex.y * scale_y - .5f, -limit, limit);
+
+        auto const column = static_cast<std::int32_t>(std::floor(x));
+
+        // GL rows count up from the bottom.
+        auto const row = static_cast<std::int32_t>(height_) - 2 - static_cast<std::int32_t>(std::floor(y));
+
+        return binned_point{static_cast<std::int16_t>(column), static_cast<std::int16_t>(row), vertex.color};
+    }
+
+    template<class F>
+    void software_rasterizer::for_each_tile(binned_point const &point, F &&f) const
+    {
+        std::int32_t const column = point.column, row = point.row;
+
+        auto const width = static_cast<std::int32_t>(width_);
+        auto const height = static_cast<std::int32_t>(height_);
+
+        if (column + 1 < 0 || column >= width || row + 1 < 0 || row >= height)
+            return;
+
+        auto const size = static_cast<std::int32_t>(tile_size);
+
+        auto const first_column = std::max(column, 0) / size, last_column = std::min(column + 1, width - 1) / size;
+        auto const first_row = std::max(row, 0) / size, last_row = std::min(row + 1, height - 1) / size;
+
+        for (auto tile_row = first_row; tile_row <= last_row; ++tile_row) {
+            for (auto tile_column = first_column; tile_column <= last_column; ++tile_column)
+                f(static_cast<std::uint32_t>(tile_row) * columns + static_cast<std::uint32_t>(tile_column));
+        }
+    }
+
+    void software_rasterizer::count_points(std::uint32_t job)
+    {
+        auto const counts = job_tile_offsets.data() + std::size_t{job} * columns * rows;
+
+        for (auto i = job * POINTS_PER_JOB; i < std::min((job + 1) * POINTS_PER_JOB, count); ++i) {
+            points[i] = bin(vertices[i]);
+
+            for_each_tile(points[i], [counts] (std::uint32_t tile) { ++counts[tile]; });
+        }
+    }
+
+    void software_rasterizer::prefix_sum()
+    {
+        auto const tiles_count = columns * rows;
+
+        // Every tile's points come out in the stream order.
+        auto sum = 0u;
+
+        for (auto tile = 0u; tile < tiles_count; ++tile) {
+            tile_begin[tile] = sum;
+
+            for (auto job = 0u; job < jobs_count; ++job)
+                sum += std::exchange(job_tile_offsets[std::size_t{job} * tiles_count + tile], sum);
+        }
+
+        tile_begin[tiles_count] = sum;
+
+        if (bins.size() < sum)
+            bins.resize(sum);
+    }
+
+    void software_rasterizer::scatter_points(std::uint32_t job)
+    {
+        auto const offsets = job_tile_offsets.data() + std::size_t{job} * columns * rows;
+
+        for (auto i = job * POINTS_PER_JOB; i < std::min((job + 1) * POINTS_PER_JOB, count); ++i)
+            for_each_tile(points[i], [this, offsets, i] (std::uint32_t tile) { bins[offsets[tile]++] = points[i]; });
+    }
+
+    void software_rasterizer::rasterize_tile(std::uint32_t tile, std::uint32_t worker_index)
+    {
+        auto const first_column = static_cast<std::int32_t>(tile % columns * tile_size);
+        auto const first_row = static_cast<std::int32_t>(tile / columns * tile_size);
+
+        auto const last_column = std::min(first_column + static_cast<std::int32_t>(tile_size), static_cast<std::int32_t>(width_));
+        auto const last_row = std::min(first_row + static_cast<std::int32_t>(tile_size), static_cast<std::int32_t>(height_));
+
+        for (auto row = first_row; row < last_row; ++row)
+            std::fill_n(image.data() + static_cast<std::size_t>(row) * width_ + first_column, last_column - first_column, CLEAR_COLOR);
+
+        auto &&tile_covered = covered[worker_index];
+
+        if (depth_test)
+            std::fill(std::begin(tile_covered), std::end(tile_covered), std::uint8_t{0});
+
+        for (auto b = tile_begin[tile]; b < tile_begin[tile + 1]; ++b) {
+            auto &&point = bins[b];
+
+            std::int32_t const column = point.column, row = point.row;
+
+            for (auto y = std::max(row, first_row); y < std::min(row + 2, last_row); ++y) {
+                for (auto x = std::max(column, first_column); x < std::min(column + 2, last_column); ++x) {
+                    if (depth_test) {
+                        auto &&is_covered = tile_covered[static_cast<std::size_t>(y - first_row) * tile_size + static_cast<std::size_t>(x - first_column)];
+
+                        if (is_covered != 0)
+                            continue;
+
+                        is_covered = 1;
+                    }
+
+                    auto &&pixel = image[static_cast<std::size_t>(y) * width_ + static_cast<std::size_t>(x)];
+                    pixel = blend(point.color, pixel);
+                }
+            }
+        }
+    }
+
+    void software_rasterizer::write_ppm(std::string const &path) const
+    {
+        std::ofstream file{path, std::ios::binary};
+
+        file << "P6\n" << width_ << ' ' << height_ << "\n255\n";
+
+        std::vector<char> row(std::size_t{width_} * 3);
+
+        for (auto y = 0u; y < height_ && file; ++y) {
+            for (auto x = 0u; x < width_; ++x) {
+                auto const pixel = image[std::size_t{y} * width_ + x];
+
+                row[x * 3 + 0] = static_cast<char>(pixel & 0xFF);
+                row[x * 3 + 1] = static_cast<char>((pixel >> 8) & 0xFF);
+                row[x * 3 + 2] = static_cast<char>((pixel >> 16) & 0xFF);
+            }
+
+            file.write(row.data(), static_cast<std::streamsize>(row.size()));
+        }
+
+        if (!file)
+            throw std::runtime_error("failed to write '" + path + "'");
+    }
+}
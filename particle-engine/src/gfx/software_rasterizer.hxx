@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "jobs/job_system.hxx"
+#include "simulation/particle_storage.hxx"
+
+
+namespace gfx
+{
+    // The viewer's point drawing on the CPU, tile by tile on a pool.
+    class software_rasterizer final {
+    public:
+
+        // The viewer's 'GL_LESS' depth test: only the first point per pixel blends.
+        software_rasterizer(std::uint32_t width, std::uint32_t height, bool depth_test = true, std::uint32_t tile_size = 64);
+
+        ~software_rasterizer();
+
+        software_rasterizer(software_rasterizer const &) = delete;
+        software_rasterizer &operator= (software_rasterizer const &) = delete;
+
+        // Blocks until the image is done; not from a 'pool' worker.
+        void draw(jobs::job_system &pool, simulation::point_vertex const *vertices, std::uint32_t count, float view_width, float view_height);
+
+        // Top row first, red in the lowest byte.
+        std::uint32_t const *pixels() const noexcept { return image.data(); }
+
+        std::uint32_t width() const noexcept { return width_; }
+        std::uint32_t height() const noexcept { return height_; }
+
+        // Binary PPM; throws std::runtime_error on failure.
+        void write_ppm(std::string const &path) const;
+
+        // 'glClearColor' of the viewer.
+        static std::uint32_t constexpr CLEAR_COLOR{0xFF'99'41'00};
+
+    private:
+
+        static std::uint32_t constexpr POINTS_PER_JOB{4096};
+
+        std::uint32_t width_;
+        std::uint32_t height_;
+
+        bool depth_test;
+
+        std::uint32_t tile_size;
+        std::uint32_t columns;
+        std::uint32_t rows;
+
+        std::vector<std::uint32_t> image;
+
+        // Job major; the counts, then the job's next slot in 'bins'.
+        std::vector<std::uint32_t> job_tile_offsets;
+
+        // Plus the end of the last tile.
+        std::vector<std::uint32_t> tile_begin;
+
+        // Top left pixel of the 2x2 a point covers, and its color.
+        struct binned_point final {
+            std::int16_t column;
+            std::int16_t row;
+
+            std::uint32_t color;
+        };
+
+        std::vector<binned_point> points;
+
+        // Copies in stream order per tile, so a tile reads its points sequentially.
+        std::vector<binned_point> bins;
+
+        // One tile per worker; for the depth test.
+        std::vector<std::vector<std::uint8_t>> covered;
+
+        simulation::point_vertex const *vertices{nullptr};
+        std::uint32_t count{0};
+        std::uint32_t jobs_count{0};
+        float scale_x{1};
+        float scale_y{1};
+
+        jobs::job_system *pool{nullptr};
+
+        std::atomic_bool done{false};
+
+        // count -> (prefix sum) -> scatter -> rasterize
+        std::unique_ptr<jobs::task> count_task;
+        std::unique_ptr<jobs::task> scatter_task;
+        std::unique_ptr<jobs::task> raster_task;
+
+        binned_point bin(simulation::point_vertex const &vertex) const noexcept;
+
+        // Calls 'f(tile)' for every tile 'point' overlaps.
+        template<class F>
+        void for_each_tile(binned_point const &point, F &&f) const;
+
+        void count_points(std::uint32_t job);
+        void prefix_sum();
+        void scatter_points(std::uint32_t job);
+        void rasterize_tile(std::uint32_t tile, std::uint32_t worker_index);
+    };
+}
@@ -0,0 +1,969 @@
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <string>
+using namespace std::string_literals;
+
+#pragma warning(disable : 4275)
+#include <fmt/format.h>
+#pragma warning(default : 4275)
+
+#include "config.hxx"
+#include "particle_engine.hxx"
+#include "frame_recorder.hxx"
+#include "input_dispatcher.hxx"
+#include "gfx/software_rasterizer.hxx"
+#include "simulation/integrate.hxx"
+#include "utility/profiler.hxx"
+#include "utility/topology.hxx"
+
+
+namespace
+{
+    struct options final {
+        std::uint64_t steps{2'000};
+        std::uint64_t warmup_steps{200};
+
+        std::chrono::nanoseconds dt{std::chrono::milliseconds{5}};
+
+        std::uint64_t spawn_period{4}; // steps
+        std::uint32_t spawns_per_period{1};
+
+        std::uint32_t seed{1};
+
+        // Indices in 'app::effect_types' the spawned effects cycle through.
+        std::vector<std::uint32_t> effect_types{0};
+
+        // The workers count comes from 'workers'.
+        app::engine_config engine;
+
+        // Profiling builds only: the summary period in updates, and the trace path.
+        std::uint64_t summary_period{0};
+        std::string trace_path;
+
+        // Non-empty: every run writes its final frame here as a PPM.
+        std::string image_path;
+
+        // Non-empty: the runs start from this snapshot; the first saves to that one.
+        std::string load_snapshot_path;
+        std::string save_snapshot_path;
+
+        // Non-empty: the first run records every frame here.
+        std::string record_path;
+        app::recorder_config recorder;
+
+        // Non-zero: clicks a second, replayed from this file if non-empty.
+        std::uint32_t clicks_per_second{0};
+        std::string input_path;
+        std::string save_input_path;
+
+        // One run per entry: a list gives the scaling curve.
+        std::vector<std::uint32_t> workers{app::particle_engine::default_workers_count()};
+    };
+
+    struct run_result final {
+        std::uint32_t workers_count{0};
+        std::uint32_t nodes_count{1};
+        std::uint32_t final_particles_count{0};
+
+        // Equal hashes across runs and worker counts mean bit-identical final frames.
+        std::uint64_t final_state_hash{0};
+
+        // None ever should.
+        std::uint32_t duplicate_ids{0};
+
+        // FNV-1a over the vertex stream, and whether it matches the particles.
+        std::uint64_t vertices_hash{0};
+        bool vertices_match{true};
+
+        // FNV-1a over the final image pixels.
+        std::uint64_t image_hash{0};
+
+        // s.
+        double snapshot_load_time{0};
+        double snapshot_save_time{0};
+
+        // With '--record': whether the last recorded frame decodes to the final one.
+        app::recorder_statistics recording;
+        std::uint64_t decoded_frames_count{0};
+        bool recording_matches{true};
+
+        double elapsed{0}; // s
+
+        // More or fewer than the updates with '--fixed-step'.
+        std::uint64_t steps_count{0};
+        std::uint64_t particles_processed{0};
+
+        std::chrono::nanoseconds dropped_time{0};
+
+        std::vector<std::int64_t> latencies; // ns, sorted
+
+        // Sorted by id; only when asked for.
+        std::vector<std::tuple<std::uint32_t, float, float>> final_particles;
+
+        app::memory_statistics memory;
+
+        app::spawn_statistics spawn;
+        app::budget_statistics budget;
+
+        // With input: the clicks and their latency to the first frame showing them.
+        std::uint64_t clicks_count{0};
+        std::uint64_t ring_dropped{0};
+        app::dispatch_statistics dispatch;
+        utility::latency_summary input_latency;
+    };
+
+    template<class T>
+    T parse_value(std::string_view name, std::string_view value)
+    {
+        T result{};
+
+        if (auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result); ec != std::errc{} || ptr != value.data() + value.size())
+            throw std::invalid_argument(fmt::format("invalid value '{}' for '{}'"s, value, name));
+
+        return result;
+    }
+
+    // Fractional milliseconds, e.g. '0.25'.
+    std::chrono::nanoseconds parse_milliseconds(std::string_view name, std::string_view value)
+    {
+        return std::chrono::round<std::chrono::nanoseconds>(std::chrono::duration<double, std::milli>{parse_value<double>(name, value)});
+    }
+
+    options parse_options(int argc, char **argv)
+    {
+        options options;
+
+        for (auto i = 1; i < argc; ++i) {
+            std::string_view argument{argv[i]};
+
+            auto separator = argument.find('=');
+
+            if (separator == std::string_view::npos)
+                throw std::invalid_argument(fmt::format("expected '--name=value', got '{}'"s, argument));
+
+            auto name = argument.substr(0, separator);
+            auto value = argument.substr(separator + 1);
+
+            if (name == "--steps")
+                options.steps = parse_value<std::uint64_t>(name, value);
+
+            else if (name == "--warmup")
+                options.warmup_steps = parse_value<std::uint64_t>(name, value);
+
+            else if (name == "--dt")
+                options.dt = parse_milliseconds(name, value);
+
+            else if (name == "--fixed-step")
+                options.engine.fixed_step = parse_milliseconds(name, value);
+
+            else if (name == "--budget")
+                options.engine.step_budget = parse_milliseconds(name, value);
+
+            else if (name == "--max-steps")
+                options.engine.max_steps_per_update = parse_value<std::uint32_t>(name, value);
+
+            else if (name == "--spawn-period")
+                options.spawn_period = std::max(parse_value<std::uint64_t>(name, value), std::uint64_t{1});
+
+            else if (name == "--spawns")
+                options.spawns_per_period = parse_value<std::uint32_t>(name, value);
+
+            else if (name == "--seed")
+                options.seed = parse_value<std::uint32_t>(name, value);
+
+            else if (name == "--capacity")
+                options.engine.capacity = std::max(parse_value<std::uint32_t>(name, value), 1u);
+
+            else if (name == "--pages") {
+                if (value == "regular")
+                    options.engine.page_policy = utility::page_policy::regular;
+
+                else if (value == "transparent")
+                    options.engine.page_policy = utility::page_policy::transparent_huge;
+
+                else if (value == "explicit")
+                    options.engine.page_policy = utility::page_policy::explicit_huge;
+
+                else throw std::invalid_argument(fmt::format("invalid value '{}' for '{}'"s, value, name));
+            }
+
+            else if (name == "--grow")
+                options.engine.grow_on_demand = parse_value<std::uint32_t>(name, value) != 0;
+
+            else if (name == "--grid-cell")
+                options.engine.grid_cell_size = parse_value<float>(name, value);
+
+            else if (name == "--interaction-radius")
+                options.engine.interaction_radius = parse_value<float>(name, value);
+
+            else if (name == "--repulsion")
+                options.engine.repulsion = parse_value<float>(name, value);
+
+            else if (name == "--summary")
+                options.summary_period = parse_value<std::uint64_t>(name, value);
+
+            else if (name == "--trace")
+                options.trace_path = value;
+
+            else if (name == "--image")
+                options.image_path = value;
+
+            else if (name == "--load-snapshot")
+                options.load_snapshot_path = value;
+
+            else if (name == "--save-snapshot")
+                options.save_snapshot_path = value;
+
+            else if (name == "--record")
+                options.record_path = value;
+
+            else if (name == "--record-policy") {
+                if (value == "drop")
+                    options.recorder.policy = app::record_policy::drop;
+
+                else if (value == "block")
+                    options.recorder.policy = app::record_policy::block;
+
+                else throw std::invalid_argument(fmt::format("invalid value '{}' for '{}'"s, value, name));
+            }
+
+            else if (name == "--clicks")
+                options.clicks_per_second = parse_value<std::uint32_t>(name, value);
+
+            else if (name == "--input")
+                options.input_path = value;
+
+            else if (name == "--save-input")
+                options.save_input_path = value;
+
+            else if (name == "--record-slots")
+                options.recorder.slots_count = std::max(parse_value<std::uint32_t>(name, value), 1u);
+
+            else if (name == "--cpus")
+                options.engine.cpus = utility::parse_cpu_list(value);
+
+            else if (name == "--numa")
+                options.engine.numa_aware = parse_value<std::uint32_t>(name, value) != 0;
+
+            else if (name == "--numa-nodes")
+                options.engine.numa_nodes = parse_value<std::uint32_t>(name, value);
+
+            else if (name == "--storage") {
+                if (value == "full")
+                    options.engine.storage = simulation::storage_layout::full;
+
+                else if (value == "compact")
+                    options.engine.storage = simulation::storage_layout::compact;
+
+                else throw std::invalid_argument(fmt::format("invalid value '{}' for '{}'"s, value, name));
+            }
+
+            else if (name == "--effects") {
+                options.effect_types.clear();
+
+                for (std::size_t begin = 0, end = 0; begin <= value.size(); begin = end + 1) {
+                    end = std::min(value.find(',', begin), value.size());
+
+                    auto &&names = app::effect_types::names;
+                    auto const type = std::find(std::cbegin(names), std::cend(names), value.substr(begin, end - begin));
+
+                    if (type == std::cend(names))
+                        throw std::invalid_argument(fmt::format("unknown effect type '{}' for '{}'"s, value.substr(begin, end - begin), name));
+
+                    options.effect_types.push_back(static_cast<std::uint32_t>(std::distance(std::cbegin(names), type)));
+                }
+            }
+
+            else if (name == "--workers") {
+                options.workers.clear();
+
+                for (std::size_t begin = 0, end = 0; begin <= value.size(); begin = end + 1) {
+                    end = std::min(value.find(',', begin), value.size());
+                    options.workers.push_back(std::max(parse_value<std::uint32_t>(name, value.substr(begin, end - begin)), 1u));
+                }
+            }
+
+            else throw std::invalid_argument(fmt::format("unknown option '{}'"s, name));
+        }
+
+        if (options.dt.count() <= 0)
+            throw std::invalid_argument("'--dt' must be positive"s);
+
+        if (options.clicks_per_second != 0 && !options.input_path.empty())
+            throw std::invalid_argument("'--clicks' and '--input' are two sources of clicks, pick one"s);
+
+        if (options.engine.storage == simulation::storage_layout::compact && (options.engine.grid_cell_size > 0.f || options.engine.interaction_radius > 0.f ||
+                                                                              !options.load_snapshot_path.empty() || !options.save_snapshot_path.empty()))
+            throw std::invalid_argument("'--storage=compact' goes with neither a grid nor snapshots"s);
+
+        return options;
+    }
+
+    // A pure function of the seed, so every run gets the same effects.
+    class spawn_script final {
+    public:
+
+        spawn_script(std::uint32_t seed, std::vector<std::uint32_t> const &types) : state{seed != 0 ? seed : 1u}, types{types} { }
+
+        void operator() (app::particle_engine &engine)
+        {
+            auto x = next() * static_cast<float>(app::SCREEN_WIDTH);
+            auto y = (next() * .5f + .5f) * static_cast<float>(app::SCREEN_HEIGHT);
+
+            engine.spawn_effect(glm::vec2{x, y}, glm::vec4{next(), next(), next(), 1.f}, types[spawned++ % types.size()]);
+        }
+
+    private:
+
+        std::uint32_t state;
+
+        std::vector<std::uint32_t> types;
+        std::size_t spawned{0};
+
+        // xorshift32
+        float next() noexcept
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+
+            return static_cast<float>(state >> 8) * 0x1p-24f;
+        }
+    };
+
+    // A left click at 'time' ns from the start of the input, engine coordinates.
+    struct click final {
+        std::int64_t time{0};
+        float x{0.f}, y{0.f};
+    };
+
+    // Clicks at places drawn from the seed, forever.
+    class click_script final {
+    public:
+
+        click_script(std::uint32_t seed, std::uint32_t clicks_per_second) : state{(seed ^ 0xC11C'C11C) | 1u}, period{1e9 / clicks_per_second} { }
+
+        bool operator() (click &click)
+        {
+            click.time = static_cast<std::int64_t>(static_cast<double>(clicked++) * period);
+            click.x = next() * static_cast<float>(app::SCREEN_WIDTH);
+            click.y = next() * static_cast<float>(app::SCREEN_HEIGHT);
+
+            return true;
+        }
+
+    private:
+
+        std::uint32_t state;
+
+        double period; // ns
+        std::uint64_t clicked{0};
+
+        // xorshift32
+        float next() noexcept
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+
+            return static_cast<float>(state >> 8) * 0x1p-24f;
+        }
+    };
+
+    // A click per line: ms from the start, x and y, e.g. '12.5 320 240'.
+    std::vector<click> load_clicks(std::string const &path)
+    {
+        std::ifstream file{path};
+
+        if (!file)
+            throw std::runtime_error(fmt::format("failed to open '{}'"s, path));
+
+        std::vector<click> clicks;
+
+        for (double time; file >> time;) {
+            click click;
+            click.time = static_cast<std::int64_t>(time * 1e6);
+
+            if (!(file >> click.x >> click.y))
+                break;
+
+            clicks.push_back(click);
+        }
+
+        if (!file.eof())
+            throw std::runtime_error(fmt::format("malformed click {} in '{}'"s, clicks.size() + 1, path));
+
+        return clicks;
+    }
+
+    void save_clicks(std::string const &path, std::vector<click> const &clicks)
+    {
+        std::ofstream file{path, std::ios::trunc};
+
+        for (auto &&click : clicks)
+            file << fmt::format("{} {} {}\n"s, static_cast<double>(click.time) * 1e-6, click.x, click.y);
+
+        if (!file)
+            throw std::runtime_error(fmt::format("failed to write '{}'"s, path));
+    }
+
+    // Plays clicks into an input ring from a thread, in window coordinates.
+    class input_source final {
+    public:
+
+        input_source(platform::input_ring &ring, std::function<bool(click &)> next_click) : thread{[this, &ring, next_click = std::move(next_click)]
+        {
+            auto const start = std::chrono::steady_clock::now();
+
+            for (click click; !stop_it.load(std::memory_order_relaxed) && next_click(click);) {
+                std::this_thread::sleep_until(start + std::chrono::nanoseconds{click.time});
+
+                auto const time = platform::input_ring::now();
+
+                ring.push(platform::input_event{time, click.x, static_cast<float>(app::SCREEN_HEIGHT) - click.y, 0, platform::input_kind::move});
+                ring.push(platform::input_event{time, 0.f, 0.f, 0x01, platform::input_kind::button_down});
+                ring.push(platform::input_event{time, 0.f, 0.f, 0x01, platform::input_kind::button_up});
+
+                clicks.push_back(click);
+            }
+        }} { }
+
+        ~input_source() { stop(); }
+
+        void stop()
+        {
+            stop_it = true;
+
+            if (thread.joinable())
+                thread.join();
+        }
+
+        // The clicks made so far; once stopped only.
+        std::vector<click> const &made() const noexcept { return clicks; }
+
+    private:
+
+        std::atomic_bool stop_it{false};
+
+        std::vector<click> clicks;
+
+        // Last, so it starts with the rest set up.
+        std::thread thread;
+    };
+
+    void wait_until_settled(app::particle_engine const &engine)
+    {
+        auto constexpr timeout = std::chrono::seconds{10};
+
+        auto const start = std::chrono::steady_clock::now();
+
+        while (!engine.settled()) {
+            if (std::chrono::steady_clock::now() - start > timeout)
+                throw std::runtime_error(fmt::format("steps did not catch up in {}s, {} published"s, timeout.count(), engine.steps()));
+
+            std::this_thread::yield();
+        }
+    }
+
+    // FNV-1a over the rendered attributes of the published frame.
+    std::uint64_t hash_state(app::particle_engine &engine)
+    {
+        std::uint64_t hash = 0xCBF29CE484222325;
+
+        engine.render([&hash] (auto... attributes)
+        {
+            for (float attribute : {attributes...}) {
+                std::uint32_t bits;
+                std::memcpy(&bits, &attribute, sizeof(bits));
+
+                hash = (hash ^ bits) * 0x100000001B3;
+            }
+        });
+
+        return hash;
+    }
+
+    // Compares the vertex stream to 'render'; only the colors with fixed steps.
+    std::pair<std::uint64_t, bool> check_vertices(app::particle_engine &engine, bool compare_positions)
+    {
+        std::vector<simulation::point_vertex> expected;
+
+        engine.render([&expected] (float x, float y, float r, float g, float b, float a)
+        {
+            expected.push_back(simulation::point_vertex{x, y, simulation::pack_color(glm::vec4{r, g, b, a})});
+        });
+
+        std::uint64_t hash = 0xCBF29CE484222325;
+        auto match = true;
+
+        engine.render_vertices([&] (simulation::point_vertex const *vertices, std::uint32_t count)
+        {
+            auto const bytes = reinterpret_cast<unsigned char const *>(vertices);
+
+            for (std::size_t i = 0; i < count * sizeof(simulation::point_vertex); ++i)
+                hash = (hash ^ bytes[i]) * 0x100000001B3;
+
+            match = count == expected.size();
+
+            for (auto i = 0u; i < count && match; ++i) {
+                match = vertices[i].color == expected[i].color;
+
+                if (compare_positions)
+                    match = match && vertices[i].x == expected[i].x && vertices[i].y == expected[i].y;
+            }
+        });
+
+        return {hash, match};
+    }
+
+    // Returns the FNV-1a of the pixels.
+    std::uint64_t write_image(app::particle_engine &engine, std::string const &path)
+    {
+        gfx::software_rasterizer rasterizer{app::SCREEN_WIDTH, app::SCREEN_HEIGHT};
+
+        engine.render_vertices([&] (simulation::point_vertex const *vertices, std::uint32_t count)
+        {
+            rasterizer.draw(engine.job_system(), vertices, count, static_cast<float>(app::SCREEN_WIDTH), static_cast<float>(app::SCREEN_HEIGHT));
+        });
+
+        rasterizer.write_ppm(path);
+
+        std::uint64_t hash = 0xCBF29CE484222325;
+
+        for (auto i = std::size_t{0}; i < std::size_t{rasterizer.width()} * rasterizer.height(); ++i)
+            hash = (hash ^ rasterizer.pixels()[i]) * 0x100000001B3;
+
+        return hash;
+    }
+
+    // Compares the last recorded frame to the engine's final vertices.
+    std::pair<std::uint64_t, bool> check_recording(app::particle_engine &engine, std::string const &path)
+    {
+        app::recording_reader reader{path};
+        app::recorded_frame frame;
+
+        std::uint64_t frames_count = 0;
+
+        while (reader.next(frame))
+            ++frames_count;
+
+        if (frames_count == 0 || frame.step != engine.steps())
+            return {frames_count, frames_count == 0};
+
+        auto const scale = static_cast<float>(reader.position_scale());
+        auto match = true;
+
+        engine.render_vertices([&] (simulation::point_vertex const *vertices, std::uint32_t count)
+        {
+            match = count == frame.x.size();
+
+            for (auto i = 0u; i < count && match; ++i) {
+                match = frame.x[i] == static_cast<float>(std::lrint(vertices[i].x * scale)) / scale
+                     && frame.y[i] == static_cast<float>(std::lrint(vertices[i].y * scale)) / scale
+                     && frame.color[i] == app::dequantize_color(app::quantize_color(vertices[i].color));
+            }
+        });
+
+        return {frames_count, match};
+    }
+
+    std::int64_t percentile(std::vector<std::int64_t> const &sorted, double fraction)
+    {
+        if (sorted.empty())
+            return 0;
+
+        auto index = static_cast<std::size_t>(fraction * static_cast<double>(sorted.size() - 1) + .5);
+
+        return sorted.at(index);
+    }
+
+    std::uint32_t count_duplicate_ids(app::particle_engine &engine)
+    {
+        std::vector<std::uint32_t> ids;
+
+        engine.for_each_particle([&ids] (std::uint32_t id, float, float) { ids.push_back(id); });
+
+        std::sort(std::begin(ids), std::end(ids));
+
+        auto duplicates = 0u;
+
+        for (std::size_t i = 1; i < ids.size(); ++i)
+            duplicates += ids[i] == ids[i - 1] ? 1u : 0u;
+
+        return duplicates;
+    }
+
+    // How many requested effect particles match by id and their mean and max drift, px.
+    std::tuple<std::size_t, double, double> drift(std::vector<std::tuple<std::uint32_t, float, float>> const &particles,
+                                                  std::vector<std::tuple<std::uint32_t, float, float>> const &reference)
+    {
+        std::size_t matched_count = 0;
+
+        auto sum = 0., max = 0.;
+
+        for (auto it = std::cbegin(particles), reference_it = std::cbegin(reference); it != std::cend(particles) && reference_it != std::cend(reference);) {
+            auto &&[id, x, y] = *it;
+            auto &&[reference_id, reference_x, reference_y] = *reference_it;
+
+            // Sorted last.
+            if ((id & app::particle_engine::DESCENDANT_ID_BIT) != 0 || (reference_id & app::particle_engine::DESCENDANT_ID_BIT) != 0)
+                break;
+
+            if (id != reference_id) {
+                id < reference_id ? ++it : ++reference_it;
+                continue;
+            }
+
+            auto const distance = std::hypot(static_cast<double>(x) - static_cast<double>(reference_x), static_cast<double>(y) - static_cast<double>(reference_y));
+
+            sum += distance;
+            max = std::max(max, distance);
+
+            ++matched_count;
+            ++it;
+            ++reference_it;
+        }
+
+        return {matched_count, matched_count != 0 ? sum / static_cast<double>(matched_count) : 0., max};
+    }
+
+    run_result run(options const &options, std::uint32_t workers_count, bool first_run, bool keep_particles = false)
+    {
+        auto config = options.engine;
+        config.workers_count = workers_count;
+
+        // Declared first: the engine may be publishing into it until it is gone.
+        std::unique_ptr<app::frame_recorder> recorder;
+
+        if (first_run && !options.record_path.empty())
+            recorder = std::make_unique<app::frame_recorder>(options.record_path, config.capacity, options.recorder);
+
+        app::particle_engine engine{config};
+
+        engine.record(recorder.get());
+
+        spawn_script spawn{options.seed, options.effect_types};
+
+        run_result result;
+
+        auto const input = options.clicks_per_second != 0 || !options.input_path.empty();
+
+        platform::input_ring input_ring;
+        app::input_dispatcher input_dispatcher{input_ring, options.seed, static_cast<float>(app::SCREEN_HEIGHT)};
+
+        std::unique_ptr<input_source> clicks;
+
+        if (!options.load_snapshot_path.empty()) {
+            auto const load_start = std::chrono::steady_clock::now();
+
+            engine.load_snapshot(options.load_snapshot_path);
+
+            result.snapshot_load_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - load_start).count();
+        }
+
+        result.workers_count = engine.workers_count();
+        result.nodes_count = engine.nodes_count();
+        result.latencies.reserve(options.steps);
+
+        auto const total_steps = options.warmup_steps + options.steps;
+
+        auto start = std::chrono::steady_clock::now();
+        auto start_steps = engine.steps();
+
+        auto summary_start = start;
+
+        if (!options.input_path.empty()) {
+            clicks = std::make_unique<input_source>(input_ring, [recorded = load_clicks(options.input_path), next = std::size_t{0}] (click &click) mutable
+            {
+                if (next == recorded.size())
+                    return false;
+
+                click = recorded[next++];
+
+                return true;
+            });
+        }
+
+        else if (options.clicks_per_second != 0)
+            clicks = std::make_unique<input_source>(input_ring, click_script{options.seed, options.clicks_per_second});
+
+        for (std::uint64_t step = 0; step < total_steps; ++step) {
+            if (step == options.warmup_steps) {
+                start = std::chrono::steady_clock::now();
+                start_steps = engine.steps();
+            }
+
+            if (input)
+                input_dispatcher.dispatch(engine, options.effect_types[step % options.effect_types.size()]);
+
+            if (step % options.spawn_period == 0) {
+                for (auto i = 0u; i < options.spawns_per_period; ++i)
+                    spawn(engine);
+            }
+
+            auto const steps_before = engine.steps();
+
+            auto const step_start = std::chrono::steady_clock::now();
+
+            engine.update(options.dt);
+            wait_until_settled(engine);
+
+            auto const step_end = std::chrono::steady_clock::now();
+
+            if (options.summary_period != 0 && (step + 1) % options.summary_period == 0) {
+                auto const now = std::chrono::steady_clock::now();
+
+                std::cout << fmt::format("\nupdates {}-{}:\n{}"s, step + 1 - options.summary_period, step + 1,
+                                         utility::profiling::format_summary(utility::profiling::take_summary(), now - std::exchange(summary_start, now)));
+            }
+
+            if (step < options.warmup_steps)
+                continue;
+
+            result.latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(step_end - step_start).count());
+            result.particles_processed += std::uint64_t{engine.particles_count()} * (engine.steps() - steps_before);
+        }
+
+        result.elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (clicks != nullptr) {
+            clicks->stop();
+
+            result.clicks_count = clicks->made().size();
+            result.ring_dropped = input_ring.dropped();
+            result.dispatch = input_dispatcher.stats();
+            result.input_latency = engine.spawn_latency_stats();
+
+            if (first_run && !options.save_input_path.empty())
+                save_clicks(options.save_input_path, clicks->made());
+        }
+
+        result.steps_count = engine.steps() - start_steps;
+        result.dropped_time = engine.dropped_time();
+        result.final_particles_count = engine.particles_count();
+        result.final_state_hash = hash_state(engine);
+        result.duplicate_ids = count_duplicate_ids(engine);
+
+        std::tie(result.vertices_hash, result.vertices_match) = check_vertices(engine, config.fixed_step.count() == 0);
+
+        if (!options.image_path.empty())
+            result.image_hash = write_image(engine, options.image_path);
+
+        if (recorder != nullptr) {
+            engine.record(nullptr);
+            recorder->flush();
+
+            result.recording = recorder->stats();
+
+            std::tie(result.decoded_frames_count, result.recording_matches) = check_recording(engine, options.record_path);
+        }
+
+        if (first_run && !options.save_snapshot_path.empty()) {
+            auto const save_start = std::chrono::steady_clock::now();
+
+            engine.save_snapshot(options.save_snapshot_path);
+
+            result.snapshot_save_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - save_start).count();
+        }
+
+        result.memory = engine.memory_stats();
+        result.spawn = engine.spawn_stats();
+        result.budget = engine.budget_stats();
+
+        if (keep_particles) {
+            engine.for_each_particle([&result] (std::uint32_t id, float x, float y) { result.final_particles.emplace_back(id, x, y); });
+
+            std::sort(std::begin(result.final_particles), std::end(result.final_particles));
+        }
+
+        std::sort(std::begin(result.latencies), std::end(result.latencies));
+
+        return result;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    options options;
+
+    try {
+        options = parse_options(argc, argv);
+    }
+
+    catch (std::invalid_argument const &error) {
+        std::cerr << fmt::format("{}\nusage: headless [--steps=N] [--warmup=N] [--dt=ms] [--fixed-step=ms] [--max-steps=N] [--budget=ms] [--spawn-period=N] [--spawns=N] [--seed=N] [--capacity=N] [--pages=regular|transparent|explicit] [--grow=0|1] [--grid-cell=px] [--interaction-radius=px] [--repulsion=px/s2] [--image=path.ppm] [--load-snapshot=path] [--save-snapshot=path] [--record=path] [--record-policy=drop|block] [--record-slots=N] [--clicks=N] [--input=path] [--save-input=path] [--summary=N] [--trace=path.json] [--effects=type[,type...]] [--storage=full|compact] [--cpus=list] [--numa=0|1] [--numa-nodes=N] [--workers=N[,N...]]\n"s, error.what());
+        return 1;
+    }
+
+    std::cout << fmt::format("particle-engine {}.{} headless\n"s, PROJECT_VERSION_MAJOR, PROJECT_VERSION_MINOR);
+    std::cout << fmt::format("updates: {} (+{} warmup), dt: {} ms, spawns: {} every {} updates, seed: {}\n"s,
+                             options.steps, options.warmup_steps, std::chrono::duration<double, std::milli>{options.dt}.count(),
+                             options.spawns_per_period, options.spawn_period, options.seed);
+
+    if (options.engine.fixed_step.count() != 0)
+        std::cout << fmt::format("fixed step: {} ms, at most {} steps per update\n"s,
+                                 std::chrono::duration<double, std::milli>{options.engine.fixed_step}.count(), options.engine.max_steps_per_update);
+
+    if (options.engine.step_budget.count() != 0)
+        std::cout << fmt::format("step budget: {} ms, degraded steps depend on the timing\n"s, std::chrono::duration<double, std::milli>{options.engine.step_budget}.count());
+
+    std::cout << fmt::format("capacity: {} particles, grow on demand: {}\n"s, options.engine.capacity, options.engine.grow_on_demand ? "yes"s : "no"s);
+    std::cout << fmt::format("integration kernel: {}\n"s, simulation::integration_isa());
+
+    if (!PARTICLE_ENGINE_PROFILING && (options.summary_period != 0 || !options.trace_path.empty()))
+        std::cout << "profiling: not compiled in, '--summary' and '--trace' are ignored\n"s;
+
+    if (options.effect_types.size() > 1 || options.effect_types.front() != 0) {
+        std::string names;
+
+        for (auto type : options.effect_types)
+            names += (names.empty() ? ""s : ", "s) + app::effect_types::names[type];
+
+        std::cout << fmt::format("effects: {}\n"s, names);
+    }
+
+    if (options.clicks_per_second != 0)
+        std::cout << fmt::format("input: {} clicks/sec through the input ring, spawns depend on the timing\n"s, options.clicks_per_second);
+
+    if (!options.input_path.empty())
+        std::cout << fmt::format("input: clicks replayed from '{}' through the input ring, spawns depend on the timing\n"s, options.input_path);
+
+    if (options.engine.interaction_radius > 0.f)
+        std::cout << fmt::format("interaction radius: {} px, repulsion: {} px/s2\n"s, options.engine.interaction_radius, options.engine.repulsion);
+
+    auto const compact = options.engine.storage == simulation::storage_layout::compact;
+
+    if (compact)
+        std::cout << fmt::format("storage: compact, {} bytes per particle, the vertices decoded as the frames are drawn\n"s,
+                                 simulation::particle_storage::COMPACT_PARTICLE_SIZE);
+
+    auto failed_runs = 0u;
+
+    // Of the first run, with '--storage=compact'.
+    std::vector<std::tuple<std::uint32_t, float, float>> compact_particles;
+
+    for (std::size_t run_index = 0; run_index < options.workers.size(); ++run_index) {
+        auto const workers_count = options.workers[run_index];
+        auto const first_run = run_index == 0;
+
+        auto result = run(options, workers_count, first_run, compact && first_run);
+
+        if (compact && first_run)
+            compact_particles = std::move(result.final_particles);
+
+        failed_runs += result.vertices_match && result.recording_matches && result.duplicate_ids == 0 ? 0u : 1u;
+        auto const &latencies = result.latencies;
+
+        if (options.engine.numa_aware)
+            std::cout << fmt::format("\nworkers: {}, NUMA nodes: {}\n"s, result.workers_count, result.nodes_count);
+
+        else std::cout << fmt::format("\nworkers: {}\n"s, result.workers_count);
+
+        if (!options.load_snapshot_path.empty())
+            std::cout << fmt::format("snapshot '{}' loaded in {:.3f} ms\n"s, options.load_snapshot_path, result.snapshot_load_time * 1e3);
+
+        std::cout << fmt::format("final particles: {}, state hash: {:016x}, duplicate ids: {}\n"s, result.final_particles_count, result.final_state_hash, result.duplicate_ids);
+        std::cout << fmt::format("vertex stream hash: {:016x}, matches particles: {}\n"s, result.vertices_hash, result.vertices_match ? "yes"s : "no"s);
+        if (!options.image_path.empty())
+            std::cout << fmt::format("image hash: {:016x}, written to '{}'\n"s, result.image_hash, options.image_path);
+
+        if (auto &&recording = result.recording; recording.frames_submitted != 0) {
+            auto const recorded_count = std::max(recording.frames_recorded, std::uint64_t{1});
+
+            auto const writer_time = static_cast<double>(std::max(recording.writer_time, std::int64_t{1})) * 1e-9;
+
+            std::cout << fmt::format("recording: {} frames of {} ({} dropped, policy: {}), {:.1f} MiB written, {:.1f}x smaller than raw\n"s,
+                                     recording.frames_recorded, recording.frames_submitted, recording.frames_dropped, app::to_string(options.recorder.policy),
+                                     static_cast<double>(recording.written_bytes) / 0x1p20,
+                                     static_cast<double>(recording.raw_bytes) / static_cast<double>(std::max(recording.written_bytes, std::uint64_t{1})));
+            std::cout << fmt::format("recorder: writer {:.2f} ms/frame, {:.1f} MB/s raw in, {:.1f} MB/s out; submit {:.1f} us/frame (max {:.1f} us) on the publishing worker\n"s,
+                                     static_cast<double>(recording.writer_time) / static_cast<double>(recorded_count) * 1e-6,
+                                     static_cast<double>(recording.raw_bytes) / writer_time * 1e-6, static_cast<double>(recording.written_bytes) / writer_time * 1e-6,
+                                     static_cast<double>(recording.submit_time) / static_cast<double>(recorded_count) * 1e-3,
+                                     static_cast<double>(recording.max_submit_time) * 1e-3);
+            std::cout << fmt::format("recording decoded: {} frames, final frame matches: {}\n"s,
+                                     result.decoded_frames_count, result.recording_matches ? "yes"s : "no"s);
+        }
+
+        if (result.clicks_count != 0) {
+            auto &&latency = result.input_latency;
+
+            std::cout << fmt::format("input: {} clicks, {} events dropped by the ring; {} events drained, {} at most at once; {} effects spawned, {} dropped\n"s,
+                                     result.clicks_count, result.ring_dropped, result.dispatch.events, result.dispatch.max_batch,
+                                     result.dispatch.spawned, result.dispatch.dropped);
+            std::cout << fmt::format("click to first visible particle us: p50 {:.1f}, p90 {:.1f}, p99 {:.1f}, max {:.1f}, mean {:.1f} over {} effects\n"s,
+                                     static_cast<double>(latency.p50) * 1e-3, static_cast<double>(latency.p90) * 1e-3,
+                                     static_cast<double>(latency.p99) * 1e-3, static_cast<double>(latency.max) * 1e-3,
+                                     static_cast<double>(latency.mean) * 1e-3, latency.count);
+        }
+
+        if (result.spawn.evicted + result.spawn.overflow_effects != 0)
+            std::cout << fmt::format("at capacity: {} particles evicted, {} effects left out\n"s, result.spawn.evicted, result.spawn.overflow_effects);
+
+        if (result.spawn.cascades + result.spawn.dropped_cascades != 0)
+            std::cout << fmt::format("cascades: {} spawned, {} dropped\n"s, result.spawn.cascades, result.spawn.dropped_cascades);
+
+        if (auto &&budget = result.budget; options.engine.step_budget.count() != 0) {
+            std::string level_steps;
+
+            for (auto steps : budget.level_steps)
+                level_steps += (level_steps.empty() ? ""s : "/"s) + std::to_string(steps);
+
+            std::cout << fmt::format("degradation: level {} at the end, {} at most; steps per level {}, {} over budget, last step {:.3f} ms\n"s,
+                                     budget.level, budget.max_level, level_steps, budget.over_budget_steps, static_cast<double>(budget.last_cost) * 1e-6);
+        }
+
+        if (result.snapshot_save_time != 0)
+            std::cout << fmt::format("snapshot written to '{}' in {:.3f} ms\n"s, options.save_snapshot_path, result.snapshot_save_time * 1e3);
+
+        std::cout << fmt::format("frames memory: {:.1f} MiB committed of {:.1f} MiB reserved, {}\n"s,
+                                 static_cast<double>(result.memory.committed_bytes) / 0x1p20, static_cast<double>(result.memory.reserved_bytes) / 0x1p20,
+                                 utility::to_string(result.memory.page_policy));
+        std::cout << fmt::format("steps/sec: {:.1f}, updates/sec: {:.1f}, dropped time: {:.3f} ms\n"s,
+                                 static_cast<double>(result.steps_count) / result.elapsed, static_cast<double>(options.steps) / result.elapsed,
+                                 std::chrono::duration<double, std::milli>{result.dropped_time}.count());
+        std::cout << fmt::format("particles/sec: {:.0f}\n"s, static_cast<double>(result.particles_processed) / result.elapsed);
+        std::cout << fmt::format("update latency us: p50 {:.1f}, p90 {:.1f}, p99 {:.1f}, max {:.1f}\n"s,
+                                 static_cast<double>(percentile(latencies, .50)) * 1e-3,
+                                 static_cast<double>(percentile(latencies, .90)) * 1e-3,
+                                 static_cast<double>(percentile(latencies, .99)) * 1e-3,
+                                 static_cast<double>(latencies.empty() ? 0 : latencies.back()) * 1e-3);
+    }
+
+    // The same run in full precision, for the quantization drift.
+    if (compact) {
+        auto reference_options = options;
+        reference_options.engine.storage = simulation::storage_layout::full;
+        reference_options.image_path.clear();
+
+        auto const reference = run(reference_options, options.workers.front(), false, true);
+        auto const [matched_count, mean_error, max_error] = drift(compact_particles, reference.final_particles);
+
+        std::cout << fmt::format("\ndrift from full precision: {} particles, {} in full precision, {} of them in both; position error px: mean {:.4f}, max {:.4f}\n"s,
+                                 compact_particles.size(), reference.final_particles.size(), matched_count, mean_error, max_error);
+    }
+
+    if (PARTICLE_ENGINE_PROFILING && !options.trace_path.empty()) {
+        utility::profiling::write_chrome_trace(options.trace_path);
+
+        std::cout << fmt::format("\ntrace written to '{}'\n"s, options.trace_path);
+    }
+
+    return failed_runs == 0 ? 0 : 1;
+}
\ No newline at end of file
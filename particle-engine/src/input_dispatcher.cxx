@@ -0,0 +1,51 @@
+#include <algorithm>
+#include <chrono>
+
+#include "input_dispatcher.hxx"
+#include "utility/profiler.hxx"
+
+
+namespace app
+{
+    std::size_t input_dispatcher::dispatch(app::particle_engine &engine, std::uint32_t type)
+    {
+        PROFILE_SCOPE(input_dispatch);
+
+        auto const count = ring.drain([this, &engine, type] (platform::input_event const &event)
+        {
+            switch (event.kind) {
+                case platform::input_kind::move:
+                    cursor_x = event.x;
+                    cursor_y = window_height != 0.f ? window_height - event.y : event.y;
+                    break;
+
+                case platform::input_kind::button_up:
+                    if (event.buttons == LEFT_BUTTON) {
+                        auto const request_time = std::chrono::steady_clock::time_point{std::chrono::nanoseconds{event.time}};
+
+                        auto const spawned = engine.spawn_effect(glm::vec2{cursor_x, cursor_y}, glm::vec4{next(), next(), next(), 1.f}, type, request_time);
+
+                        ++(spawned ? stats_.spawned : stats_.dropped);
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+        });
+
+        stats_.events += count;
+        stats_.max_batch = std::max(stats_.max_batch, std::uint64_t{count});
+
+        return count;
+    }
+
+    float input_dispatcher::next() noexcept
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+
+        return static_cast<float>(state >> 8) * 0x1p-24f;
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "particle_engine.hxx"
+#include "platform/input/input_ring.hxx"
+
+
+namespace app
+{
+    struct dispatch_statistics final {
+        std::uint64_t events{0};
+        std::uint64_t spawned{0};
+        std::uint64_t dropped{0};
+
+        std::uint64_t max_batch{0};
+    };
+
+    // Spawns an effect per left button release, once per drain.
+    class input_dispatcher final {
+    public:
+
+        // Non-zero: window coordinates, y flipped within this height.
+        explicit input_dispatcher(platform::input_ring &ring, std::uint32_t seed = 1, float window_height = 0.f)
+            : ring{ring}, state{seed != 0 ? seed : 1u}, window_height{window_height} { }
+
+        // The ring consumer; returns the events drained.
+        std::size_t dispatch(app::particle_engine &engine, std::uint32_t type = 0);
+
+        dispatch_statistics const &stats() const noexcept { return stats_; }
+
+    private:
+
+        static std::uint32_t constexpr LEFT_BUTTON{0x01};
+
+        platform::input_ring &ring;
+
+        std::uint32_t state;
+
+        float window_height;
+
+        float cursor_x{0.f}, cursor_y{0.f};
+
+        dispatch_statistics stats_;
+
+        // xorshift32
+        float next() noexcept;
+    };
+}
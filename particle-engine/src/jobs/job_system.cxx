@@ -0,0 +1,211 @@
+#include <algorithm>
+
+#include "utility/profiler.hxx"
+#include "utility/spin_wait.hxx"
+#include "utility/topology.hxx"
+#include "job_system.hxx"
+
+
+namespace
+{
+    struct current_worker final {
+        jobs::job_system const *system{nullptr};
+        std::uint32_t index{jobs::job_system::NOT_A_WORKER};
+    };
+
+    thread_local current_worker this_worker;
+}
+
+namespace jobs
+{
+    job_system::job_system(std::uint32_t workers_count, std::vector<std::vector<std::uint32_t>> const &worker_cpus)
+    {
+        workers_count = std::max(workers_count, 1u);
+
+        workers.reserve(workers_count);
+
+        for (auto worker_index = 0u; worker_index < workers_count; ++worker_index) {
+            workers.push_back(std::make_unique<worker>());
+
+            if (worker_index < worker_cpus.size())
+                workers.back()->cpus = worker_cpus[worker_index];
+        }
+
+        for (auto worker_index = 0u; worker_index < workers_count; ++worker_index)
+            workers.at(worker_index)->thread = std::thread(&job_system::worker_loop, this, worker_index);
+    }
+
+    job_system::~job_system()
+    {
+        stop = true;
+
+        wake_sleepers(true);
+
+        for (auto &&worker : workers)
+            worker->thread.join();
+    }
+
+    void job_system::submit(jobs::task &task, std::uint32_t size, std::uint32_t grain)
+    {
+        task.remaining.store(size, std::memory_order_relaxed);
+        task.grain = std::max(grain, 1u);
+
+        push(jobs::job{&task, 0, size});
+    }
+
+    void job_system::submit_to_each_worker(jobs::task &task)
+    {
+        task.remaining.store(workers_count(), std::memory_order_relaxed);
+        task.grain = 1;
+
+        for (auto &&worker : workers)
+            worker->own_task.store(&task, std::memory_order_release);
+
+        // Every worker has to pick its item up itself.
+        wake_sleepers(true);
+    }
+
+    std::uint32_t job_system::current_worker_index() const noexcept
+    {
+        return this_worker.system == this ? this_worker.index : NOT_A_WORKER;
+    }
+
+    void job_system::worker_loop(std::uint32_t worker_index)
+    {
+        this_worker = current_worker{this, worker_index};
+
+        PROFILE_THREAD_NAME("worker " + std::to_string(worker_index));
+
+        // Pinned first, so what it touches is allocated on its node.
+        utility::pin_current_thread(workers[worker_index]->cpus);
+
+        jobs::job job;
+
+        while (!stop.load(std::memory_order_relaxed)) {
+            if (find_job(worker_index, job)) {
+                execute(job, worker_index);
+                continue;
+            }
+
+            // Step stages follow within microseconds: spin before parking.
+            auto found = false;
+
+            for (auto spin = 0u; spin < IDLE_SPINS_COUNT && !found; ++spin) {
+                utility::cpu_relax();
+                found = has_work(worker_index) || stop.load(std::memory_order_relaxed);
+            }
+
+            if (found)
+                continue;
+
+            auto const epoch = wake_epoch.load(std::memory_order_acquire);
+
+            sleepers_count.fetch_add(1, std::memory_order_seq_cst);
+
+            // Pairs with the fence in 'wake_sleepers'.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (!has_work(worker_index) && !stop.load(std::memory_order_relaxed))
+                wake_epoch.wait(epoch, std::memory_order_acquire);
+
+            sleepers_count.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    bool job_system::find_job(std::uint32_t worker_index, jobs::job &job)
+    {
+        if (auto &&own_task = workers[worker_index]->own_task; own_task.load(std::memory_order_relaxed) != nullptr) {
+            job = jobs::job{own_task.exchange(nullptr, std::memory_order_acquire), worker_index, worker_index + 1};
+            return true;
+        }
+
+        if (workers[worker_index]->deque.pop(job))
+            return true;
+
+        auto const workers_count = static_cast<std::uint32_t>(workers.size());
+
+        for (auto i = 1u; i < workers_count; ++i) {
+            if (workers[(worker_index + i) % workers_count]->deque.steal(job))
+                return true;
+        }
+
+        if (injected_jobs_count.load(std::memory_order_acquire) != 0) {
+            std::lock_guard<std::mutex> lock{injected_jobs_mutex};
+
+            if (!injected_jobs.empty()) {
+                job = injected_jobs.front();
+                injected_jobs.pop_front();
+
+                injected_jobs_count.fetch_sub(1, std::memory_order_relaxed);
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool job_system::has_work(std::uint32_t worker_index) const noexcept
+    {
+        if (injected_jobs_count.load(std::memory_order_acquire) != 0 || workers[worker_index]->own_task.load(std::memory_order_acquire) != nullptr)
+            return true;
+
+        return std::any_of(std::cbegin(workers), std::cend(workers), [] (auto &&worker) { return !worker->deque.empty(); });
+    }
+
+    void job_system::execute(jobs::job job, std::uint32_t worker_index)
+    {
+        auto &&task = *job.task;
+        auto &&deque = workers[worker_index]->deque;
+
+        auto split = false;
+
+        while (job.end - job.begin > task.grain) {
+            auto const middle = job.begin + (job.end - job.begin) / 2;
+
+            if (!deque.push(jobs::job{&task, middle, job.end}))
+                break;
+
+            job.end = middle;
+            split = true;
+        }
+
+        if (split)
+            wake_sleepers(false);
+
+        task.execute(job.begin, job.end, worker_index);
+
+        auto const count = job.end - job.begin;
+
+        // 'task' may be resubmitted from here on.
+        if (task.remaining.fetch_sub(count, std::memory_order_acq_rel) == count)
+            task.complete(worker_index);
+    }
+
+    void job_system::push(jobs::job const &job)
+    {
+        if (auto worker_index = current_worker_index(); worker_index == NOT_A_WORKER || !workers[worker_index]->deque.push(job)) {
+            std::lock_guard<std::mutex> lock{injected_jobs_mutex};
+
+            injected_jobs.push_back(job);
+            injected_jobs_count.fetch_add(1, std::memory_order_release);
+        }
+
+        wake_sleepers(false);
+    }
+
+    void job_system::wake_sleepers(bool all)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (!all && sleepers_count.load(std::memory_order_relaxed) == 0)
+            return;
+
+        wake_epoch.fetch_add(1, std::memory_order_release);
+
+        if (all)
+            wake_epoch.notify_all();
+
+        else wake_epoch.notify_one();
+    }
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <deque>
+
+#include "work_stealing_deque.hxx"
+
+
+namespace jobs
+{
+    // Items [0, size); a task graph submits the next task from 'complete'.
+    class task {
+    public:
+
+        virtual ~task() = default;
+
+        // Runs items [begin, end) on pool worker 'worker_index'.
+        virtual void execute(std::uint32_t begin, std::uint32_t end, std::uint32_t worker_index) = 0;
+
+        // Runs once, on the worker that finished the last item.
+        virtual void complete(std::uint32_t) { }
+
+    private:
+
+        friend class job_system;
+
+        std::atomic_uint32_t remaining{0};
+        std::uint32_t grain{1};
+    };
+
+    template<class E, class C>
+    class function_task final : public task {
+    public:
+
+        function_task(E &&execute, C &&complete) : execute_{std::move(execute)}, complete_{std::move(complete)} { }
+
+        void execute(std::uint32_t begin, std::uint32_t end, std::uint32_t worker_index) override
+        {
+            execute_(begin, end, worker_index);
+        }
+
+        void complete(std::uint32_t worker_index) override
+        {
+            complete_(worker_index);
+        }
+
+    private:
+
+        E execute_;
+        C complete_;
+    };
+
+    template<class E, class C>
+    std::unique_ptr<jobs::task> make_task(E &&execute, C &&complete)
+    {
+        return std::make_unique<function_task<std::remove_cvref_t<E>, std::remove_cvref_t<C>>>(std::forward<E>(execute), std::forward<C>(complete));
+    }
+
+    // Work-stealing pool; an unstolen range runs in ascending order.
+    class job_system final {
+    public:
+
+        // Worker 'i' is pinned to 'worker_cpus[i]' if non-empty.
+        explicit job_system(std::uint32_t workers_count, std::vector<std::vector<std::uint32_t>> const &worker_cpus = {});
+
+        ~job_system();
+
+        job_system(job_system const &) = delete;
+        job_system &operator= (job_system const &) = delete;
+
+        // Any thread; 'task' has to outlive its completion.
+        void submit(jobs::task &task, std::uint32_t size, std::uint32_t grain = 1);
+
+        // Item 'i' on worker 'i' alone; nothing is stolen.
+        void submit_to_each_worker(jobs::task &task);
+
+        std::uint32_t workers_count() const noexcept { return static_cast<std::uint32_t>(workers.size()); }
+
+        // Or 'NOT_A_WORKER'.
+        std::uint32_t current_worker_index() const noexcept;
+
+        static std::uint32_t constexpr NOT_A_WORKER{~0u};
+
+    private:
+
+        static std::size_t constexpr DEQUE_CAPACITY{1024};
+
+        static std::uint32_t constexpr IDLE_SPINS_COUNT{4096};
+
+        struct worker final {
+            jobs::work_stealing_deque deque{DEQUE_CAPACITY};
+
+            // For this worker alone.
+            std::atomic<jobs::task *> own_task{nullptr};
+
+            std::vector<std::uint32_t> cpus;
+
+            std::thread thread;
+        };
+
+        std::vector<std::unique_ptr<worker>> workers;
+
+        // Jobs submitted by threads outside of the pool.
+        std::mutex injected_jobs_mutex;
+        std::deque<jobs::job> injected_jobs;
+        std::atomic_uint32_t injected_jobs_count{0};
+
+        std::atomic_bool stop{false};
+
+        alignas(64) std::atomic_uint32_t sleepers_count{0};
+        alignas(64) std::atomic_uint32_t wake_epoch{0};
+
+        void worker_loop(std::uint32_t worker_index);
+
+        bool find_job(std::uint32_t worker_index, jobs::job &job);
+
+        bool has_work(std::uint32_t worker_index) const noexcept;
+
+        void execute(jobs::job job, std::uint32_t worker_index);
+
+        void push(jobs::job const &job);
+
+        void wake_sleepers(bool all);
+    };
+}
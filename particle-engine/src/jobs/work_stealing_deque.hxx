@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+
+
+namespace jobs
+{
+    class task;
+
+    // A range of a task's items.
+    struct job final {
+        jobs::task *task{nullptr};
+
+        std::uint32_t begin{0};
+        std::uint32_t end{0};
+    };
+
+    // Fixed capacity Chase-Lev deque (Le et al., "Correct and efficient work-stealing for weak memory models").
+    class work_stealing_deque final {
+    public:
+
+        // 'capacity' has to be a power of two.
+        explicit work_stealing_deque(std::size_t capacity) : slots{std::make_unique<slot[]>(capacity)}, mask{capacity - 1} { }
+
+        // Owner only. Returns false when the deque is full.
+        bool push(jobs::job const &job) noexcept
+        {
+            auto const b = bottom.load(std::memory_order_relaxed);
+            auto const t = top.load(std::memory_order_acquire);
+
+            if (b - t > static_cast<std::int64_t>(mask))
+                return false;
+
+            store(b, job);
+
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(b + 1, std::memory_order_relaxed);
+
+            return true;
+        }
+
+        // Owner only.
+        bool pop(jobs::job &job) noexcept
+        {
+            auto const b = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(b, std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            auto t = top.load(std::memory_order_relaxed);
+
+            if (t > b) {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return false;
+            }
+
+            job = load(b);
+
+            if (t == b) {
+                // The last job: race the thieves for it.
+                auto const won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+
+                bottom.store(b + 1, std::memory_order_relaxed);
+
+                return won;
+            }
+
+            return true;
+        }
+
+        // Any thread. May fail spuriously when racing another thief or the owner.
+        bool steal(jobs::job &job) noexcept
+        {
+            auto t = top.load(std::memory_order_acquire);
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            auto const b = bottom.load(std::memory_order_acquire);
+
+            if (t >= b)
+                return false;
+
+            // The owner cannot overwrite this slot before 'top' moves past it.
+            job = load(t);
+
+            return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        }
+
+        bool empty() const noexcept
+        {
+            return bottom.load(std::memory_order_acquire) <= top.load(std::memory_order_acquire);
+        }
+
+    private:
+
+        struct slot final {
+            std::atomic<jobs::task *> task{nullptr};
+            std::atomic_uint64_t range{0};
+        };
+
+        std::unique_ptr<slot[]> slots;
+        std::size_t mask;
+
+        alignas(64) std::atomic_int64_t top{0};
+        alignas(64) std::atomic_int64_t bottom{0};
+
+        void store(std::int64_t index, jobs::job const &job) noexcept
+        {
+            auto &&slot = slots[static_cast<std::size_t>(index) & mask];
+
+            slot.task.store(job.task, std::memory_order_relaxed);
+            slot.range.store(std::uint64_t{job.begin} | (std::uint64_t{job.end} << 32), std::memory_order_relaxed);
+        }
+
+        jobs::job load(std::int64_t index) const noexcept
+        {
+            auto &&slot = slots[static_cast<std::size_t>(index) & mask];
+
+            auto const range = slot.range.load(std::memory_order_relaxed);
+
+            return {slot.task.load(std::memory_order_relaxed), static_cast<std::uint32_t>(range), static_cast<std::uint32_t>(range >> 32)};
+        }
+    };
+}
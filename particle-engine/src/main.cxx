@@ -42,56 +42,13 @@
     #endif
 #endif
 
+#include <random>
+
 #include "main.hxx"
 #include "particle_engine.hxx"
+#include "input_dispatcher.hxx"
 
 
-class mouse_handler final : public platform::mouse::handler_interface {
-public:
-
-    mouse_handler(std::shared_ptr<app::particle_engine> particle_engine)
-        : particle_engine{particle_engine}, generator{random_device()} { }
-
-private:
-
-    std::weak_ptr<app::particle_engine> particle_engine;
-
-    std::random_device random_device;
-    std::mt19937 generator;
-
-    std::uniform_real_distribution<float> uniform_real_distribution{0.f, 1.f};
-
-    float last_x{0.f}, last_y{0.f};
-
-    void on_wheel(float, float) override { }
-    void on_down(handler_interface::buttons_t) override { }
-
-    void on_move(float x, float y) override
-    {
-        last_x = x;
-        last_y = y;
-    }
-
-    void on_up(handler_interface::buttons_t buttons) override
-    {
-        if (buttons.to_ulong() != 0x01)
-            return;
-        
-        if (particle_engine.expired())
-            return;
-
-        glm::vec4 color{
-            uniform_real_distribution(generator),
-            uniform_real_distribution(generator),
-            uniform_real_distribution(generator),
-            1.f
-        };
-
-        if (auto observe = particle_engine.lock(); observe)
-            observe->spawn_effect(glm::vec2{last_x, app::SCREEN_HEIGHT - last_y}, std::move(color));
-    }
-};
-
 int main()
 {
 #if defined(_MSC_VER)
@@ -118,10 +75,17 @@ int main()
     auto input_manager = std::make_shared<platform::input_manager>();
     window.connect_input_handler(input_manager);
 
-    auto particle_engine = std::make_shared<app::particle_engine>();
+    // 1 ms steps, rendered interpolated.
+    app::engine_config config;
+    config.fixed_step = std::chrono::milliseconds{1};
+
+    auto particle_engine = std::make_shared<app::particle_engine>(config);
+
+    // Every frame drains the ring into the engine.
+    platform::input_ring input_ring;
+    input_manager->mouse().connect_ring(&input_ring);
 
-    auto mouse_handler = std::make_shared<::mouse_handler>(particle_engine);
-    input_manager->mouse().connect_handler(mouse_handler);
+    app::input_dispatcher input_dispatcher{input_ring, std::random_device{}(), static_cast<float>(app::SCREEN_HEIGHT)};
 
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
@@ -131,14 +95,18 @@ int main()
     if (auto result = glGetError(); result != GL_NO_ERROR)
         throw std::runtime_error(fmt::format("OpenGL error: {0:#x}\n"s, result));
 
+    auto point_stream = std::make_unique<gfx::point_stream>();
+
     auto last = std::chrono::high_resolution_clock::now();
 
     window.update([&]
     {
         glfwPollEvents();
 
+        input_dispatcher.dispatch(*particle_engine);
+
         auto now = std::chrono::high_resolution_clock::now();
-        auto delta_time = std::chrono::duration_cast<std::chrono::milliseconds>(now - last).count();
+        auto delta_time = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last);
         last = now;
 
         particle_engine->update(delta_time);
@@ -146,9 +114,11 @@ int main()
         glViewport(0, 0, app::SCREEN_WIDTH, app::SCREEN_HEIGHT);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glBegin(GL_POINTS);
-            particle_engine->render();
-        glEnd();
+        // Less than a step behind the interpolated ones.
+        particle_engine->render_vertices([&point_stream] (simulation::point_vertex const *vertices, std::uint32_t count)
+        {
+            point_stream->draw(vertices, count);
+        });
 
         glfwSwapBuffers(window.handle());
 
@@ -156,7 +126,10 @@ int main()
             throw std::runtime_error(fmt::format("OpenGL error: {0:#x}\n"s, result));
     });
 
+    input_manager->mouse().connect_ring(nullptr);
+
     particle_engine.reset();
+    point_stream.reset();
 
     glfwTerminate();
 }
\ No newline at end of file
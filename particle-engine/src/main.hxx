@@ -21,6 +21,7 @@ using namespace std::string_view_literals;
 #include "gfx/context.hxx"
 #include "platform/input/input_manager.hxx"
 #include "platform/window.hxx"
+#include "screen.hxx"
 
 #ifdef max
     #undef max
@@ -33,9 +34,6 @@ using namespace std::string_view_literals;
 
 namespace app
 {
-	auto constexpr SCREEN_WIDTH = 1024u;
-	auto constexpr SCREEN_HEIGHT = 768u;
-
 	void render();
 	void update(int dt);
 	void on_click(int x, int y);
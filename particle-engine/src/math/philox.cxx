@@ -0,0 +1,135 @@
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define MATH_PHILOX_SSE2
+    #include <emmintrin.h>
+#endif
+
+#include "philox.hxx"
+
+
+namespace
+{
+#if defined(__AVX2__)
+    struct lanes final {
+        using type = __m256i;
+
+        static std::size_t constexpr width{8};
+
+        static type broadcast(std::uint32_t value) noexcept { return _mm256_set1_epi32(static_cast<int>(value)); }
+
+        static type load(std::uint32_t const *data) noexcept { return _mm256_loadu_si256(reinterpret_cast<__m256i const *>(data)); }
+
+        static type bitwise_xor(type a, type b) noexcept { return _mm256_xor_si256(a, b); }
+
+        static void multiply(type a, type b, type &hi, type &lo) noexcept
+        {
+            auto const even = _mm256_mul_epu32(a, b);
+            auto const odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+
+            lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0b10101010);
+            hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0b10101010);
+        }
+
+        static void store_unit_float(float *data, type value) noexcept
+        {
+            auto const unit = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(value, 8)), _mm256_set1_ps(0x1p-24f));
+
+            _mm256_storeu_ps(data, unit);
+        }
+    };
+#elif defined(MATH_PHILOX_SSE2)
+    struct lanes final {
+        using type = __m128i;
+
+        static std::size_t constexpr width{4};
+
+        static type broadcast(std::uint32_t value) noexcept { return _mm_set1_epi32(static_cast<int>(value)); }
+
+        static type load(std::uint32_t const *data) noexcept { return _mm_loadu_si128(reinterpret_cast<__m128i const *>(data)); }
+
+        static type bitwise_xor(type a, type b) noexcept { return _mm_xor_si128(a, b); }
+
+        static void multiply(type a, type b, type &hi, type &lo) noexcept
+        {
+            auto const even = _mm_mul_epu32(a, b);
+            auto const odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+            auto const low_mask = _mm_set1_epi64x(0xFFFFFFFF);
+
+            lo = _mm_or_si128(_mm_and_si128(even, low_mask), _mm_slli_epi64(odd, 32));
+            hi = _mm_or_si128(_mm_srli_epi64(even, 32), _mm_andnot_si128(low_mask, odd));
+        }
+
+        static void store_unit_float(float *data, type value) noexcept
+        {
+            auto const unit = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(value, 8)), _mm_set1_ps(0x1p-24f));
+
+            _mm_storeu_ps(data, unit);
+        }
+    };
+#endif
+
+#if defined(__AVX2__) || defined(MATH_PHILOX_SSE2)
+    // Same rounds as 'math::philox::generate', one counter per lane.
+    std::size_t uniform_batch_lanes(std::uint32_t const *ids, std::size_t count, std::uint32_t index, std::uint32_t stream,
+                                    math::philox::key_type key, float *first, float *second) noexcept
+    {
+        using namespace math::philox::detail;
+
+        auto const m0 = lanes::broadcast(M0);
+        auto const m1 = lanes::broadcast(M1);
+
+        std::size_t i = 0;
+
+        for (; i + lanes::width <= count; i += lanes::width) {
+            auto c0 = lanes::load(ids + i);
+            auto c1 = lanes::broadcast(index);
+            auto c2 = lanes::broadcast(stream);
+            auto c3 = lanes::broadcast(0);
+
+            auto k0 = key[0], k1 = key[1];
+
+            for (auto round = 0u; round < ROUNDS; ++round) {
+                lanes::type hi0, lo0, hi1, lo1;
+
+                lanes::multiply(c0, m0, hi0, lo0);
+                lanes::multiply(c2, m1, hi1, lo1);
+
+                c0 = lanes::bitwise_xor(lanes::bitwise_xor(hi1, c1), lanes::broadcast(k0));
+                c1 = lo1;
+                c2 = lanes::bitwise_xor(lanes::bitwise_xor(hi0, c3), lanes::broadcast(k1));
+                c3 = lo0;
+
+                k0 += W0;
+                k1 += W1;
+            }
+
+            lanes::store_unit_float(first + i, c0);
+            lanes::store_unit_float(second + i, c1);
+        }
+
+        return i;
+    }
+#endif
+}
+
+namespace math::philox
+{
+    void uniform_batch(std::uint32_t const *ids, std::size_t count, std::uint32_t index, std::uint32_t stream,
+                       key_type key, float *first, float *second) noexcept
+    {
+        std::size_t i = 0;
+
+#if defined(__AVX2__) || defined(MATH_PHILOX_SSE2)
+        i = uniform_batch_lanes(ids, count, index, stream, key, first, second);
+#endif
+
+        for (; i < count; ++i) {
+            auto const random = generate(counter_type{ids[i], index, stream, 0}, key);
+
+            first[i] = to_unit_float(random[0]);
+            second[i] = to_unit_float(random[1]);
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+
+namespace math
+{
+    // Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"): stateless, any order.
+    namespace philox
+    {
+        using counter_type = std::array<std::uint32_t, 4>;
+        using key_type = std::array<std::uint32_t, 2>;
+
+        namespace detail
+        {
+            std::uint32_t constexpr M0{0xD2511F53};
+            std::uint32_t constexpr M1{0xCD9E8D57};
+
+            std::uint32_t constexpr W0{0x9E3779B9};
+            std::uint32_t constexpr W1{0xBB67AE85};
+
+            std::uint32_t constexpr ROUNDS{10};
+        }
+
+        [[nodiscard]] constexpr counter_type generate(counter_type counter, key_type key) noexcept
+        {
+            for (auto round = 0u; round < detail::ROUNDS; ++round) {
+                auto const product0 = std::uint64_t{detail::M0} * counter[0];
+                auto const product1 = std::uint64_t{detail::M1} * counter[2];
+
+                counter = counter_type{
+                    static_cast<std::uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+                    static_cast<std::uint32_t>(product1),
+                    static_cast<std::uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+                    static_cast<std::uint32_t>(product0)
+                };
+
+                key[0] += detail::W0;
+                key[1] += detail::W1;
+            }
+
+            return counter;
+        }
+
+        // Upper 24 bits: exact in float and never 1.
+        [[nodiscard]] constexpr float to_unit_float(std::uint32_t value) noexcept
+        {
+            return static_cast<float>(value >> 8) * 0x1p-24f;
+        }
+
+        // 'generate({ids[i], index, stream, 0}, key)' as two uniform floats, SIMD where available.
+        void uniform_batch(std::uint32_t const *ids, std::size_t count, std::uint32_t index, std::uint32_t stream,
+                           key_type key, float *first, float *second) noexcept;
+    }
+}
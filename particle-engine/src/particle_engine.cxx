@@ -1,4 +1,17 @@
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
 #include "particle_engine.hxx"
+#include "frame_recorder.hxx"
+#include "simulation/integrate.hxx"
+#include "utility/profiler.hxx"
+#include "utility/spin_wait.hxx"
+#include "utility/topology.hxx"
 
 #ifdef max
 #undef max
@@ -11,274 +24,1602 @@
 
 namespace app
 {
-    particle_engine::particle_engine()
+    particle_engine::particle_engine(app::engine_config const &config) : particle_engine{config, nullptr, nullptr, 0} { }
+
+    particle_engine::particle_engine(app::engine_config const &config, jobs::job_system *batch_pool, utility::memory_arena *batch_arena, std::size_t arena_offset)
+        : config{config}, arena_offset{arena_offset}, batched{batch_pool != nullptr}
     {
         stop_workers = false;
 
-        for (auto &&index : acquired_indices)
-            index.clear();
+        this->config.capacity = std::max(config.capacity, 1u);
+
+        auto const capacity = this->config.capacity;
+
+        auto const grid_cell_size = config.grid_cell_size > 0.f ? config.grid_cell_size : config.interaction_radius;
+
+        if (config.storage == simulation::storage_layout::compact) {
+            if (grid_cell_size > 0.f)
+                throw std::invalid_argument("compact storage keeps no positions for a grid to index");
+
+            palette = std::make_unique<std::uint32_t[]>(PALETTE_SIZE);
+            decoded_vertices.resize(capacity);
+        }
+
+        if (batch_arena == nullptr) {
+            own_arena = std::make_unique<utility::memory_arena>(frames_size(this->config, utility::memory_arena::page_size_of(config.page_policy)), config.page_policy);
+            batch_arena = own_arena.get();
+        }
+
+        arena = batch_arena;
+
+        for (auto frame_index = 0u; frame_index < FRAMES_COUNT; ++frame_index) {
+            auto &&frame_data = frames_data.at(frame_index);
+
+            frame_data.particles = frame_storage(frame_index);
+
+            frame_data.expiry = std::make_unique<simulation::expiry_index>(capacity);
+
+            if (grid_cell_size > 0.f) {
+                frame_data.grid = std::make_unique<simulation::spatial_grid>(static_cast<float>(app::SCREEN_WIDTH), static_cast<float>(app::SCREEN_HEIGHT),
+                                                                             grid_cell_size, capacity);
+            }
+
+            if (!config.grow_on_demand)
+                commit_frame(frame_data, capacity);
+        }
+
+        // Every type may end its simulate blocks with a partial one.
+        auto const max_blocks_count = MAX_SPAWN_BLOCKS_COUNT + (capacity + PARTICLES_CHUNK_SIZE - 1) / PARTICLES_CHUNK_SIZE + app::effect_types::count;
+
+        block_offsets = std::make_unique<std::atomic_uint64_t[]>(max_blocks_count);
+        block_births = std::make_unique<std::uint32_t[]>(max_blocks_count);
+
+        step.effects.reserve(SPAWN_QUEUE_CAPACITY);
+        pending_cascades.reserve(SPAWN_QUEUE_CAPACITY);
+
+        death_bins.resize(DEATH_BINS_COUNT);
+
+        if (config.step_budget.count() > 0)
+            budget = std::make_unique<app::budget_controller>(config.step_budget);
+
+        // The batch runs the steps with worker contexts of its own.
+        if (batch_pool != nullptr) {
+            this->config.workers_count = batch_pool->workers_count();
+            pool = batch_pool;
+
+            return;
+        }
+
+        auto const workers_count = config.workers_count != 0 ? config.workers_count
+                                 : !config.cpus.empty() ? static_cast<std::uint32_t>(config.cpus.size()) : default_workers_count();
+        this->config.workers_count = workers_count;
+
+        std::vector<std::vector<std::uint32_t>> worker_cpus;
+
+        if (config.numa_aware) {
+            auto const cpus = !config.cpus.empty() ? config.cpus : utility::available_cpus();
+
+            std::vector<utility::numa_node> nodes;
+
+            if (config.numa_nodes != 0)
+                nodes = utility::emulate_numa_nodes(config.numa_nodes, cpus);
+
+            else for (auto &&node : utility::numa_nodes()) {
+                std::vector<std::uint32_t> node_cpus;
+
+                std::set_intersection(std::cbegin(node.cpus), std::cend(node.cpus), std::cbegin(cpus), std::cend(cpus), std::back_inserter(node_cpus));
 
-        acquired_indices.at(0).test_and_set();
+                if (!node_cpus.empty())
+                    nodes.push_back(utility::numa_node{node.index, std::move(node_cpus)});
+            }
+
+            if (nodes.empty())
+                nodes = utility::emulate_numa_nodes(1, cpus);
 
-        frames_data.resize(FRAMES_COUNT);
+            nodes_count_ = std::min(static_cast<std::uint32_t>(nodes.size()), workers_count);
 
-        auto const workers_count = std::max(std::thread::hardware_concurrency() - 1u, 1u);
+            // Contiguous worker groups per node, as neighbouring slices share pages.
+            for (auto worker_index = 0u; worker_index < workers_count; ++worker_index)
+                worker_cpus.push_back(nodes[static_cast<std::uint64_t>(worker_index) * nodes_count_ / workers_count].cpus);
+        }
 
-        barrier = std::make_unique<utility::barrier>(workers_count);
+        else if (!config.cpus.empty()) {
+            for (auto worker_index = 0u; worker_index < workers_count; ++worker_index)
+                worker_cpus.push_back({config.cpus[worker_index % config.cpus.size()]});
+        }
 
-        workers.reserve(workers_count);
+        worker_contexts.reserve(workers_count);
 
         for (auto worker_index = 0u; worker_index < workers_count; ++worker_index)
-            workers.emplace_back(&particle_engine::worker_object, this, worker_index);
+            worker_contexts.emplace_back(worker_index);
+
+        simulate_slices_task = jobs::make_task(
+            [this] (std::uint32_t, std::uint32_t, std::uint32_t worker_index)
+            {
+                process_slice(worker_contexts[worker_index], worker_index);
+            },
+            [this] (std::uint32_t)
+            {
+                finish_step();
+            }
+        );
+
+        simulate_task = jobs::make_task(
+            [this] (std::uint32_t begin, std::uint32_t end, std::uint32_t worker_index)
+            {
+                for (auto block = begin; block < end; ++block)
+                    process_block(worker_contexts[worker_index], block);
+            },
+            [this] (std::uint32_t)
+            {
+                finish_step();
+            }
+        );
+
+        grid_count_task = jobs::make_task(
+            [this] (std::uint32_t begin, std::uint32_t end, std::uint32_t)
+            {
+                PROFILE_SCOPE(grid_count);
+
+                auto &&particles = step.write_frame->particles;
+
+                step.write_frame->grid->count(particles.x, particles.y, begin * PARTICLES_CHUNK_SIZE,
+                                              std::min(end * PARTICLES_CHUNK_SIZE, step.write_frame->particles_count));
+            },
+            [this] (std::uint32_t)
+            {
+                step.write_frame->grid->prefix_sum();
+
+                pool->submit(*grid_scatter_task, (step.write_frame->particles_count + PARTICLES_CHUNK_SIZE - 1) / PARTICLES_CHUNK_SIZE);
+            }
+        );
+
+        grid_scatter_task = jobs::make_task(
+            [this] (std::uint32_t begin, std::uint32_t end, std::uint32_t)
+            {
+                PROFILE_SCOPE(grid_scatter);
+
+                step.write_frame->grid->scatter(begin * PARTICLES_CHUNK_SIZE, std::min(end * PARTICLES_CHUNK_SIZE, step.write_frame->particles_count));
+            },
+            [this] (std::uint32_t)
+            {
+                auto const cells_count = step.write_frame->grid->cells_count();
+
+                pool->submit(*grid_sort_task, (cells_count + GRID_CELLS_PER_JOB - 1) / GRID_CELLS_PER_JOB);
+            }
+        );
+
+        grid_sort_task = jobs::make_task(
+            [this] (std::uint32_t begin, std::uint32_t end, std::uint32_t)
+            {
+                PROFILE_SCOPE(grid_sort);
+
+                auto &&grid = *step.write_frame->grid;
+
+                grid.sort_cells(begin * GRID_CELLS_PER_JOB, std::min(end * GRID_CELLS_PER_JOB, grid.cells_count()));
+            },
+            [this] (std::uint32_t)
+            {
+                publish_step();
+            }
+        );
+
+        own_pool = std::make_unique<jobs::job_system>(workers_count, worker_cpus);
+        pool = own_pool.get();
     }
 
     particle_engine::~particle_engine()
     {
         stop_workers = true;
-        barrier->drop();
 
-        for (auto &worker : workers)
-            worker.join();
+        // Waits for the step in flight, if any, and keeps new ones from starting.
+        while (step_in_flight.exchange(true))
+            std::this_thread::yield();
+
+        own_pool.reset();
     }
 
-    void app::particle_engine::update(std::int64_t dt)
+    simulation::particle_storage particle_engine::frame_storage(std::uint32_t frame_index) const noexcept
     {
-        global_timer.fetch_add(dt);
+        // Page aligned arrays, so growing one never commits another.
+        auto const alignment = arena->page_size();
+        auto const frame_size = simulation::particle_storage::required_size(config.capacity, alignment, config.storage);
+
+        return simulation::particle_storage{arena->data() + arena_offset + frame_index * frame_size, config.capacity, alignment, config.storage};
     }
 
-    void particle_engine::render()
+    std::size_t particle_engine::frames_size(app::engine_config const &config, std::size_t alignment) noexcept
     {
-        auto frame_index = acquire_frame_index(shared_frame_read_index.load());
+        return FRAMES_COUNT * simulation::particle_storage::required_size(std::max(config.capacity, 1u), alignment, config.storage);
+    }
 
-        auto &&frame_data = frames_data.at(frame_index);
+    void app::particle_engine::update(std::chrono::nanoseconds dt)
+    {
+        auto const now = global_timer.fetch_add(dt.count()) + dt.count();
 
-        for (auto i = 0u; i < frame_data.particles_count; ++i) {
-            auto &&particle = frame_data.particles.at(i);
-            auto &&position = particle.position;
-            auto &&color = particle.color;
+        // Beyond the cap the steps can not catch up anymore.
+        if (config.fixed_step.count() != 0 && config.max_steps_per_update != 0) {
+            auto const limit = config.fixed_step.count() * config.max_steps_per_update;
 
-            gfx::draw_point(position.x, position.y, color.r, color.g, color.b, color.a);
+            for (auto simulated = simulated_time.load(); now - simulated > limit;) {
+                if (simulated_time.compare_exchange_weak(simulated, now - limit)) {
+                    dropped_time_.fetch_add(now - limit - simulated);
+                    break;
+                }
+            }
         }
 
-        release_frame_index(frame_index);
+        schedule_step();
     }
 
-    void particle_engine::spawn_effect(glm::vec2 &&position, glm::vec4 &&color)
+    bool particle_engine::settled() const noexcept
     {
-        auto frame_index = acquire_available_frame_index();
+        // No step can start once the one in flight is over.
+        return global_timer.load() - simulated_time.load() < step_threshold() && !step_in_flight.load();
+    }
 
-        auto &&frame_data = frames_data.at(frame_index);
+    float particle_engine::interpolation_factor(app::frame_data const &frame_data) const noexcept
+    {
+        if (config.fixed_step.count() == 0 || frame_data.duration == 0)
+            return 1.f;
 
-        frame_data.effect.count = PER_EFFECT_PARTICLES_COUNT;
-        frame_data.effect.position = std::move(position);
-        frame_data.effect.color = std::move(color);
+        auto const ahead = static_cast<double>(global_timer.load() - frame_data.end_time) / static_cast<double>(frame_data.duration);
 
-        release_frame_index(frame_index);
+        return static_cast<float>(std::clamp(ahead, 0., 1.));
     }
 
-    void particle_engine::worker_object(std::uint32_t worker_index)
+    memory_statistics particle_engine::memory_stats() const noexcept
     {
-        auto frame_read_index = 0u, frame_write_index = 1u;
+        memory_statistics stats{own_arena != nullptr ? arena->size() : frames_size(config, arena->page_size()), 0, arena->policy()};
 
-        barrier->wait();
+        auto const particle_size = config.storage == simulation::storage_layout::compact ? simulation::particle_storage::COMPACT_PARTICLE_SIZE
+                                                                                         : simulation::particle_storage::PARTICLE_SIZE;
 
-        app::worker_context worker_context{worker_index};
+        for (auto &&frame_data : frames_data)
+            stats.committed_bytes += std::size_t{frame_data.committed_count.load()} * particle_size;
 
-        while (!stop_workers) {
-            update_worker_time_points(worker_context);
+        return stats;
+    }
 
-            if (worker_context.dt == 0) {
-                std::this_thread::sleep_for(UPDATE_PERIOD - std::chrono::milliseconds{worker_context.dt});
-                continue;
-            }
+    std::uint32_t particle_engine::default_workers_count() noexcept
+    {
+        return std::max(std::thread::hardware_concurrency() - 1u, 1u);
+    }
+
+    bool particle_engine::spawn_effect(glm::vec2 &&position, glm::vec4 &&color, std::uint32_t type, std::chrono::steady_clock::time_point request_time)
+    {
+        if (type >= app::effect_types::count)
+            throw std::out_of_range("no effect type " + std::to_string(type));
+
+        auto const count = app::effect_types::visit(type, [] <class T> () { return T::emission::count; });
+
+        auto const request_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(request_time.time_since_epoch()).count();
+
+        if (spawn_queue.try_push(app::effect{count, 0, std::move(position), std::move(color), type, false, request_ns}))
+            return true;
+
+        dropped_effects.fetch_add(1, std::memory_order_relaxed);
 
-            frame_write_index = shared_frame_write_index.load();
-            
-            worker_context.read_frame = &frames_data.at(frame_read_index);
-            worker_context.write_frame = &frames_data.at(frame_write_index);
+        return false;
+    }
 
-            auto &&read_frame = *worker_context.read_frame;
-            auto &&write_frame = *worker_context.write_frame;
+    spawn_statistics particle_engine::spawn_stats() const noexcept
+    {
+        return spawn_statistics{ingested_effects.load(), dropped_effects.load(), max_effects_per_step.load(), ingested_cascades.load(), dropped_cascades.load(),
+                                overflow_effects.load(), evicted_particles.load()};
+    }
 
-            add_particles(worker_context);
+    budget_statistics particle_engine::budget_stats() const noexcept
+    {
+        budget_statistics stats{degradation_level_.load(), max_degradation_level.load(), {}, over_budget_steps.load(), last_step_cost.load()};
 
-            process_particles(worker_context);
+        for (auto level = 0u; level < level_steps.size(); ++level)
+            stats.level_steps[level] = level_steps[level].load();
 
-            frame_read_index = frame_write_index;
+        return stats;
+    }
 
-            if ((++idle_workers) == workers.size()) {
-                const_cast<app::frame_data &>(read_frame).effect.count = 0;
-                
-                write_frame.particles_count = std::min(TOTAL_PARTICLES_COUNT, job_count.load());
-                
-                shared_frame_read_index = frame_read_index;
+    void particle_engine::save_snapshot(std::string const &path)
+    {
+        if (config.storage != simulation::storage_layout::full)
+            throw std::logic_error("only frames of full storage can be saved");
 
-                frame_write_index = acquire_available_frame_index();
-                shared_frame_write_index = frame_write_index;
+        // The frames producer now, so the published frame stays the saved one.
+        while (step_in_flight.exchange(true))
+            std::this_thread::yield();
 
-                release_frame_index(frame_write_index);
+        auto &&frame_data = frames_data.at(frames_exchange.published());
 
-                shared_effect_read_index = 0;
+        app::snapshot_header header;
+        header.alignment = app::snapshot_header::PAGE_ALIGNMENT;
+        header.particle_size = static_cast<std::uint32_t>(simulation::particle_storage::PARTICLE_SIZE);
+        header.particles_count = frame_data.particles_count;
+        header.update_time = global_timer.load();
+        header.simulated_time = simulated_time.load();
+        header.from_start_time = step.from_start_time.count();
+        header.end_time = frame_data.end_time;
+        header.duration = frame_data.duration;
+        header.steps = published_steps.load();
+        header.spawn_sequence = spawn_sequence_base + spawn_queue.popped_count();
+        header.next_descendant_id = next_descendant_id;
+        header.effect_types_count = app::effect_types::count;
+        header.cascades_count = static_cast<std::uint32_t>(pending_cascades.size());
 
-                shared_particle_read_index = 0;
-                shared_particle_write_index = 0;
+        std::copy(std::cbegin(frame_data.type_offsets), std::cend(frame_data.type_offsets), std::begin(header.type_offsets));
 
-                job_count = 0;
+        std::ofstream file{path, std::ios::binary | std::ios::trunc};
 
-                idle_workers = 0;
+        std::vector<char> padding(header.alignment, 0);
 
-                barrier->wait();
-            }
+        // Every array in one write, padded up to the next one.
+        auto write = [&file, &padding] (void const *data, std::size_t size)
+        {
+            file.write(static_cast<char const *>(data), static_cast<std::streamsize>(size));
+            file.write(padding.data(), static_cast<std::streamsize>((padding.size() - size % padding.size()) % padding.size()));
+        };
 
-            else barrier->wait();
-        }
+        write(&header, sizeof(header));
+
+        frame_data.particles.for_each_range(0, frame_data.particles_count, write);
+
+        write(pending_cascades.data(), pending_cascades.size() * sizeof(app::effect));
+
+        file.close();
+
+        step_in_flight = false;
+
+        // Time added while the step was owned here found it taken.
+        schedule_step();
+
+        if (!file)
+            throw std::runtime_error("failed to write '" + path + "'");
     }
 
-    std::uint32_t particle_engine::acquire_available_frame_index()
+    void particle_engine::load_snapshot(std::string const &path)
     {
-        auto index = shared_frame_read_index.load();
+        if (published_steps.load() != 0 || global_timer.load() != 0 || snapshot != nullptr)
+            throw std::logic_error("a snapshot can only be loaded into an engine that has not been updated");
+
+        if (config.storage != simulation::storage_layout::full)
+            throw std::logic_error("a snapshot can only be loaded into an engine of full storage");
+
+        auto file = std::make_unique<utility::mapped_file>(path);
+
+        app::snapshot_header header;
+
+        if (file->size() < sizeof(header))
+            throw std::runtime_error("'" + path + "' is not a snapshot");
+
+        std::memcpy(&header, file->data(), sizeof(header));
+
+        if (header.magic != app::snapshot_header{}.magic)
+            throw std::runtime_error("'" + path + "' is not a snapshot");
+
+        if (header.version != app::snapshot_header::SNAPSHOT_VERSION || header.particle_size != simulation::particle_storage::PARTICLE_SIZE ||
+            header.effect_types_count != app::effect_types::count)
+            throw std::runtime_error("'" + path + "' is a snapshot of another version");
+
+        auto const alignment = std::size_t{header.alignment};
+
+        if (alignment < sizeof(header) || (alignment & (alignment - 1)) != 0)
+            throw std::runtime_error("'" + path + "' is truncated or corrupt");
+
+        auto const cascades_offset = alignment + simulation::particle_storage::required_size(header.particles_count, alignment);
 
-        do {
-            index = (index + 1) % FRAMES_COUNT;
-        } while (index == shared_frame_read_index.load() || acquired_indices.at(index).test_and_set());
+        auto &&type_offsets = header.type_offsets;
 
-        return index;
+        if (file->size() < cascades_offset + std::size_t{header.cascades_count} * sizeof(app::effect) || header.cascades_count > SPAWN_QUEUE_CAPACITY ||
+            type_offsets[0] != 0 || type_offsets[app::effect_types::count] != header.particles_count ||
+            !std::is_sorted(std::cbegin(type_offsets), std::next(std::cbegin(type_offsets), app::effect_types::count + 1)))
+            throw std::runtime_error("'" + path + "' is truncated or corrupt");
+
+        if (header.particles_count > config.capacity)
+            throw std::runtime_error("'" + path + "' holds " + std::to_string(header.particles_count) + " particles, more than the capacity of " + std::to_string(config.capacity));
+
+        std::vector<app::effect> cascades(header.cascades_count);
+        std::memcpy(cascades.data(), file->data() + cascades_offset, cascades.size() * sizeof(app::effect));
+
+        // Spawned as they are by the next step.
+        auto const valid_cascade = [] (app::effect const &cascade)
+        {
+            return cascade.type < app::effect_types::count && cascade.count != 0 &&
+                   cascade.count <= app::effect_types::visit(cascade.type, [] <class T> () { return T::emission::count; });
+        };
+
+        if (!std::all_of(std::cbegin(cascades), std::cend(cascades), valid_cascade))
+            throw std::runtime_error("'" + path + "' is truncated or corrupt");
+
+        while (step_in_flight.exchange(true))
+            std::this_thread::yield();
+
+        snapshot_frame_index = frames_exchange.published();
+
+        auto &&frame_data = frames_data.at(snapshot_frame_index);
+
+        // Only ever read.
+        frame_data.particles = simulation::particle_storage{const_cast<std::byte *>(file->data()) + alignment, header.particles_count, alignment};
+        frame_data.particles_count = header.particles_count;
+        frame_data.end_time = header.end_time;
+        frame_data.duration = header.duration;
+
+        std::copy_n(std::cbegin(type_offsets), frame_data.type_offsets.size(), std::begin(frame_data.type_offsets));
+
+        pending_cascades.assign(std::cbegin(cascades), std::cend(cascades));
+
+        frame_data.expiry->reset(static_cast<std::uint32_t>(header.steps));
+        frame_data.expiry->insert(0, frame_data.particles.death_time, frame_data.particles_count);
+
+        if (frame_data.grid != nullptr)
+            build_grid(frame_data);
+
+        snapshot = std::move(file);
+
+        simulated_time = header.simulated_time;
+        global_timer = header.update_time;
+
+        step.from_start_time = std::chrono::nanoseconds{header.from_start_time};
+
+        // Nothing left standing for the next step to catch up on.
+        step.degradation = {};
+
+        spawn_sequence_base = header.spawn_sequence - spawn_queue.popped_count();
+        next_descendant_id = header.next_descendant_id;
+
+        published_particles_count = header.particles_count;
+        published_steps = header.steps;
+
+        step_in_flight = false;
+
+        schedule_step();
     }
 
-    std::uint32_t particle_engine::acquire_frame_index(std::uint32_t index)
+    void particle_engine::record(app::frame_recorder *recorder)
     {
-        acquired_indices.at(index).test_and_set();
+        while (step_in_flight.exchange(true))
+            std::this_thread::yield();
 
-        return index;
+        this->recorder = recorder;
+
+        step_in_flight = false;
+
+        schedule_step();
     }
 
-    std::uint32_t particle_engine::release_frame_index(std::uint32_t index)
+    void particle_engine::schedule_step()
     {
-        acquired_indices.at(index).clear();
+        // The batch starts the steps of its worlds.
+        if (batched)
+            return;
+
+        while (!stop_workers) {
+            if (step_in_flight.exchange(true))
+                return;
 
-        return index;
+            if (auto const now = global_timer.load(); now - simulated_time.load() >= step_threshold()) {
+                begin_step(now);
+
+                if (config.numa_aware)
+                    pool->submit_to_each_worker(*simulate_slices_task);
+
+                else pool->submit(*simulate_task, step.blocks_count);
+
+                return;
+            }
+
+            step_in_flight = false;
+
+            // Nobody else will start it.
+            if (global_timer.load() - simulated_time.load() < step_threshold())
+                return;
+        }
     }
 
-    void particle_engine::update_worker_time_points(app::worker_context &worker_context)
+    void particle_engine::begin_step(std::int64_t now)
     {
-        thread_local static std::int64_t last_time = 0;
+        step_begin_time = std::chrono::steady_clock::now();
+
+        // Of the previous step, before its settings go.
+        step.frozen_dt = step.degradation.half_rate_old && (step.step_tag & 1) != 0 ? step.dt : std::chrono::nanoseconds{0};
 
-        auto global_time = global_timer.load();
-        worker_context.dt = static_cast<std::uint64_t>(global_time - last_time);
-        last_time = global_time;
+        if (budget != nullptr)
+            step.degradation = app::budget_controller::LEVELS[budget->level()];
 
-        worker_context.from_start_time += std::chrono::milliseconds{worker_context.dt};
+        std::int64_t end_time;
+
+        if (config.fixed_step.count() != 0) {
+            step.dt = config.fixed_step;
+            end_time = simulated_time.fetch_add(step.dt.count()) + step.dt.count();
+        }
+
+        else {
+            step.dt = std::chrono::nanoseconds{now - simulated_time.exchange(now)};
+            end_time = now;
+        }
+
+        step.from_start_time += step.dt;
+
+        set_drags();
+
+        step.read_frame_index = frames_exchange.published();
+        step.write_frame_index = frames_exchange.back();
+
+        step.read_frame = &frames_data.at(step.read_frame_index);
+        step.write_frame = &frames_data.at(step.write_frame_index);
+
+        // The snapshot frame is done with once its slot comes around to be written.
+        if (snapshot != nullptr && step.write_frame_index == snapshot_frame_index) {
+            step.write_frame->particles = frame_storage(step.write_frame_index);
+            snapshot.reset();
+        }
+
+        step.write_frame->end_time = end_time;
+        step.write_frame->duration = step.dt.count();
+
+        step.step_tag = static_cast<std::uint32_t>(published_steps.load() + 1);
+        step.random_key = math::philox::key_type{step.step_tag, RANDOM_SEED};
+
+        step.first_descendant_id = next_descendant_id;
+
+        step.write_frame->expiry->reset(step.step_tag);
+        step.effects.assign(std::cbegin(pending_cascades), std::cend(pending_cascades));
+
+        auto const cascades_count = static_cast<std::uint32_t>(pending_cascades.size());
+
+        ingested_cascades.fetch_add(cascades_count, std::memory_order_relaxed);
+
+        // Requests pushed while draining wait for the next step.
+        for (app::effect effect; step.effects.size() < SPAWN_QUEUE_CAPACITY;) {
+            auto const sequence = static_cast<std::uint32_t>(spawn_sequence_base + spawn_queue.popped_count());
+
+            if (!spawn_queue.try_pop(effect))
+                break;
+
+            effect.sequence = sequence;
+            step.effects.push_back(effect);
+        }
+
+        auto const effects_count = static_cast<std::uint32_t>(step.effects.size()) - cascades_count;
+
+        ingested_effects.fetch_add(effects_count, std::memory_order_relaxed);
+
+        if (effects_count > max_effects_per_step.load(std::memory_order_relaxed))
+            max_effects_per_step.store(effects_count, std::memory_order_relaxed);
+
+        auto &&effects = step.effects;
+
+        fit_spawns(cascades_count);
+
+        auto by_type = [] (app::effect const &lhs, app::effect const &rhs) { return lhs.type < rhs.type; };
+
+        if (!std::is_sorted(std::cbegin(effects), std::cend(effects), by_type))
+            std::stable_sort(std::begin(effects), std::end(effects), by_type);
+
+        if (palette != nullptr) {
+            step.palette_base = palette_cursor;
+
+            for (auto &&effect : effects)
+                palette[palette_cursor++ % PALETTE_SIZE] = simulation::pack_color(effect.color);
+        }
+
+        auto &&type_offsets = step.read_frame->type_offsets;
+
+        auto block = 0u;
+        auto effect_index = 0u;
+
+        std::array<std::uint32_t, app::effect_types::count> type_spawns{};
+
+        for (auto type = 0u; type < app::effect_types::count; ++type) {
+            auto &&blocks = step.types[type];
+
+            blocks.effects_begin = effect_index;
+
+            for (; effect_index < effects.size() && effects[effect_index].type == type; ++effect_index)
+                ;
+
+            blocks.effects_end = effect_index;
+
+            for (auto e = blocks.effects_begin; e < blocks.effects_end; ++e)
+                type_spawns[type] += effects[e].count;
+
+            auto const spawn_blocks_count = (blocks.effects_end - blocks.effects_begin + EFFECTS_PER_SPAWN_BLOCK - 1) / EFFECTS_PER_SPAWN_BLOCK;
+
+            blocks.spawn_begin = block;
+            block += type == 0 ? std::max(1u, spawn_blocks_count) : spawn_blocks_count;
+
+            blocks.simulate_begin = block;
+            block += (type_offsets[type + 1] - type_offsets[type] + PARTICLES_CHUNK_SIZE - 1) / PARTICLES_CHUNK_SIZE;
+
+            blocks.end = block;
+        }
+
+        step.blocks_count = block;
+
+        for (auto type = app::effect_types::count, later_spawns = 0u; type-- > 0; later_spawns += type_spawns[type])
+            step.types[type].later_spawns = later_spawns;
+
+        fit_particles(step.types.front().later_spawns + type_spawns.front());
+    }
+
+    void particle_engine::set_drags() noexcept
+    {
+        auto const dt = static_cast<float>(std::chrono::duration<double>(step.dt).count());
+        auto const catch_up_dt = static_cast<float>(std::chrono::duration<double>(step.dt + step.frozen_dt).count());
+
+        for (auto type = 0u; type < app::effect_types::count; ++type) {
+            std::tie(step.drags[type], step.catch_up_drags[type]) = app::effect_types::visit(type, [dt, catch_up_dt] <class T> ()
+            {
+                return std::pair{T::forces::drag_over(dt), T::forces::drag_over(catch_up_dt)};
+            });
+        }
     }
 
-    void particle_engine::process_particles(app::worker_context &worker_context)
+    void particle_engine::fit_spawns(std::uint32_t cascades_count)
     {
-        auto &&generator = worker_context.generator;
-        auto &&bernoulli_distribution = worker_context.bernoulli_distribution;
-        auto &&uniform_real_distribution = worker_context.uniform_real_distribution;
+        auto &&effects = step.effects;
 
-        auto &&read_frame = *worker_context.read_frame;
-        auto &&write_frame = *worker_context.write_frame;
+        auto count_of = [&effects] (std::size_t begin, std::size_t end)
+        {
+            std::uint64_t count = 0;
 
-        auto is_dead = false;
-        auto is_outside = false;
-        auto is_exploded = false;
+            for (auto e = begin; e < end; ++e)
+                count += effects[e].count;
 
-        for (auto idx = shared_particle_read_index++; idx < read_frame.particles_count; idx = shared_particle_read_index++) {
-            auto &&read_particle = read_frame.particles.at(idx);
+            return count;
+        };
 
-            auto elapsed = static_cast<float>((worker_context.from_start_time - read_particle.born_time).count());
-            auto life_time = static_cast<float>(PARTICLE_LIFE_TIME.count()) * (uniform_real_distribution(generator) * .5f + .5f);
+        auto const capacity = std::uint64_t{config.capacity};
 
-            //is_dead = worker_context.from_start_time - read_particle.born_time > PARTICLE_LIFE_TIME;
-            is_dead = elapsed > life_time;
-            is_outside = is_particle_outside(read_particle);
-            is_exploded = !is_outside && is_dead && bernoulli_distribution(generator);
+        auto const cascades_spawns = count_of(0, cascades_count);
+        auto const requested_spawns = count_of(cascades_count, effects.size());
 
-            if (!is_outside & !is_dead) {
-                auto job_write_index = shared_particle_write_index++;
+        if (cascades_spawns + requested_spawns <= capacity)
+            return;
 
-                if (job_write_index >= TOTAL_PARTICLES_COUNT)
-                    continue;
+        // The requests first, then the cascades.
+        auto requests_end = std::size_t{cascades_count};
 
-                auto &&write_particle = write_frame.particles.at(job_write_index);
+        for (auto room = capacity; requests_end < effects.size() && effects[requests_end].count <= room; room -= effects[requests_end++].count)
+            ;
 
-                write_particle.born_time = read_particle.born_time;
-                write_particle.time_stamp = worker_context.from_start_time;
-                write_particle.color = read_particle.color;
+        auto cascades_end = std::size_t{0};
 
-                auto dt = static_cast<float>(worker_context.dt) * 1e-3f;
+        for (auto room = capacity - count_of(cascades_count, requests_end); cascades_end < cascades_count && effects[cascades_end].count <= room; room -= effects[cascades_end++].count)
+            ;
 
-                write_particle.position = read_particle.position + read_particle.velocity * dt;
-                write_particle.velocity = read_particle.velocity * C_DRAG - glm::vec2{0, G_ACCEL * dt};
+        overflow_effects.fetch_add(cascades_count - cascades_end + effects.size() - requests_end, std::memory_order_relaxed);
 
-                ++job_count;
-            }
+        effects.erase(std::begin(effects) + static_cast<std::ptrdiff_t>(requests_end), std::end(effects));
+        effects.erase(std::begin(effects) + static_cast<std::ptrdiff_t>(cascades_end), std::begin(effects) + cascades_count);
+    }
 
-            else if (is_exploded) {
-                auto j = shared_particle_write_index++;
+    void particle_engine::fit_particles(std::uint32_t spawns)
+    {
+        auto &&read_frame = *step.read_frame;
+
+        auto const from_start_time = step.from_start_time.count();
+        auto const cull_time = from_start_time + step.degradation.cull_horizon;
+
+        auto const capacity = std::uint64_t{config.capacity};
+
+        step.evict_before = std::numeric_limits<std::int64_t>::min();
 
-                for (auto i = 0u; j < TOTAL_PARTICLES_COUNT; ++i, j = shared_particle_write_index++) {
-                    if (i >= PER_EFFECT_PARTICLES_COUNT)
-                        break;
+        // At most everything lives on and the buckets dying in the step explode.
+        auto most_births = std::uint64_t{0};
 
-                    auto &&particle = write_frame.particles.at(j);
+        for (auto type = 0u; type < app::effect_types::count; ++type) {
+            most_births += visit_kernels(type, [this, &read_frame, type, from_start_time] <class T, simulation::storage_layout Layout> ()
+            {
+                using on_death = typename T::on_death;
 
-                    particle.born_time = worker_context.from_start_time;
+                auto births = std::uint64_t{0};
 
-                    particle.position = read_particle.position;
-                    particle.color = read_particle.color;
+                if constexpr (on_death::kind == simulation::death_kind::explode) {
+                    auto const begin = read_frame.type_offsets[type];
+                    auto const end = read_frame.type_offsets[type + 1];
 
-                    randomize_velocity_vector(worker_context, particle.velocity);
+                    for (auto i = begin; i < end;) {
+                        auto const bucket = i / simulation::expiry_index::BUCKET_SIZE;
+                        auto const bucket_end = std::min(end, (bucket + 1) * simulation::expiry_index::BUCKET_SIZE);
 
-                    ++job_count;
+                        if (read_frame.expiry->may_expire(bucket, from_start_time))
+                            births += bucket_end - i;
+
+                        i = bucket_end;
+                    }
+
+                    births *= step.degradation.fan_out(on_death::burst::count);
                 }
-            }
+
+                return births;
+            });
         }
+
+        if (std::uint64_t{read_frame.particles_count} + spawns + most_births <= capacity)
+            return;
+
+        std::fill(std::begin(death_bins), std::end(death_bins), 0u);
+
+        auto births = std::uint64_t{0};
+
+        for (auto type = 0u; type < app::effect_types::count; ++type) {
+            births += visit_kernels(type, [this, cull_time] <class T, simulation::storage_layout Layout> ()
+            {
+                return bin_survivors<T, Layout>(cull_time);
+            });
+        }
+
+        auto const survivors = std::accumulate(std::cbegin(death_bins), std::cend(death_bins), std::uint64_t{0});
+        auto const room = capacity - std::min(capacity, spawns + births);
+
+        if (survivors <= room)
+            return;
+
+        // Whole bins, the soonest dying first, until the rest fit.
+        auto evicted = 0u;
+        auto bin = 0u;
+
+        for (; bin < DEATH_BINS_COUNT && survivors - evicted > room; ++bin)
+            evicted += death_bins[bin];
+
+        step.evict_before = bin < DEATH_BINS_COUNT ? cull_time + (static_cast<std::int64_t>(bin) << DEATH_BIN_SHIFT) : std::numeric_limits<std::int64_t>::max();
+
+        evicted_particles.fetch_add(evicted, std::memory_order_relaxed);
+
+        PROFILE_COUNT(particles_dropped, evicted);
     }
 
-    void particle_engine::add_particles(app::worker_context &worker_context)
+    template<class T, simulation::storage_layout Layout>
+    std::uint32_t particle_engine::bin_survivors(std::int64_t cull_time)
     {
-        auto &&read_frame = *worker_context.read_frame;
-        auto &&write_frame = *worker_context.write_frame;
+        using on_death = typename T::on_death;
+
+        auto &&read_frame = *step.read_frame;
+        auto &&read_particles = read_frame.particles;
+
+        auto const from_start_time = step.from_start_time.count();
+
+        auto const type = app::effect_types::index_of<T>();
+
+        auto births = 0u;
 
-        auto &&position = read_frame.effect.position;
-        auto &&color = read_frame.effect.color;
+        for (auto idx = read_frame.type_offsets[type]; idx < read_frame.type_offsets[type + 1]; ++idx) {
+            if (auto const position = particle_position<Layout>(read_particles, idx); is_particle_outside(position.x, position.y))
+                continue;
+
+            auto const death_time = particle_death_time<Layout>(read_particles, idx);
+
+            if (death_time >= cull_time) {
+                auto const bin = std::min(static_cast<std::uint64_t>(death_time - cull_time) >> DEATH_BIN_SHIFT, std::uint64_t{DEATH_BINS_COUNT - 1});
+
+                ++death_bins[bin];
+            }
+
+            // As 'classify_particles' draws it.
+            else if constexpr (on_death::kind == simulation::death_kind::explode) {
+                if (death_time >= from_start_time)
+                    continue;
+
+                auto const random = math::philox::generate(math::philox::counter_type{read_particles.id[idx], 0, DEATH_STREAM, 0}, step.random_key);
 
-        auto j = 0u;
+                if (math::philox::to_unit_float(random[0]) < on_death::chance)
+                    births += step.degradation.fan_out(on_death::burst::count);
+            }
+        }
+
+        return births;
+    }
 
-        for (auto i = shared_effect_read_index++; i < read_frame.effect.count; i = shared_effect_read_index++) {
-            j = shared_particle_write_index++;
+    std::uint32_t particle_engine::run_steps(app::worker_context &worker_context)
+    {
+        auto steps_count = 0u;
 
-            if (j >= TOTAL_PARTICLES_COUNT)
+        for (auto now = global_timer.load(); !stop_workers && now - simulated_time.load() >= step_threshold(); now = global_timer.load()) {
+            // Owned elsewhere for now; the time waits for the next run.
+            if (step_in_flight.exchange(true))
                 break;
 
-            auto &&write_particle = write_frame.particles.at(j);
+            begin_step(now);
+
+            // In order, so no block ever waits for its predecessor's output.
+            for (auto block = 0u; block < step.blocks_count; ++block)
+                process_block(worker_context, block);
 
-            write_particle.born_time = worker_context.from_start_time;
+            end_step(std::span{&worker_context, 1});
 
-            write_particle.position = position;
-            write_particle.color = color;
+            if (step.write_frame->grid != nullptr)
+                build_grid(*step.write_frame);
 
-            randomize_velocity_vector(worker_context, write_particle.velocity);
+            publish_step();
 
-            ++job_count;
+            ++steps_count;
         }
+
+        return steps_count;
+    }
+
+    void particle_engine::end_step(std::span<app::worker_context> contexts)
+    {
+        step.write_frame->particles_count = static_cast<std::uint32_t>(block_offsets[step.blocks_count - 1].load());
+
+        next_descendant_id += block_births[step.blocks_count - 1];
+
+        // The first type always has a block, so every type ends at the end of some block.
+        for (auto type = 0u; type < app::effect_types::count; ++type)
+            step.write_frame->type_offsets[type + 1] = static_cast<std::uint32_t>(block_offsets[step.types[type].end - 1].load());
+
+        gather_cascades(contexts);
+    }
+
+    void particle_engine::build_grid(app::frame_data &frame_data)
+    {
+        auto &&grid = *frame_data.grid;
+
+        grid.clear();
+        grid.count(frame_data.particles.x, frame_data.particles.y, 0, frame_data.particles_count);
+        grid.prefix_sum();
+        grid.scatter(0, frame_data.particles_count);
+        grid.sort_cells(0, grid.cells_count());
     }
 
-    void particle_engine::randomize_velocity_vector(app::worker_context &worker_context, glm::vec2 &velocity)
+    void particle_engine::finish_step()
     {
-        auto &&generator = worker_context.generator;
-        auto &&uniform_real_distribution = worker_context.uniform_real_distribution;
+        end_step(worker_contexts);
+
+        if (step.write_frame->grid == nullptr) {
+            publish_step();
+            return;
+        }
 
-        auto angle = uniform_real_distribution(generator) * kPI * 2.f;
-        auto speed = (uniform_real_distribution(generator) * .75f + .25f) * 100.f;
+        step.write_frame->grid->clear();
 
-        velocity = glm::vec2{std::cos(angle), std::sin(angle)} * speed;
+        pool->submit(*grid_count_task, (step.write_frame->particles_count + PARTICLES_CHUNK_SIZE - 1) / PARTICLES_CHUNK_SIZE);
     }
 
-    bool particle_engine::is_particle_outside(app::particle const &particle)
+    void particle_engine::gather_cascades(std::span<app::worker_context> contexts)
     {
-        auto &&position = particle.position;
-        return position.x < 0 || position.x > app::SCREEN_WIDTH || position.y < 0 || position.y > app::SCREEN_HEIGHT;
+        gathered_cascades.clear();
+
+        for (auto &&worker_context : contexts) {
+            gathered_cascades.insert(std::end(gathered_cascades), std::cbegin(worker_context.cascades), std::cend(worker_context.cascades));
+            worker_context.cascades.clear();
+        }
+
+        // Ordering by block alone gives the same order whatever the workers ran.
+        auto by_block = [] (auto &&lhs, auto &&rhs) { return lhs.first < rhs.first; };
+
+        if (!std::is_sorted(std::cbegin(gathered_cascades), std::cend(gathered_cascades), by_block))
+            std::stable_sort(std::begin(gathered_cascades), std::end(gathered_cascades), by_block);
+
+        auto const kept_count = std::min(gathered_cascades.size(), std::size_t{SPAWN_QUEUE_CAPACITY});
+
+        pending_cascades.clear();
+
+        for (auto index = 0u; index < kept_count; ++index)
+            pending_cascades.push_back(gathered_cascades[index].second);
+
+        dropped_cascades.fetch_add(gathered_cascades.size() - kept_count, std::memory_order_relaxed);
     }
+
+    void particle_engine::publish_step()
+    {
+        PROFILE_SCOPE(publish);
+
+        if (budget != nullptr) {
+            auto const cost = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - step_begin_time);
+
+            level_steps[budget->level()].fetch_add(1, std::memory_order_relaxed);
+
+            if (cost > config.step_budget)
+                over_budget_steps.fetch_add(1, std::memory_order_relaxed);
+
+            last_step_cost.store(cost.count(), std::memory_order_relaxed);
+
+            auto const level = budget->update(cost);
+
+            degradation_level_.store(level, std::memory_order_relaxed);
+
+            if (level > max_degradation_level.load(std::memory_order_relaxed))
+                max_degradation_level.store(level, std::memory_order_relaxed);
+        }
+
+        if (recorder != nullptr)
+            recorder->submit(*step.write_frame, published_steps.load() + 1, palette.get());
+
+        frames_exchange.publish();
+
+        // The effects the step spawned are visible from now on.
+        std::int64_t published_time = 0;
+
+        for (auto &&effect : step.effects) {
+            if (effect.cascade || effect.request_time == 0)
+                continue;
+
+            if (published_time == 0)
+                published_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+            spawn_latencies.record(published_time - effect.request_time);
+        }
+
+        published_particles_count = step.write_frame->particles_count;
+
+        ++published_steps;
+
+        step_in_flight = false;
+
+        schedule_step();
+    }
+
+    void particle_engine::process_block(app::worker_context &worker_context, std::uint32_t block)
+    {
+        auto const type = block_type(block);
+
+        visit_kernels(type, [this, &worker_context, type, block] <class T, simulation::storage_layout Layout> ()
+        {
+            if (block < step.types[type].simulate_begin) {
+                PROFILE_SCOPE(spawn_block);
+
+                auto const [count, births] = spawned_count(type, block);
+                auto const [first_output, output_count, first_id] = reserve_block_output(block, count, births);
+
+                add_particles<T, Layout>(block, first_output, output_count, first_id);
+            }
+
+            else {
+                PROFILE_SCOPE(simulate_block);
+
+                auto &&emitted = worker_context.emitted;
+
+                emitted.clear();
+
+                // Reserved first, so the next block waits for the classification only.
+                auto const [count, births] = classify_particles<T, Layout>(worker_context, block, emitted);
+                auto const [first_output, output_count, first_id] = reserve_block_output(block, count, births);
+
+                if (output_count == 0) {
+                    if (count != 0)
+                        drop_cascades(worker_context, block);
+
+                    return;
+                }
+
+                integrate_particles<T, Layout>(worker_context, block);
+
+                emit_particles<T, Layout>(worker_context, block, emitted.data(), static_cast<std::uint32_t>(emitted.size()), first_output, output_count, first_id);
+            }
+        });
+    }
+
+    void particle_engine::process_slice(app::worker_context &worker_context, std::uint32_t slice)
+    {
+        PROFILE_SCOPE(simulate_slice);
+
+        auto const blocks_count = step.blocks_count;
+        auto const slices_count = pool->workers_count();
+
+        auto const first_block = static_cast<std::uint32_t>(std::uint64_t{blocks_count} * slice / slices_count);
+        auto const last_block = static_cast<std::uint32_t>(std::uint64_t{blocks_count} * (slice + 1) / slices_count);
+
+        if (first_block == last_block)
+            return;
+
+        auto &&emitted = worker_context.slice_emitted;
+        auto &&chunks = worker_context.slice_chunks;
+
+        emitted.clear();
+        chunks.clear();
+
+        auto &&births = worker_context.slice_births;
+
+        births.clear();
+
+        for (auto block = first_block; block < last_block; ++block) {
+            auto const type = block_type(block);
+
+            auto const [count, born] = visit_kernels(type, [this, &worker_context, &emitted, type, block] <class T, simulation::storage_layout Layout> ()
+            {
+                if (block < step.types[type].simulate_begin)
+                    return spawned_count(type, block);
+
+                return classify_particles<T, Layout>(worker_context, block, emitted);
+            });
+
+            chunks.emplace_back(static_cast<std::uint32_t>(emitted.size()), count);
+            births.push_back(born);
+        }
+
+        auto const [first_output, first_births] = wait_block_output(first_block);
+
+        auto const tag = std::uint64_t{step.step_tag} << 32;
+
+        auto output_end = first_output;
+        auto births_end = first_births;
+
+        // Only the last grant's end is waited for.
+        for (auto block = first_block; block < last_block; ++block) {
+            auto &&count = chunks[block - first_block].second;
+
+            auto const granted = grant_block_output(block_type(block), output_end, count);
+
+            if (granted == 0 && count != 0 && block >= step.types[block_type(block)].simulate_begin)
+                drop_cascades(worker_context, block);
+
+            count = granted;
+            output_end += count;
+
+            auto const born = births[block - first_block];
+
+            births[block - first_block] = births_end;
+            births_end += born;
+
+            if (block + 1 < last_block) {
+                block_births[block] = births_end;
+                block_offsets[block].store(tag | output_end, std::memory_order_relaxed);
+            }
+        }
+
+        end_block_output(last_block - 1, output_end, births_end);
+
+        for (auto block = first_block, emitted_begin = 0u, j = first_output; block < last_block; ++block) {
+            auto const [emitted_end, count] = chunks[block - first_block];
+            auto const first_id = step.first_descendant_id + births[block - first_block];
+            auto const type = block_type(block);
+
+            visit_kernels(type, [this, &worker_context, &emitted, type, block, j, count, first_id, emitted_begin, emitted_end] <class T, simulation::storage_layout Layout> ()
+            {
+                if (block < step.types[type].simulate_begin) {
+                    add_particles<T, Layout>(block, j, count, first_id);
+                    return;
+                }
+
+                if (count == 0)
+                    return;
+
+                integrate_particles<T, Layout>(worker_context, block);
+
+                emit_particles<T, Layout>(worker_context, block, emitted.data() + emitted_begin, emitted_end - emitted_begin, j, count, first_id);
+            });
+
+            emitted_begin = emitted_end;
+            j += count;
+        }
+    }
+
+    void particle_engine::drop_cascades(app::worker_context &worker_context, std::uint32_t block)
+    {
+        auto const dropped = std::erase_if(worker_context.cascades, [block] (auto &&cascade) { return cascade.first == block; });
+
+        dropped_cascades.fetch_add(dropped, std::memory_order_relaxed);
+    }
+
+    std::uint32_t particle_engine::block_type(std::uint32_t block) const noexcept
+    {
+        auto type = 0u;
+
+        while (block >= step.types[type].end)
+            ++type;
+
+        return type;
+    }
+
+    std::pair<std::uint32_t, std::uint32_t> particle_engine::block_particles(std::uint32_t type, std::uint32_t block) const noexcept
+    {
+        auto &&type_offsets = step.read_frame->type_offsets;
+
+        auto const begin = type_offsets[type] + (block - step.types[type].simulate_begin) * PARTICLES_CHUNK_SIZE;
+
+        return {begin, std::min(PARTICLES_CHUNK_SIZE, type_offsets[type + 1] - begin)};
+    }
+
+    std::pair<std::uint32_t, std::uint32_t> particle_engine::block_effects(std::uint32_t type, std::uint32_t block) const noexcept
+    {
+        auto &&blocks = step.types[type];
+
+        auto const first_effect = std::min(blocks.effects_begin + (block - blocks.spawn_begin) * EFFECTS_PER_SPAWN_BLOCK, blocks.effects_end);
+
+        return {first_effect, std::min(first_effect + EFFECTS_PER_SPAWN_BLOCK, blocks.effects_end)};
+    }
+
+    std::pair<std::uint32_t, std::uint32_t> particle_engine::spawned_count(std::uint32_t type, std::uint32_t block) const noexcept
+    {
+        auto const [first_effect, last_effect] = block_effects(type, block);
+
+        auto output_count = 0u;
+        auto births = 0u;
+
+        for (auto e = first_effect; e < last_effect; ++e) {
+            output_count += step.effects[e].count;
+            births += step.effects[e].cascade ? step.effects[e].count : 0u;
+        }
+
+        return {output_count, births};
+    }
+
+    template<class T, simulation::storage_layout Layout>
+    std::pair<std::uint32_t, std::uint32_t> particle_engine::classify_particles(app::worker_context &worker_context, std::uint32_t block, std::vector<std::uint32_t> &emitted)
+    {
+        using on_death = typename T::on_death;
+
+        auto &&read_frame = *step.read_frame;
+        auto &&read_particles = read_frame.particles;
+
+        auto const from_start_time = step.from_start_time.count();
+
+        // Dying before this goes, before 'from_start_time' explodes.
+        auto const cull_time = std::max(from_start_time + step.degradation.cull_horizon, step.evict_before);
+
+        auto const [begin, count] = block_particles(app::effect_types::index_of<T>(), block);
+
+        auto is_dead = false;
+        auto is_outside = false;
+
+        auto output_count = 0u;
+        auto births = 0u;
+        auto survivors_count = 0u;
+        auto exploded_count = 0u;
+        auto aged_count = 0u;
+
+        for (auto i = 0u; i < count;) {
+            auto const bucket = (begin + i) / simulation::expiry_index::BUCKET_SIZE;
+            auto const bucket_end = std::min(count, (bucket + 1) * simulation::expiry_index::BUCKET_SIZE - begin);
+
+            // Nothing dies here in this step.
+            if (!read_frame.expiry->may_expire(bucket, cull_time)) {
+                for (; i < bucket_end; ++i) {
+                    if (auto const position = particle_position<Layout>(read_particles, begin + i); !is_particle_outside(position.x, position.y)) {
+                        emitted.push_back(i);
+                        ++output_count;
+                        ++survivors_count;
+                    }
+                }
+
+                continue;
+            }
+
+            aged_count += bucket_end - i;
+
+            for (; i < bucket_end; ++i) {
+                auto const idx = begin + i;
+
+                auto const position = particle_position<Layout>(read_particles, idx);
+
+                auto const death_time = particle_death_time<Layout>(read_particles, idx);
+
+                is_dead = death_time < cull_time;
+                is_outside = is_particle_outside(position.x, position.y);
+
+                if (!is_outside & !is_dead) {
+                    emitted.push_back(i);
+                    ++output_count;
+                    ++survivors_count;
+                }
+
+                else if constexpr (on_death::kind != simulation::death_kind::vanish) {
+                    if (is_outside || death_time >= from_start_time)
+                        continue;
+
+                    auto const random = math::philox::generate(math::philox::counter_type{read_particles.id[idx], 0, DEATH_STREAM, 0}, step.random_key);
+
+                    if (math::philox::to_unit_float(random[0]) >= on_death::chance)
+                        continue;
+
+                    if constexpr (on_death::kind == simulation::death_kind::explode) {
+                        auto const burst_count = step.degradation.fan_out(on_death::burst::count);
+
+                        if (burst_count == 0)
+                            continue;
+
+                        emitted.push_back(i | worker_context.EXPLODED_BIT);
+                        output_count += burst_count;
+                        births += burst_count;
+                    }
+
+                    else {
+                        using effect = typename on_death::effect;
+
+                        auto const effect_count = step.degradation.fan_out(effect::emission::count);
+
+                        if (effect_count == 0)
+                            continue;
+
+                        worker_context.cascades.emplace_back(block, app::effect{
+                            effect_count, read_particles.id[idx], position,
+                            simulation::unpack_color(particle_color<Layout>(read_particles, idx)), app::effect_types::index_of<effect>(), true
+                        });
+                    }
+
+                    ++exploded_count;
+                }
+            }
+        }
+
+        PROFILE_COUNT(particles_culled, count - survivors_count);
+        PROFILE_COUNT(particles_exploded, exploded_count);
+        PROFILE_COUNT(particles_aged, aged_count);
+
+        return {output_count, births};
+    }
+
+    template<class T, simulation::storage_layout Layout>
+    std::uint32_t particle_engine::integrate_particles(app::worker_context &worker_context, std::uint32_t block)
+    {
+        using forces = typename T::forces;
+
+        auto &&read_frame = *step.read_frame;
+        auto &&read_particles = read_frame.particles;
+        auto &&scratch = worker_context.scratch;
+
+        auto const [begin, count] = block_particles(app::effect_types::index_of<T>(), block);
+
+        auto const dt = static_cast<float>(std::chrono::duration<double>(step.dt).count());
+        auto const drag = step.drags[app::effect_types::index_of<T>()];
+
+        // Decoded and integrated in place; no grid to push them apart with.
+        if constexpr (Layout == simulation::storage_layout::compact) {
+            for (auto i = 0u; i < count; ++i) {
+                auto const idx = begin + i;
+
+                scratch.x[i] = unpack_position_x(read_particles.packed_x[idx]);
+                scratch.y[i] = unpack_position_y(read_particles.packed_y[idx]);
+                scratch.vx[i] = simulation::unpack_half(read_particles.packed_vx[idx]);
+                scratch.vy[i] = simulation::unpack_half(read_particles.packed_vy[idx]);
+            }
+
+            simulation::integrate(std::as_const(scratch).kinematics(), scratch.kinematics(), count, dt, drag, forces::gravity);
+        }
+
+        // Repulsion into the velocities, then the chunk is integrated in place.
+        else if (auto const radius = config.interaction_radius; radius > 0.f && config.repulsion != 0.f && read_frame.grid != nullptr) {
+            auto const repulsion = config.repulsion;
+
+            auto const freeze = step.degradation.half_rate_old && (step.step_tag & 1) != 0;
+            auto const catch_up = step.frozen_dt.count() != 0;
+
+            auto &&particle_dt = worker_context.particle_dt;
+            auto &&particle_drag = worker_context.particle_drag;
+
+            auto moved = count;
+
+            // Old: less than half the type's mean lifetime left; left standing.
+            if (freeze || catch_up) {
+                auto const old_life_time = static_cast<std::int64_t>(T::life_time::life_time(.5f)) / 2;
+
+                // The end of the step, or of the previous one when catching up.
+                auto const old_since = step.from_start_time.count() - (freeze ? 0 : step.dt.count());
+
+                auto const old_dt = freeze ? 0.f : static_cast<float>(std::chrono::duration<double>(step.dt + step.frozen_dt).count());
+                auto const old_drag = freeze ? 1.f : step.catch_up_drags[app::effect_types::index_of<T>()];
+
+                for (auto i = 0u; i < count; ++i) {
+                    auto const old = read_particles.death_time[begin + i] - old_since < old_life_time;
+
+                    particle_dt[i] = old ? old_dt : dt;
+                    particle_drag[i] = old ? old_drag : drag;
+
+                    moved -= old && freeze ? 1u : 0u;
+                }
+            }
+
+            else {
+                std::fill_n(std::begin(particle_dt), count, dt);
+                std::fill_n(std::begin(particle_drag), count, drag);
+            }
+
+            for (auto i = 0u; i < count; ++i) {
+                auto const idx = begin + i;
+
+                auto ax = 0.f, ay = 0.f;
+
+                // Standing still: no neighbours to look for.
+                if (particle_dt[i] != 0.f) {
+                    read_frame.grid->for_each_neighbour(read_particles.x, read_particles.y, read_particles.x[idx], read_particles.y[idx], radius,
+                                                        [&ax, &ay, radius, repulsion] (std::uint32_t, float dx, float dy, float squared_distance)
+                    {
+                        // Also skips the particle itself.
+                        if (squared_distance == 0.f)
+                            return;
+
+                        auto const distance = std::sqrt(squared_distance);
+                        auto const push = repulsion * (1.f - distance / radius) / distance;
+
+                        ax += dx * push;
+                        ay += dy * push;
+                    });
+                }
+
+                scratch.x[i] = read_particles.x[idx];
+                scratch.y[i] = read_particles.y[idx];
+                scratch.vx[i] = read_particles.vx[idx] + ax * particle_dt[i];
+                scratch.vy[i] = read_particles.vy[idx] + ay * particle_dt[i];
+            }
+
+            simulation::integrate(std::as_const(scratch).kinematics(), scratch.kinematics(), count, particle_dt.data(), particle_drag.data(), forces::gravity);
+
+            PROFILE_COUNT(particles_integrated, moved);
+
+            return moved;
+        }
+
+        else simulation::integrate(read_particles.kinematics(begin), scratch.kinematics(), count, dt, drag, forces::gravity);
+
+        PROFILE_COUNT(particles_integrated, count);
+
+        return count;
+    }
+
+    template<class T, simulation::storage_layout Layout>
+    void particle_engine::emit_particles(app::worker_context &worker_context, std::uint32_t block, std::uint32_t const *emitted, std::uint32_t emitted_count,
+                                         std::uint32_t first_output, std::uint32_t output_count, std::uint32_t first_id)
+    {
+        using on_death = typename T::on_death;
+
+        auto &&read_particles = step.read_frame->particles;
+        auto &&write_particles = step.write_frame->particles;
+        auto &&scratch = worker_context.scratch;
+
+        auto const from_start_time = step.from_start_time.count();
+
+        auto const output_end = first_output + output_count;
+
+        auto const begin = block_particles(app::effect_types::index_of<T>(), block).first;
+
+        auto j = first_output;
+        auto id = first_id;
+
+        for (auto it = emitted; it != emitted + emitted_count && j < output_end; ++it) {
+            auto const i = *it & ~worker_context.EXPLODED_BIT;
+            auto const idx = begin + i;
+
+            if ((*it & worker_context.EXPLODED_BIT) == 0) {
+                if constexpr (Layout == simulation::storage_layout::compact) {
+                    write_particles.packed_x[j] = pack_position_x(scratch.x[i]);
+                    write_particles.packed_y[j] = pack_position_y(scratch.y[i]);
+                    write_particles.packed_vx[j] = simulation::pack_half(scratch.vx[i]);
+                    write_particles.packed_vy[j] = simulation::pack_half(scratch.vy[i]);
+
+                    write_particles.death_tick[j] = read_particles.death_tick[idx];
+                    write_particles.palette_index[j] = read_particles.palette_index[idx];
+                    write_particles.id[j] = read_particles.id[idx];
+                }
+
+                else {
+                    write_particles.x[j] = scratch.x[i];
+                    write_particles.y[j] = scratch.y[i];
+                    write_particles.vx[j] = scratch.vx[i];
+                    write_particles.vy[j] = scratch.vy[i];
+
+                    write_particles.previous_x[j] = read_particles.x[idx];
+                    write_particles.previous_y[j] = read_particles.y[idx];
+
+                    write_particles.death_time[j] = read_particles.death_time[idx];
+                    write_particles.color[j] = read_particles.color[idx];
+                    write_particles.id[j] = read_particles.id[idx];
+
+                    write_particles.vertices[j] = simulation::point_vertex{scratch.x[i], scratch.y[i], read_particles.color[idx]};
+                }
+
+                ++j;
+            }
+
+            else if constexpr (on_death::kind == simulation::death_kind::explode) {
+                auto const position = particle_position<Layout>(read_particles, idx);
+                auto const color = particle_color<Layout>(read_particles, idx);
+
+                for (auto k = 0u, burst_count = step.degradation.fan_out(on_death::burst::count); k < burst_count && j < output_end; ++k, ++j) {
+                    auto vx = 0.f, vy = 0.f, life_time_roll = 0.f;
+
+                    randomize_velocity_vector(EXPLOSION_STREAM, read_particles.id[idx], k, on_death::burst::speed, vx, vy, life_time_roll);
+
+                    write_particles.id[j] = id++ | DESCENDANT_ID_BIT;
+
+                    auto const death_time = from_start_time + static_cast<std::int64_t>(T::life_time::life_time(life_time_roll));
+
+                    if constexpr (Layout == simulation::storage_layout::compact) {
+                        write_particles.packed_x[j] = read_particles.packed_x[idx];
+                        write_particles.packed_y[j] = read_particles.packed_y[idx];
+                        write_particles.packed_vx[j] = simulation::pack_half(vx);
+                        write_particles.packed_vy[j] = simulation::pack_half(vy);
+
+                        write_particles.death_tick[j] = simulation::pack_death_time(death_time);
+                        write_particles.palette_index[j] = read_particles.palette_index[idx];
+                    }
+
+                    else {
+                        write_particles.x[j] = position.x;
+                        write_particles.y[j] = position.y;
+                        write_particles.vx[j] = vx;
+                        write_particles.vy[j] = vy;
+
+                        write_particles.previous_x[j] = position.x;
+                        write_particles.previous_y[j] = position.y;
+
+                        write_particles.death_time[j] = death_time;
+                        write_particles.color[j] = color;
+
+                        write_particles.vertices[j] = simulation::point_vertex{position.x, position.y, color};
+                    }
+                }
+            }
+        }
+        step.write_frame->expiry->insert(first_output, j - first_output, [this, &write_particles, first_output] (std::uint32_t i)
+        {
+            return particle_death_time<Layout>(write_particles, first_output + i);
+        });
+    }
+
+    template<class T, simulation::storage_layout Layout>
+    void particle_engine::add_particles(std::uint32_t block, std::uint32_t first_output, std::uint32_t output_count, std::uint32_t first_id)
+    {
+        auto &&write_particles = step.write_frame->particles;
+
+        auto const from_start_time = step.from_start_time.count();
+
+        auto const output_end = first_output + output_count;
+
+        auto const [first_effect, last_effect] = block_effects(app::effect_types::index_of<T>(), block);
+
+        auto j = first_output;
+        auto id = first_id;
+
+        for (auto e = first_effect; e < last_effect && j < output_end; ++e) {
+            auto &&effect = step.effects[e];
+
+            auto const position = effect.position;
+            auto const color = simulation::pack_color(effect.color);
+
+            auto const stream = effect.cascade ? CASCADE_STREAM : EFFECT_STREAM;
+
+            auto const x = pack_position_x(position.x);
+            auto const y = pack_position_y(position.y);
+
+            auto const palette_slot = static_cast<std::uint16_t>((step.palette_base + e) % PALETTE_SIZE);
+
+            for (auto i = 0u; i < effect.count && j < output_end; ++i, ++j) {
+                auto vx = 0.f, vy = 0.f, life_time_roll = 0.f;
+
+                randomize_velocity_vector(stream, effect.sequence, i, T::emission::speed, vx, vy, life_time_roll);
+
+                write_particles.id[j] = effect.cascade ? id++ | DESCENDANT_ID_BIT : (effect.sequence * EFFECT_ID_STRIDE + i) & ~DESCENDANT_ID_BIT;
+
+                auto const death_time = from_start_time + static_cast<std::int64_t>(T::life_time::life_time(life_time_roll));
+
+                if constexpr (Layout == simulation::storage_layout::compact) {
+                    write_particles.packed_x[j] = x;
+                    write_particles.packed_y[j] = y;
+                    write_particles.packed_vx[j] = simulation::pack_half(vx);
+                    write_particles.packed_vy[j] = simulation::pack_half(vy);
+
+                    write_particles.death_tick[j] = simulation::pack_death_time(death_time);
+                    write_particles.palette_index[j] = palette_slot;
+                }
+
+                else {
+                    write_particles.x[j] = position.x;
+                    write_particles.y[j] = position.y;
+                    write_particles.vx[j] = vx;
+                    write_particles.vy[j] = vy;
+
+                    write_particles.previous_x[j] = position.x;
+                    write_particles.previous_y[j] = position.y;
+
+                    write_particles.death_time[j] = death_time;
+                    write_particles.color[j] = color;
+
+                    write_particles.vertices[j] = simulation::point_vertex{position.x, position.y, color};
+                }
+            }
+        }
+        step.write_frame->expiry->insert(first_output, j - first_output, [this, &write_particles, first_output] (std::uint32_t i)
+        {
+            return particle_death_time<Layout>(write_particles, first_output + i);
+        });
+
+        PROFILE_COUNT(particles_spawned, j - first_output);
+    }
+
+    particle_engine::block_output particle_engine::reserve_block_output(std::uint32_t block, std::uint32_t count, std::uint32_t births)
+    {
+        auto const [offset, births_offset] = wait_block_output(block);
+        auto const granted = grant_block_output(block_type(block), offset, count);
+
+        end_block_output(block, offset + granted, births_offset + births);
+
+        return {offset, granted, step.first_descendant_id + births_offset};
+    }
+
+    std::pair<std::uint32_t, std::uint32_t> particle_engine::wait_block_output(std::uint32_t block)
+    {
+        if (block == 0)
+            return {0, 0};
+
+        auto const tag = std::uint64_t{step.step_tag} << 32;
+
+        auto &&previous = block_offsets[block - 1];
+
+        auto value = previous.load(std::memory_order_acquire);
+
+        // Bounded by the predecessor's processing time.
+        if ((value & ~std::uint64_t{0xFFFFFFFF}) != tag) {
+            PROFILE_SCOPE(block_output_wait);
+
+            auto spins = 0u;
+
+            for (utility::spin_wait spin_wait; (value & ~std::uint64_t{0xFFFFFFFF}) != tag; value = previous.load(std::memory_order_acquire), ++spins)
+                spin_wait();
+
+            PROFILE_COUNT(block_output_spins, spins);
+        }
+
+        return {static_cast<std::uint32_t>(value), block_births[block - 1]};
+    }
+
+    std::uint32_t particle_engine::grant_block_output(std::uint32_t type, std::uint32_t offset, std::uint32_t count)
+    {
+        // Every block before them left room for them.
+        auto const reserved = std::min(std::uint64_t{config.capacity}, std::uint64_t{offset} + step.types[type].later_spawns);
+        auto const granted = static_cast<std::uint32_t>(std::min(std::uint64_t{count}, config.capacity - reserved));
+
+        if (granted != count) {
+            evicted_particles.fetch_add(count - granted, std::memory_order_relaxed);
+
+            PROFILE_COUNT(particles_dropped, count - granted);
+        }
+
+        return granted;
+    }
+
+    void particle_engine::end_block_output(std::uint32_t block, std::uint32_t end, std::uint32_t births)
+    {
+        auto const tag = std::uint64_t{step.step_tag} << 32;
+
+        block_births[block] = births;
+
+        // Only the offset of the last block is ever waited for.
+        block_offsets[block].store(tag | end, std::memory_order_release);
+
+        if (end > step.write_frame->committed_count.load(std::memory_order_acquire))
+            commit_frame(*step.write_frame, end);
+    }
+
+    void particle_engine::commit_frame(app::frame_data &frame_data, std::uint32_t count)
+    {
+        std::lock_guard<std::mutex> lock{commit_mutex};
+
+        auto const committed = frame_data.committed_count.load(std::memory_order_relaxed);
+
+        if (count <= committed)
+            return;
+
+        // Geometric growth: logarithmically many commits.
+        auto const target = std::min(config.capacity, std::max({count, committed * 2, PARTICLES_CHUNK_SIZE}));
+
+        frame_data.particles.for_each_range(committed, target, [this] (void *begin, std::size_t size)
+        {
+            arena->commit(begin, size);
+        });
+
+        frame_data.committed_count.store(target, std::memory_order_release);
+    }
+
+    void particle_engine::randomize_velocity_vector(std::uint32_t stream, std::uint32_t parent_id, std::uint32_t index, float speed_limit,
+                                                    float &vx, float &vy, float &life_time_roll)
+    {
+        auto const random = math::philox::generate(math::philox::counter_type{parent_id, index, stream, 0}, step.random_key);
+
+        auto angle = math::philox::to_unit_float(random[0]) * kPI * 2.f;
+        auto speed = (math::philox::to_unit_float(random[1]) * .75f + .25f) * speed_limit;
+
+        vx = std::cos(angle) * speed;
+        vy = std::sin(angle) * speed;
+
+        life_time_roll = math::philox::to_unit_float(random[3]);
+    }
+
+    bool particle_engine::is_particle_outside(float x, float y)
+    {
+        return x < 0 || x > app::SCREEN_WIDTH || y < 0 || y > app::SCREEN_HEIGHT;
+    }
+
+    // The cull and the integration on their own, for 'benchmarks/micro_bench.cxx'.
+    template std::pair<std::uint32_t, std::uint32_t> particle_engine::classify_particles<app::classic_effect, simulation::storage_layout::full>(app::worker_context &, std::uint32_t, std::vector<std::uint32_t> &);
+    template std::uint32_t particle_engine::integrate_particles<app::classic_effect, simulation::storage_layout::full>(app::worker_context &, std::uint32_t);
 }
\ No newline at end of file
@@ -1,78 +1,308 @@
 #pragma once
 
 #include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <chrono>
+#include <limits>
 #include <memory>
-#include <thread>
 #include <atomic>
+#include <mutex>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
-#include <random>
 #include <array>
 
-#include "main.hxx"
-#include "utility/barrier.hxx"
+#include "math/math.hxx"
+#include "math/philox.hxx"
+#include "jobs/job_system.hxx"
+#include "utility/aligned_allocator.hxx"
+#include "utility/mapped_file.hxx"
+#include "utility/memory_arena.hxx"
+#include "utility/mpsc_queue.hxx"
+#include "utility/triple_buffer.hxx"
+#include "utility/latency_histogram.hxx"
+#include "simulation/expiry_index.hxx"
+#include "simulation/particle_storage.hxx"
+#include "simulation/spatial_grid.hxx"
+#include "screen.hxx"
+#include "effect_types.hxx"
+#include "budget_controller.hxx"
 
 
 namespace app
 {
     auto constexpr EFFECTS_COUNT = 2048u;
-    auto constexpr PER_EFFECT_PARTICLES_COUNT = 64u;
-    auto constexpr TOTAL_PARTICLES_COUNT = EFFECTS_COUNT * PER_EFFECT_PARTICLES_COUNT;
-    auto constexpr DEAD_PARTICLE_EXPLOSION_CHANCE = .25f;
-    
-    struct particle final {
-        std::chrono::milliseconds born_time{0}; // ms
-        std::chrono::milliseconds time_stamp{0}; // ms
+    auto constexpr PER_EFFECT_PARTICLES_COUNT = app::classic_effect::emission::count;
+    auto constexpr DEFAULT_PARTICLES_CAPACITY = EFFECTS_COUNT * PER_EFFECT_PARTICLES_COUNT;
+    auto constexpr DEAD_PARTICLE_EXPLOSION_CHANCE = app::classic_effect::on_death::chance;
 
-        glm::vec2 position{0};
-        glm::vec2 velocity{0};
-        glm::vec4 color{0};
-    };
+    // A multiple of every SIMD width used.
+    auto constexpr PARTICLES_CHUNK_SIZE = 512u;
+
+    // Requests beyond it are dropped.
+    auto constexpr SPAWN_QUEUE_CAPACITY = 4096u;
+
+    // As many effects as make up one particles chunk.
+    auto constexpr EFFECTS_PER_SPAWN_BLOCK = PARTICLES_CHUNK_SIZE / PER_EFFECT_PARTICLES_COUNT;
+    // Every type but the first may start with a partial block.
+    auto constexpr MAX_SPAWN_BLOCKS_COUNT = (SPAWN_QUEUE_CAPACITY + EFFECTS_PER_SPAWN_BLOCK - 1u) / EFFECTS_PER_SPAWN_BLOCK + app::effect_types::count;
 
     struct effect final {
         std::uint32_t count{0};
 
+        // Spawn order, or the parent particle id for a cascade.
+        std::uint32_t sequence{0};
+
         glm::vec2 position{0};
         glm::vec4 color{0};
+
+        // Index in 'app::effect_types'.
+        std::uint32_t type{0};
+
+        // Made by a dying particle rather than requested.
+        bool cascade{false};
+
+        // Steady clock ns; zero if not measured.
+        std::int64_t request_time{0};
     };
 
     struct frame_data final {
-        frame_data() : particles_count{0}
-        {
-            particles.resize(TOTAL_PARTICLES_COUNT);
-        }
+        std::uint32_t particles_count{0};
+
+        // Type 't' takes [type_offsets[t], type_offsets[t + 1]).
+        std::array<std::uint32_t, app::effect_types::count + 1> type_offsets{};
+
+        // ns on the 'update' timeline.
+        std::int64_t end_time{0};
+        std::int64_t duration{0};
+
+        simulation::particle_storage particles;
+
+        // Only ever grows, under 'particle_engine::commit_mutex'.
+        std::atomic_uint32_t committed_count{0};
+
+        // Null without a grid.
+        std::unique_ptr<simulation::spatial_grid> grid;
+
+        std::unique_ptr<simulation::expiry_index> expiry;
+    };
+
+    struct engine_config final {
+        // Zero: one per CPU of 'cpus', or 'default_workers_count()'.
+        std::uint32_t workers_count{0};
+
+        // Worker 'i' runs on 'cpus[i % size]'.
+        std::vector<std::uint32_t> cpus;
+
+        // Workers are pinned per node and each simulates a slice of its own.
+        bool numa_aware{false};
+
+        // Non-zero: emulate this many nodes.
+        std::uint32_t numa_nodes{0};
+
+        // A step over it evicts the particles that die soonest.
+        std::uint32_t capacity{DEFAULT_PARTICLES_CAPACITY};
+
+        utility::page_policy page_policy{utility::page_policy::transparent_huge};
+
+        bool grow_on_demand{true};
+
+        // Non-zero: steps of exactly this much time, interpolated by 'render'.
+        std::chrono::nanoseconds fixed_step{0};
+
+        // Fixed steps only: the time beyond this many steps is dropped.
+        std::uint32_t max_steps_per_update{8};
+
+        // px; non-zero builds a grid per frame.
+        float grid_cell_size{0};
 
-        std::uint32_t particles_count;
+        // px; non-zero pushes closer particles apart.
+        float interaction_radius{0};
+        float repulsion{0};
 
-        std::vector<app::particle> particles;
-        app::effect effect;
+        // 'compact': 16 byte quantized particles, no grid nor snapshots.
+        simulation::storage_layout storage{simulation::storage_layout::full};
+
+        // Non-zero: degrade the steps to keep their cost about this.
+        std::chrono::nanoseconds step_budget{0};
+    };
+
+    // Leads a snapshot file; the 'alignment' padded particle arrays follow.
+    struct snapshot_header final {
+        static std::uint32_t constexpr MAX_EFFECT_TYPES_COUNT{15};
+        static_assert(app::effect_types::count <= MAX_EFFECT_TYPES_COUNT);
+
+        static_assert(std::is_trivially_copyable_v<app::effect>);
+
+        std::array<char, 8> magic{'P', 'E', 'S', 'N', 'A', 'P', '\0', '\0'};
+
+        std::uint32_t version{SNAPSHOT_VERSION};
+
+        // A page, so the arrays map aligned.
+        std::uint32_t alignment{0};
+
+        // Layout check.
+        std::uint32_t particle_size{0};
+
+        std::uint32_t particles_count{0};
+
+        // ns.
+        std::int64_t update_time{0};
+        std::int64_t simulated_time{0};
+        std::int64_t from_start_time{0};
+
+        std::int64_t end_time{0};
+        std::int64_t duration{0};
+
+        std::uint64_t steps{0};
+        std::uint64_t spawn_sequence{0};
+
+        std::uint32_t next_descendant_id{0};
+
+        std::uint32_t effect_types_count{0};
+        std::array<std::uint32_t, MAX_EFFECT_TYPES_COUNT + 1> type_offsets{};
+
+        // Stored after the particles arrays.
+        std::uint32_t cascades_count{0};
+
+        static std::uint32_t constexpr SNAPSHOT_VERSION{5};
+
+        static std::uint32_t constexpr PAGE_ALIGNMENT{4096};
+    };
+
+    struct memory_statistics final {
+        std::size_t reserved_bytes{0};
+        std::size_t committed_bytes{0};
+
+        utility::page_policy page_policy{utility::page_policy::regular};
     };
 }
 
 namespace app
 {
-    struct worker_context final {
+    class frame_recorder;
+    class world_batch;
+
+    // Shared by all the jobs of one step.
+    struct step_context final {
         app::frame_data const *read_frame{nullptr};
         app::frame_data *write_frame{nullptr};
 
-        std::chrono::milliseconds elapsed_time{0};
-        std::chrono::milliseconds from_start_time{0};
+        std::uint32_t read_frame_index{0};
+        std::uint32_t write_frame_index{1};
+
+        std::chrono::nanoseconds from_start_time{0};
+        std::chrono::nanoseconds dt{0};
+
+        // With the particle id as the counter.
+        math::philox::key_type random_key{0, 0};
+
+        // Tags the blocks output offsets, so they need no reset between steps.
+        std::uint32_t step_tag{0};
+        std::uint32_t blocks_count{0};
+
+        // The others follow in output order.
+        std::uint32_t first_descendant_id{0};
+
+        // Per type: its spawn blocks, then its simulate blocks.
+        struct type_blocks final {
+            std::uint32_t spawn_begin{0};
+            std::uint32_t simulate_begin{0};
+            std::uint32_t end{0};
+
+            // Of 'effects'.
+            std::uint32_t effects_begin{0};
+            std::uint32_t effects_end{0};
+
+            // Particles the spawn blocks of the later types make.
+            std::uint32_t later_spawns{0};
+        };
 
+        std::array<type_blocks, app::effect_types::count> types;
+
+        // Grouped by type: the previous step's cascades, then the requests.
+        std::vector<app::effect> effects;
+
+        // 'compact' only: the palette slot of the first of 'effects'.
+        std::uint32_t palette_base{0};
+
+        app::degradation degradation;
+
+        // ns; the read frame particles dying before this are evicted.
+        std::int64_t evict_before{std::numeric_limits<std::int64_t>::min()};
+
+        // Non-zero: the previous step's dt, left to catch up on.
+        std::chrono::nanoseconds frozen_dt{0};
+
+        // Per effect type, over 'dt' and over 'dt + frozen_dt'.
+        std::array<float, app::effect_types::count> drags{};
+        std::array<float, app::effect_types::count> catch_up_drags{};
+    };
+
+    struct spawn_statistics final {
+        std::uint64_t ingested{0};
+
+        // Rejected because the spawn queue was full.
+        std::uint64_t dropped{0};
+
+        std::uint32_t max_per_step{0};
+
+        std::uint64_t cascades{0};
+        std::uint64_t dropped_cascades{0};
+
+        // Left out whole because the spawns alone overflowed the capacity.
+        std::uint64_t overflow_effects{0};
+
+        // Carried over particles evicted to make room.
+        std::uint64_t evicted{0};
+    };
+
+    struct budget_statistics final {
+        std::uint32_t level{0};
+        std::uint32_t max_level{0};
+
+        std::array<std::uint64_t, app::budget_controller::MAX_LEVEL + 1> level_steps{};
+        std::uint64_t over_budget_steps{0};
+
+        // ns.
+        std::int64_t last_cost{0};
+    };
+
+    // Scratch memory of one pool worker.
+    struct alignas(64) worker_context final {
         std::uint32_t worker_index;
 
-        std::random_device random_device;
-        std::mt19937 generator;
+        utility::aligned_vector<std::byte> scratch_memory;
 
-        std::bernoulli_distribution bernoulli_distribution;
-        std::uniform_real_distribution<float> uniform_real_distribution;
+        // Integrated state of the chunk, before the cull.
+        simulation::particle_storage scratch;
 
-        std::uint64_t dt{0};
+        // Chunk particle indices, or'ed with 'EXPLODED_BIT' for an explosion.
+        std::vector<std::uint32_t> emitted;
 
-        worker_context(std::uint32_t worker_index) : worker_index{worker_index}
-        {
-            generator = std::mt19937{random_device()};
+        // 'numa_aware' only: the slice emissions, chunk by chunk.
+        std::vector<std::uint32_t> slice_emitted;
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> slice_chunks;
+        std::vector<std::uint32_t> slice_births;
+
+        // Each after the block it comes from.
+        std::vector<std::pair<std::uint32_t, app::effect>> cascades;
 
-            bernoulli_distribution = std::bernoulli_distribution{DEAD_PARTICLE_EXPLOSION_CHANCE};
-            uniform_real_distribution = std::uniform_real_distribution<float>{0.f, 1.f};
+        // With repulsion: per particle dt and drag.
+        std::vector<float> particle_dt;
+        std::vector<float> particle_drag;
+
+        static std::uint32_t constexpr EXPLODED_BIT{1u << 31};
+
+        worker_context(std::uint32_t worker_index)
+            : worker_index{worker_index}, scratch_memory(simulation::particle_storage::required_size(PARTICLES_CHUNK_SIZE)),
+              scratch{scratch_memory.data(), PARTICLES_CHUNK_SIZE}, particle_dt(PARTICLES_CHUNK_SIZE), particle_drag(PARTICLES_CHUNK_SIZE)
+        {
+            emitted.reserve(PARTICLES_CHUNK_SIZE);
+            slice_emitted.reserve(PARTICLES_CHUNK_SIZE);
         }
     };
 }
@@ -82,64 +312,472 @@ namespace app
     class particle_engine final {
     public:
 
-        particle_engine();
+        // Throws std::system_error if the memory can not be reserved.
+        explicit particle_engine(app::engine_config const &config = {});
 
         ~particle_engine();
 
-        void render();
+        // Calls 'draw_point(x, y, r, g, b, a)' per particle; never waits for the simulation.
+        template<class F>
+        void render(F &&draw_point);
+
+        // Calls 'draw_points(vertices, count)' once; same thread as 'render'.
+        template<class F>
+        void render_vertices(F &&draw_points);
+
+        // Calls 'f(id, x, y)' per particle; same thread as 'render'.
+        template<class F>
+        void for_each_particle(F &&f);
+
+        // Thread-safe.
+        void update(std::chrono::nanoseconds dt);
+
+        bool settled() const noexcept;
 
-        void update(std::int64_t dt);
+        std::chrono::nanoseconds dropped_time() const noexcept { return std::chrono::nanoseconds{dropped_time_.load()}; }
 
-        void spawn_effect(glm::vec2 &&position, glm::vec4 &&color);
+        // Thread-safe and lock-free; returns false if the request was dropped.
+        bool spawn_effect(glm::vec2 &&position, glm::vec4 &&color, std::uint32_t type = 0, std::chrono::steady_clock::time_point request_time = {});
+
+        spawn_statistics spawn_stats() const noexcept;
+
+        utility::latency_summary spawn_latency_stats() const noexcept { return spawn_latencies.summary(); }
+
+        std::uint32_t degradation_level() const noexcept { return degradation_level_.load(std::memory_order_relaxed); }
+
+        budget_statistics budget_stats() const noexcept;
+
+        // Waits for the step in flight; throws std::runtime_error on failure.
+        void save_snapshot(std::string const &path);
+
+        // Maps the snapshot and steps from it in place; before the first 'update' only.
+        void load_snapshot(std::string const &path);
+
+        // Null stops recording; the recorder has to outlive the recording.
+        void record(app::frame_recorder *recorder);
+
+        // Needs a grid; same thread as 'render'.
+        template<class F>
+        void query(glm::vec2 const &point, float radius, F &&f);
+
+        std::uint64_t steps() const noexcept { return published_steps.load(); }
+
+        std::uint32_t particles_count() const noexcept { return published_particles_count.load(); }
+
+        std::uint32_t workers_count() const noexcept { return pool->workers_count(); }
+
+        // One unless 'engine_config::numa_aware'.
+        std::uint32_t nodes_count() const noexcept { return nodes_count_; }
+
+        std::uint32_t capacity() const noexcept { return config.capacity; }
+
+        // Set in the ids of the particles born to dying ones.
+        static std::uint32_t constexpr DESCENDANT_ID_BIT{1u << 31};
+
+        static simulation::point_vertex compact_vertex(simulation::particle_storage const &particles, std::uint32_t index, std::uint32_t const *palette) noexcept
+        {
+            return {unpack_position_x(particles.packed_x[index]), unpack_position_y(particles.packed_y[index]), palette[particles.palette_index[index]]};
+        }
+
+        memory_statistics memory_stats() const noexcept;
+
+        jobs::job_system &job_system() noexcept { return *pool; }
+
+        static std::uint32_t default_workers_count() noexcept;
 
     private:
 
-        static std::chrono::milliseconds constexpr UPDATE_PERIOD{5};
-        static std::chrono::milliseconds constexpr PARTICLE_LIFE_TIME{2'000};
+        // Drives the step stages one at a time: 'benchmarks/micro_bench.cxx'.
+        friend class micro_bench_access;
+
+        friend class app::world_batch;
 
-        static auto constexpr FRAMES_COUNT{4u};
+        // A world of a 'world_batch', in its arena and on its pool.
+        particle_engine(app::engine_config const &config, jobs::job_system *batch_pool, utility::memory_arena *batch_arena, std::size_t arena_offset);
 
-        static auto constexpr C_DRAG{.999f};
-        static auto constexpr G_ACCEL{9.81f};
+        static auto constexpr FRAMES_COUNT{utility::triple_buffer::SLOTS_COUNT};
 
+        static std::uint32_t constexpr RANDOM_SEED{0x5EED'0001};
+
+        // Requested effect particles are 'sequence * EFFECT_ID_STRIDE + index'.
+        static std::uint32_t constexpr EFFECT_ID_STRIDE{std::bit_ceil(app::effect_types::max_emission_count)};
+
+        // 'compact' only: a color slot per effect, reused in turn.
+        static std::uint32_t constexpr PALETTE_SIZE{1u << 16};
+
+        // px around the screen 'compact' positions cover.
+        static auto constexpr COMPACT_POSITION_MARGIN{256.f};
+
+        // 'fit_particles' bins death times by 2^DEATH_BIN_SHIFT ns.
+        static std::uint32_t constexpr DEATH_BIN_SHIFT{20};
+        static std::uint32_t constexpr DEATH_BINS_COUNT{4096};
+
+        // The third word of the Philox counter.
+        static std::uint32_t constexpr DEATH_STREAM{0};
+        static std::uint32_t constexpr EXPLOSION_STREAM{1};
+        static std::uint32_t constexpr EFFECT_STREAM{2};
+        static std::uint32_t constexpr CASCADE_STREAM{3};
+
+        // ns.
         std::atomic_int64_t global_timer{0};
 
+        // ns.
+        std::atomic_int64_t simulated_time{0};
+
+        std::atomic_int64_t dropped_time_{0};
+
         std::atomic_bool stop_workers;
 
-        std::array<std::atomic_flag, FRAMES_COUNT> acquired_indices;
+        // Owned by whoever starts a step, until the step is published.
+        std::atomic_bool step_in_flight{false};
+
+        app::engine_config config;
+
+        // Each frame takes an equal slice, each array starts on a page of its own.
+        std::unique_ptr<utility::memory_arena> own_arena;
+        utility::memory_arena *arena{nullptr};
+        std::size_t arena_offset{0};
+
+        std::array<app::frame_data, FRAMES_COUNT> frames_data;
+
+        // Read in place by the 'snapshot_frame_index' frame until a step writes it.
+        std::unique_ptr<utility::mapped_file> snapshot;
+        std::uint32_t snapshot_frame_index{0};
+
+        std::mutex commit_mutex;
+
+        // Steps write the 'back' frame, 'render' reads the 'front' one.
+        utility::triple_buffer frames_exchange;
+
+        std::atomic_uint32_t published_particles_count{0};
+
+        // Drained by the step that begins next.
+        utility::mpsc_queue<app::effect> spawn_queue{SPAWN_QUEUE_CAPACITY};
+
+        std::atomic_uint64_t ingested_effects{0};
+        std::atomic_uint64_t dropped_effects{0};
+        std::atomic_uint32_t max_effects_per_step{0};
+
+        std::atomic_uint64_t ingested_cascades{0};
+        std::atomic_uint64_t dropped_cascades{0};
+
+        std::atomic_uint64_t overflow_effects{0};
+        std::atomic_uint64_t evicted_particles{0};
+
+        // Under the step ownership.
+        utility::latency_histogram spawn_latencies;
+
+        // For the next step, in block order.
+        std::vector<app::effect> pending_cascades;
+
+        std::vector<std::pair<std::uint32_t, app::effect>> gathered_cascades;
+
+        // 'DEATH_BINS_COUNT' of them.
+        std::vector<std::uint32_t> death_bins;
+
+        // 'compact' only, 'PALETTE_SIZE' packed colors.
+        std::unique_ptr<std::uint32_t[]> palette;
+
+        std::uint32_t palette_cursor{0};
+
+        // 'compact' only: 'render_vertices' decodes into these.
+        std::vector<simulation::point_vertex> decoded_vertices;
+
+        // Under the step ownership.
+        std::unique_ptr<app::budget_controller> budget;
+        std::chrono::steady_clock::time_point step_begin_time;
+
+        std::atomic_uint32_t degradation_level_{0};
+        std::atomic_uint32_t max_degradation_level{0};
+        std::array<std::atomic_uint64_t, app::budget_controller::MAX_LEVEL + 1> level_steps{};
+        std::atomic_uint64_t over_budget_steps{0};
+        std::atomic_int64_t last_step_cost{0};
+
+        // Non-zero after a snapshot load.
+        std::uint64_t spawn_sequence_base{0};
+
+        // 'step_tag << 32 | offset': the inclusive end of each block output.
+        std::unique_ptr<std::atomic_uint64_t[]> block_offsets;
+
+        // Births up to each block, written before the block's offset.
+        std::unique_ptr<std::uint32_t[]> block_births;
+
+        std::uint32_t next_descendant_id{0};
+
+        std::atomic_uint64_t published_steps{0};
+
+        // Under the step ownership.
+        app::frame_recorder *recorder{nullptr};
+
+        app::step_context step;
+
+        std::vector<app::worker_context> worker_contexts;
+
+        // Simulate -> publish.
+        std::unique_ptr<jobs::task> simulate_task;
+
+        // 'numa_aware': one slice of blocks per worker.
+        std::unique_ptr<jobs::task> simulate_slices_task;
+
+        std::uint32_t nodes_count_{1};
+
+        // With a grid: count -> (prefix sum) -> scatter -> sort cells -> publish.
+        std::unique_ptr<jobs::task> grid_count_task;
+        std::unique_ptr<jobs::task> grid_scatter_task;
+        std::unique_ptr<jobs::task> grid_sort_task;
+
+        static auto constexpr GRID_CELLS_PER_JOB{1024u};
+
+        // The engine's own, or its batch's.
+        std::unique_ptr<jobs::job_system> own_pool;
+        jobs::job_system *pool{nullptr};
+
+        bool batched{false};
+
+        // If there is unsimulated time and none is in flight.
+        void schedule_step();
+
+        void begin_step(std::int64_t now);
+
+        // Batched worlds: runs the steps the world has time for; returns how many.
+        std::uint32_t run_steps(app::worker_context &worker_context);
+
+        static std::size_t frames_size(app::engine_config const &config, std::size_t alignment) noexcept;
+
+        simulation::particle_storage frame_storage(std::uint32_t frame_index) const noexcept;
+
+        // Least accumulated time worth a step.
+        std::int64_t step_threshold() const noexcept { return config.fixed_step.count() != 0 ? config.fixed_step.count() : 1; }
+
+        // In [0, 1]; always 1 without fixed steps.
+        float interpolation_factor(app::frame_data const &frame_data) const noexcept;
+
+        void publish_step();
+
+        void finish_step();
+
+        void end_step(std::span<app::worker_context> contexts);
+
+        void gather_cascades(std::span<app::worker_context> contexts);
+
+        // All at once, on the calling thread.
+        static void build_grid(app::frame_data &frame_data);
+
+        void process_block(app::worker_context &worker_context, std::uint32_t block);
+
+        // Two passes: classify the slice, then integrate it without waiting.
+        void process_slice(app::worker_context &worker_context, std::uint32_t slice);
+
+        // Evicts the cascades of a block whose output had no room.
+        void drop_cascades(app::worker_context &worker_context, std::uint32_t block);
+
+        std::uint32_t block_type(std::uint32_t block) const noexcept;
+
+        // First one and count.
+        std::pair<std::uint32_t, std::uint32_t> block_particles(std::uint32_t type, std::uint32_t block) const noexcept;
+
+        // First one and end.
+        std::pair<std::uint32_t, std::uint32_t> block_effects(std::uint32_t type, std::uint32_t block) const noexcept;
+
+        // And how many of them cascades make.
+        std::pair<std::uint32_t, std::uint32_t> spawned_count(std::uint32_t type, std::uint32_t block) const noexcept;
+
+        void set_drags() noexcept;
 
-        std::vector<app::frame_data> frames_data;
+        // The effects that do not fit in the capacity at all.
+        void fit_spawns(std::uint32_t cascades_count);
 
-        std::vector<std::thread> workers;
+        // Sets 'step.evict_before' so the step output fits in the capacity.
+        void fit_particles(std::uint32_t spawns);
 
-        std::atomic_uint32_t shared_frame_read_index{0};
-        std::atomic_uint32_t shared_frame_write_index{1};
+        // Returns how many particles the dying ones give birth to.
+        template<class T, simulation::storage_layout Layout>
+        std::uint32_t bin_survivors(std::int64_t cull_time);
 
-        std::atomic_uint32_t shared_effect_read_index{0};
+        // Returns the particles count 'block' makes and how many of them explode.
+        template<class T, simulation::storage_layout Layout>
+        std::pair<std::uint32_t, std::uint32_t> classify_particles(app::worker_context &worker_context, std::uint32_t block, std::vector<std::uint32_t> &emitted);
 
-        std::atomic_uint32_t shared_particle_read_index{0};
-        std::atomic_uint32_t shared_particle_write_index{0};
+        // Returns how many particles it moved.
+        template<class T, simulation::storage_layout Layout>
+        std::uint32_t integrate_particles(app::worker_context &worker_context, std::uint32_t block);
 
-        std::atomic_uint32_t idle_workers{0};
+        template<class T, simulation::storage_layout Layout>
+        void emit_particles(app::worker_context &worker_context, std::uint32_t block, std::uint32_t const *emitted, std::uint32_t emitted_count,
+                            std::uint32_t first_output, std::uint32_t output_count, std::uint32_t first_id);
 
-        std::atomic_uint32_t job_count{0};
+        template<class T, simulation::storage_layout Layout>
+        void add_particles(std::uint32_t block, std::uint32_t first_output, std::uint32_t output_count, std::uint32_t first_id);
 
-        std::unique_ptr<utility::barrier> barrier;
+        struct block_output final {
+            std::uint32_t first{0};
+            std::uint32_t count{0};
+            std::uint32_t first_id{0};
+        };
 
-        void worker_object(std::uint32_t worker_index);
+        block_output reserve_block_output(std::uint32_t block, std::uint32_t count, std::uint32_t births);
 
-        void update_worker_time_points(app::worker_context &worker_context);
+        // Waits for the blocks before 'block' to reserve their output.
+        std::pair<std::uint32_t, std::uint32_t> wait_block_output(std::uint32_t block);
 
-        void process_particles(app::worker_context &worker_context);
+        // The ones of the block's 'count' there is room for; the others are evicted.
+        std::uint32_t grant_block_output(std::uint32_t type, std::uint32_t offset, std::uint32_t count);
 
-        void add_particles(app::worker_context &worker_context);
+        void end_block_output(std::uint32_t block, std::uint32_t end, std::uint32_t births);
 
-        std::uint32_t acquire_available_frame_index();
-        std::uint32_t acquire_frame_index(std::uint32_t index);
-        std::uint32_t release_frame_index(std::uint32_t index);
+        void commit_frame(app::frame_data &frame, std::uint32_t count);
 
-        void randomize_velocity_vector(app::worker_context &worker_context, glm::vec2 &velocity);
+        // Returns the velocity and the lifetime roll.
+        void randomize_velocity_vector(std::uint32_t stream, std::uint32_t parent_id, std::uint32_t index, float speed_limit, float &vx, float &vy,
+                                       float &life_time_roll);
 
-        static bool is_particle_outside(app::particle const &particle);
+        // Calls 'f.template operator()<T, Layout>()' for 'type'.
+        template<class F>
+        decltype(auto) visit_kernels(std::uint32_t type, F &&f) const
+        {
+            return app::effect_types::visit(type, [this, &f] <class T> () -> decltype(auto)
+            {
+                if (config.storage == simulation::storage_layout::compact)
+                    return f.template operator()<T, simulation::storage_layout::compact>();
+
+                return f.template operator()<T, simulation::storage_layout::full>();
+            });
+        }
+
+        template<simulation::storage_layout Layout>
+        glm::vec2 particle_position(simulation::particle_storage const &particles, std::uint32_t index) const noexcept
+        {
+            if constexpr (Layout == simulation::storage_layout::compact)
+                return {unpack_position_x(particles.packed_x[index]), unpack_position_y(particles.packed_y[index])};
+
+            else return {particles.x[index], particles.y[index]};
+        }
+
+        template<simulation::storage_layout Layout>
+        std::int64_t particle_death_time(simulation::particle_storage const &particles, std::uint32_t index) const noexcept
+        {
+            if constexpr (Layout == simulation::storage_layout::compact)
+                return simulation::unpack_death_time(particles.death_tick[index], step.from_start_time.count());
+
+            else return particles.death_time[index];
+        }
+
+        template<simulation::storage_layout Layout>
+        std::uint32_t particle_color(simulation::particle_storage const &particles, std::uint32_t index) const noexcept
+        {
+            if constexpr (Layout == simulation::storage_layout::compact)
+                return palette[particles.palette_index[index]];
+
+            else return particles.color[index];
+        }
+
+        static std::uint16_t pack_position_x(float x) noexcept
+        {
+            return simulation::pack_fixed(x, -COMPACT_POSITION_MARGIN, static_cast<float>(app::SCREEN_WIDTH) + COMPACT_POSITION_MARGIN);
+        }
+
+        static std::uint16_t pack_position_y(float y) noexcept
+        {
+            return simulation::pack_fixed(y, -COMPACT_POSITION_MARGIN, static_cast<float>(app::SCREEN_HEIGHT) + COMPACT_POSITION_MARGIN);
+        }
+
+        static float unpack_position_x(std::uint16_t x) noexcept
+        {
+            return simulation::unpack_fixed(x, -COMPACT_POSITION_MARGIN, static_cast<float>(app::SCREEN_WIDTH) + COMPACT_POSITION_MARGIN);
+        }
+
+        static float unpack_position_y(std::uint16_t y) noexcept
+        {
+            return simulation::unpack_fixed(y, -COMPACT_POSITION_MARGIN, static_cast<float>(app::SCREEN_HEIGHT) + COMPACT_POSITION_MARGIN);
+        }
+
+        static bool is_particle_outside(float x, float y);
     };
-}
\ No newline at end of file
+}
+
+namespace app
+{
+    template<class F>
+    void particle_engine::render(F &&draw_point)
+    {
+        auto &&frame_data = frames_data.at(frames_exchange.acquire());
+        auto &&particles = frame_data.particles;
+
+        // Nothing to interpolate from.
+        if (particles.layout() == simulation::storage_layout::compact) {
+            for (auto i = 0u; i < frame_data.particles_count; ++i) {
+                auto const vertex = compact_vertex(particles, i, palette.get());
+                auto color = simulation::unpack_color(vertex.color);
+
+                draw_point(vertex.x, vertex.y, color.r, color.g, color.b, color.a);
+            }
+
+            return;
+        }
+
+        auto const alpha = interpolation_factor(frame_data);
+
+        for (auto i = 0u; i < frame_data.particles_count; ++i) {
+            auto color = simulation::unpack_color(particles.color[i]);
+
+            auto x = particles.x[i];
+            auto y = particles.y[i];
+
+            if (alpha < 1.f) {
+                x = particles.previous_x[i] + (x - particles.previous_x[i]) * alpha;
+                y = particles.previous_y[i] + (y - particles.previous_y[i]) * alpha;
+            }
+
+            draw_point(x, y, color.r, color.g, color.b, color.a);
+        }
+    }
+
+    template<class F>
+    void particle_engine::render_vertices(F &&draw_points)
+    {
+        auto &&frame_data = frames_data.at(frames_exchange.acquire());
+        auto &&particles = frame_data.particles;
+
+        if (particles.layout() == simulation::storage_layout::compact) {
+            for (auto i = 0u; i < frame_data.particles_count; ++i)
+                decoded_vertices[i] = compact_vertex(particles, i, palette.get());
+
+            draw_points(static_cast<simulation::point_vertex const *>(decoded_vertices.data()), frame_data.particles_count);
+
+            return;
+        }
+
+        draw_points(static_cast<simulation::point_vertex const *>(particles.vertices), frame_data.particles_count);
+    }
+
+    template<class F>
+    void particle_engine::for_each_particle(F &&f)
+    {
+        auto &&frame_data = frames_data.at(frames_exchange.acquire());
+        auto &&particles = frame_data.particles;
+
+        auto const compact = particles.layout() == simulation::storage_layout::compact;
+
+        for (auto i = 0u; i < frame_data.particles_count; ++i) {
+            if (compact)
+                f(particles.id[i], unpack_position_x(particles.packed_x[i]), unpack_position_y(particles.packed_y[i]));
+
+            else f(particles.id[i], particles.vertices[i].x, particles.vertices[i].y);
+        }
+    }
+
+    template<class F>
+    void particle_engine::query(glm::vec2 const &point, float radius, F &&f)
+    {
+        auto &&frame_data = frames_data.at(frames_exchange.acquire());
+        auto &&particles = frame_data.particles;
+
+        if (frame_data.grid == nullptr)
+            return;
+
+        frame_data.grid->for_each_neighbour(particles.x, particles.y, point.x, point.y, radius, [&] (std::uint32_t index, float, float, float)
+        {
+            f(particles.id[index], particles.x[index], particles.y[index]);
+        });
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+
+#include "utility/mpsc_queue.hxx"
+
+
+namespace platform
+{
+    enum class input_kind : std::uint8_t {
+        move = 0,
+        button_down,
+        button_up
+    };
+
+    struct input_event final {
+        // 'input_ring::now()'.
+        std::int64_t time{0};
+
+        float x{0.f}, y{0.f};
+
+        // Bit 0 is the left button.
+        std::uint32_t buttons{0};
+
+        input_kind kind{input_kind::move};
+    };
+
+    // Timestamped input events, drained once per frame; lock-free, drops when full.
+    class input_ring final {
+    public:
+
+        static std::size_t constexpr DEFAULT_CAPACITY{4096};
+
+        explicit input_ring(std::size_t capacity = DEFAULT_CAPACITY) : events{capacity} { }
+
+        // Any thread. Returns false if the event was dropped.
+        bool push(platform::input_event const &event) noexcept
+        {
+            if (events.try_push(event))
+                return true;
+
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+
+            return false;
+        }
+
+        // Consumer only; at most a ring full per call. Returns how many.
+        template<class F>
+        std::size_t drain(F &&f)
+        {
+            std::size_t count = 0;
+
+            for (platform::input_event event; count < events.capacity() && events.try_pop(event); ++count)
+                f(event);
+
+            return count;
+        }
+
+        std::size_t capacity() const noexcept { return events.capacity(); }
+
+        std::uint64_t dropped() const noexcept { return dropped_.load(std::memory_order_relaxed); }
+
+        // Steady clock ns.
+        static std::int64_t now() noexcept
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+    private:
+
+        utility::mpsc_queue<platform::input_event> events;
+
+        std::atomic_uint64_t dropped_{0};
+    };
+}
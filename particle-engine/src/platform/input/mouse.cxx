@@ -42,8 +42,12 @@ namespace platform
         std::visit(overloaded{
             [this] (platform::mouse_data::relative_coords &coords)
             {
-                if (coords.x != 0.f || coords.y != 0.f)
+                if (coords.x != 0.f || coords.y != 0.f) {
                     on_move_(coords.x, coords.y);
+
+                    if (ring_ != nullptr)
+                        ring_->push(platform::input_event{platform::input_ring::now(), coords.x, coords.y, 0, platform::input_kind::move});
+                }
             },
             [this] (platform::mouse_data::wheel wheel)
             {
@@ -61,11 +65,22 @@ namespace platform
                         buttons_[i / 2] = pressed | depressed;
                     }
 
-                    if ((buttons.value & kPRESSED_MASK).any())
+                    auto const time = platform::input_ring::now();
+                    auto const bits = static_cast<std::uint32_t>(buttons_.to_ulong());
+
+                    if ((buttons.value & kPRESSED_MASK).any()) {
                         on_down_(buttons_);
 
-                    if ((buttons.value & kDEPRESSED_MASK).any())
+                        if (ring_ != nullptr)
+                            ring_->push(platform::input_event{time, 0.f, 0.f, bits, platform::input_kind::button_down});
+                    }
+
+                    if ((buttons.value & kDEPRESSED_MASK).any()) {
                         on_up_(buttons_);
+
+                        if (ring_ != nullptr)
+                            ring_->push(platform::input_event{time, 0.f, 0.f, bits, platform::input_kind::button_up});
+                    }
                 }
             },
             [] (auto &&) { }
@@ -5,6 +5,7 @@
 #include <boost/signals2.hpp>
 
 #include "input_data.hxx"
+#include "input_ring.hxx"
 
 
 namespace platform
@@ -27,12 +28,17 @@ namespace platform
 
         void connect_handler(std::shared_ptr<handler_interface> slot);
 
+        // Also to 'ring', if not null; it has to outlive the connection.
+        void connect_ring(platform::input_ring *ring) noexcept { ring_ = ring; }
+
         void update(platform::mouse_data::raw &data);
 
     private:
 
         handler_interface::buttons_t buttons_{0};
 
+        platform::input_ring *ring_{nullptr};
+
         boost::signals2::signal<void(float, float)> on_move_;
         boost::signals2::signal<void(float, float)> on_wheel_;
         boost::signals2::signal<void(handler_interface::buttons_t)> on_down_;
@@ -0,0 +1,8 @@
+#pragma once
+
+
+namespace app
+{
+	auto constexpr SCREEN_WIDTH = 1024u;
+	auto constexpr SCREEN_HEIGHT = 768u;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+
+namespace simulation
+{
+    // 'velocity = velocity * drag - (0, Gravity * dt)'; 'Drag' is per 'drag_step'.
+    template<float Drag, float Gravity>
+    struct drag_and_gravity final {
+        static auto constexpr drag = Drag;
+        static auto constexpr gravity = Gravity;
+
+        // s
+        static auto constexpr drag_step = .005f;
+
+        // s.
+        static float drag_over(float dt) noexcept { return std::pow(Drag, dt / drag_step); }
+    };
+
+    // 'Milliseconds' scaled by a uniform draw, between '1 - Jitter' and one.
+    template<std::uint32_t Milliseconds, float Jitter>
+    struct jittered_life_time final {
+        static_assert(Jitter >= 0.f && Jitter <= 1.f);
+
+        // ns.
+        static float life_time(float roll) noexcept
+        {
+            return static_cast<float>(std::chrono::nanoseconds{std::chrono::milliseconds{Milliseconds}}.count()) * (roll * Jitter + (1.f - Jitter));
+        }
+    };
+
+    // 'Count' particles at a quarter of 'Speed' up to 'Speed' px/s.
+    template<std::uint32_t Count, float Speed>
+    struct burst final {
+        static_assert(Count != 0);
+
+        static auto constexpr count = Count;
+        static auto constexpr speed = Speed;
+    };
+
+    enum class death_kind : std::uint8_t {
+        vanish = 0, explode, cascade
+    };
+
+    // What becomes of a particle past its lifetime: nothing.
+    struct vanish final {
+        static auto constexpr kind = death_kind::vanish;
+    };
+
+    // A dead particle on screen explodes into 'Burst' with 'Chance'.
+    template<float Chance, class Burst>
+    struct explode final {
+        static auto constexpr kind = death_kind::explode;
+
+        static auto constexpr chance = Chance;
+
+        using burst = Burst;
+    };
+
+    // A dead particle on screen turns into an 'Effect' with 'Chance', next step.
+    template<float Chance, class Effect>
+    struct cascade final {
+        static auto constexpr kind = death_kind::cascade;
+
+        static auto constexpr chance = Chance;
+
+        using effect = Effect;
+    };
+
+    // Instantiates a kernel of its own, so nothing costs a branch per particle.
+    template<class Forces, class LifeTime, class OnDeath, class Emission>
+    struct effect_type {
+        using forces = Forces;
+        using life_time = LifeTime;
+        using on_death = OnDeath;
+        using emission = Emission;
+    };
+
+    // Each known by its index in 'Ts'.
+    template<class... Ts>
+    struct effect_registry final {
+        static_assert(sizeof...(Ts) != 0);
+
+        static auto constexpr count = static_cast<std::uint32_t>(sizeof...(Ts));
+
+        static auto constexpr max_emission_count = std::max({Ts::emission::count...});
+
+        template<std::uint32_t I>
+        using type = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+        template<class T>
+        static std::uint32_t constexpr index_of() noexcept
+        {
+            static_assert((std::is_same_v<T, Ts> || ...), "not a registered effect type");
+
+            auto index = 0u;
+
+            static_cast<void>(((std::is_same_v<T, Ts> ? false : (++index, true)) && ...));
+
+            return index;
+        }
+
+        static std::array<char const *, count> constexpr names{Ts::name...};
+
+        // Calls 'f.template operator()<T>()' for 'index'.
+        template<class F>
+        static decltype(auto) visit(std::uint32_t index, F &&f)
+        {
+            using function_type = std::remove_reference_t<F>;
+            using result_type = decltype(f.template operator()<type<0>>());
+
+            static std::array<result_type (*)(function_type &), count> constexpr table{
+                +[] (function_type &f) -> result_type { return f.template operator()<Ts>(); }...
+            };
+
+            return table[index](f);
+        }
+    };
+}
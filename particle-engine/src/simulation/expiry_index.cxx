@@ -0,0 +1,23 @@
+#include <algorithm>
+
+#include "expiry_index.hxx"
+
+
+namespace simulation
+{
+    expiry_index::expiry_index(std::size_t capacity) : buckets{std::make_unique<std::atomic_uint64_t[]>((capacity + BUCKET_SIZE - 1) / BUCKET_SIZE)} { }
+
+    void expiry_index::lower(std::uint32_t bucket, std::int64_t time) noexcept
+    {
+        auto const tag = std::uint64_t{generation_} << 32;
+
+        // A time of zero is never taken for past anything.
+        auto const ticks = static_cast<std::uint64_t>(std::clamp(time >> TIME_SHIFT, std::int64_t{0}, std::int64_t{0xFFFF'FFFF}));
+
+        // The ranges on either side may share the bucket.
+        for (auto value = buckets[bucket].load(std::memory_order_relaxed); (value & ~std::uint64_t{0xFFFF'FFFF}) != tag || (value & 0xFFFF'FFFF) > ticks;) {
+            if (buckets[bucket].compare_exchange_weak(value, tag | ticks, std::memory_order_relaxed))
+                break;
+        }
+    }
+}
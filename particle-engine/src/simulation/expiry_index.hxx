@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+
+
+namespace simulation
+{
+    // Earliest death time per 'BUCKET_SIZE' particles, so the cull skips the buckets where nothing dies.
+    class expiry_index final {
+    public:
+
+        static std::uint32_t constexpr BUCKET_SIZE{64};
+
+        explicit expiry_index(std::size_t capacity);
+
+        // O(1): 'generation' has to differ from the previous one.
+        void reset(std::uint32_t generation) noexcept { generation_ = generation; }
+
+        // Concurrent calls take disjoint ranges.
+        void insert(std::uint32_t first, std::int64_t const *death_times, std::uint32_t count) noexcept
+        {
+            insert(first, count, [death_times] (std::uint32_t i) { return death_times[i]; });
+        }
+
+        template<class F>
+        void insert(std::uint32_t first, std::uint32_t count, F &&death_time) noexcept
+        {
+            for (auto i = 0u; i < count;) {
+                auto const bucket = (first + i) / BUCKET_SIZE;
+                auto const bucket_end = std::min(count, (bucket + 1) * BUCKET_SIZE - first);
+
+                auto earliest = std::numeric_limits<std::int64_t>::max();
+
+                for (; i < bucket_end; ++i)
+                    earliest = std::min(earliest, death_time(i));
+
+                lower(bucket, earliest);
+            }
+        }
+
+        // ns; true for a bucket nothing was inserted into.
+        bool may_expire(std::uint32_t bucket, std::int64_t time) const noexcept
+        {
+            auto const value = buckets[bucket].load(std::memory_order_relaxed);
+
+            return static_cast<std::uint32_t>(value >> 32) != generation_ || (static_cast<std::int64_t>(value & 0xFFFF'FFFF) << TIME_SHIFT) <= time;
+        }
+
+    private:
+
+        // In units of 2^20 ns, rounded down.
+        static auto constexpr TIME_SHIFT{20};
+
+        std::uint32_t generation_{0};
+
+        void lower(std::uint32_t bucket, std::int64_t time) noexcept;
+
+        std::unique_ptr<std::atomic_uint64_t[]> buckets;
+    };
+}
@@ -0,0 +1,138 @@
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define SIMULATION_SSE2
+    #include <emmintrin.h>
+#endif
+
+#include "integrate.hxx"
+
+
+namespace
+{
+    inline void integrate_scalar(simulation::const_kinematics_view source, simulation::kinematics_view target,
+                                 std::size_t begin, std::size_t end, float dt, float drag, float gravity) noexcept
+    {
+        auto const dv = gravity * dt;
+
+        for (auto i = begin; i < end; ++i) {
+            auto const vx = source.vx[i];
+            auto const vy = source.vy[i];
+
+            target.x[i] = source.x[i] + vx * dt;
+            target.y[i] = source.y[i] + vy * dt;
+
+            target.vx[i] = vx * drag;
+            target.vy[i] = vy * drag - dv;
+        }
+    }
+
+    inline void integrate_scalar(simulation::const_kinematics_view source, simulation::kinematics_view target,
+                                 std::size_t begin, std::size_t end, float const *dt, float const *drag, float gravity) noexcept
+    {
+        for (auto i = begin; i < end; ++i) {
+            auto const vx = source.vx[i];
+            auto const vy = source.vy[i];
+
+            target.x[i] = source.x[i] + vx * dt[i];
+            target.y[i] = source.y[i] + vy * dt[i];
+
+            target.vx[i] = vx * drag[i];
+            target.vy[i] = vy * drag[i] - gravity * dt[i];
+        }
+    }
+}
+
+namespace simulation
+{
+    void integrate(const_kinematics_view source, kinematics_view target, std::size_t count, float dt, float drag, float gravity) noexcept
+    {
+        std::size_t i = 0;
+
+#if defined(__AVX2__)
+        auto const dt_lanes = _mm256_set1_ps(dt);
+        auto const drag_lanes = _mm256_set1_ps(drag);
+        auto const dv_lanes = _mm256_set1_ps(gravity * dt);
+
+        for (; i + 8 <= count; i += 8) {
+            auto const vx = _mm256_loadu_ps(source.vx + i);
+            auto const vy = _mm256_loadu_ps(source.vy + i);
+
+            _mm256_storeu_ps(target.x + i, _mm256_add_ps(_mm256_loadu_ps(source.x + i), _mm256_mul_ps(vx, dt_lanes)));
+            _mm256_storeu_ps(target.y + i, _mm256_add_ps(_mm256_loadu_ps(source.y + i), _mm256_mul_ps(vy, dt_lanes)));
+
+            _mm256_storeu_ps(target.vx + i, _mm256_mul_ps(vx, drag_lanes));
+            _mm256_storeu_ps(target.vy + i, _mm256_sub_ps(_mm256_mul_ps(vy, drag_lanes), dv_lanes));
+        }
+#elif defined(SIMULATION_SSE2)
+        auto const dt_lanes = _mm_set1_ps(dt);
+        auto const drag_lanes = _mm_set1_ps(drag);
+        auto const dv_lanes = _mm_set1_ps(gravity * dt);
+
+        for (; i + 4 <= count; i += 4) {
+            auto const vx = _mm_loadu_ps(source.vx + i);
+            auto const vy = _mm_loadu_ps(source.vy + i);
+
+            _mm_storeu_ps(target.x + i, _mm_add_ps(_mm_loadu_ps(source.x + i), _mm_mul_ps(vx, dt_lanes)));
+            _mm_storeu_ps(target.y + i, _mm_add_ps(_mm_loadu_ps(source.y + i), _mm_mul_ps(vy, dt_lanes)));
+
+            _mm_storeu_ps(target.vx + i, _mm_mul_ps(vx, drag_lanes));
+            _mm_storeu_ps(target.vy + i, _mm_sub_ps(_mm_mul_ps(vy, drag_lanes), dv_lanes));
+        }
+#endif
+
+        integrate_scalar(source, target, i, count, dt, drag, gravity);
+    }
+
+    void integrate(const_kinematics_view source, kinematics_view target, std::size_t count, float const *dt, float const *drag, float gravity) noexcept
+    {
+        std::size_t i = 0;
+
+#if defined(__AVX2__)
+        auto const gravity_lanes = _mm256_set1_ps(gravity);
+
+        for (; i + 8 <= count; i += 8) {
+            auto const vx = _mm256_loadu_ps(source.vx + i);
+            auto const vy = _mm256_loadu_ps(source.vy + i);
+
+            auto const dt_lanes = _mm256_loadu_ps(dt + i);
+            auto const drag_lanes = _mm256_loadu_ps(drag + i);
+
+            _mm256_storeu_ps(target.x + i, _mm256_add_ps(_mm256_loadu_ps(source.x + i), _mm256_mul_ps(vx, dt_lanes)));
+            _mm256_storeu_ps(target.y + i, _mm256_add_ps(_mm256_loadu_ps(source.y + i), _mm256_mul_ps(vy, dt_lanes)));
+
+            _mm256_storeu_ps(target.vx + i, _mm256_mul_ps(vx, drag_lanes));
+            _mm256_storeu_ps(target.vy + i, _mm256_sub_ps(_mm256_mul_ps(vy, drag_lanes), _mm256_mul_ps(gravity_lanes, dt_lanes)));
+        }
+#elif defined(SIMULATION_SSE2)
+        auto const gravity_lanes = _mm_set1_ps(gravity);
+
+        for (; i + 4 <= count; i += 4) {
+            auto const vx = _mm_loadu_ps(source.vx + i);
+            auto const vy = _mm_loadu_ps(source.vy + i);
+
+            auto const dt_lanes = _mm_loadu_ps(dt + i);
+            auto const drag_lanes = _mm_loadu_ps(drag + i);
+
+            _mm_storeu_ps(target.x + i, _mm_add_ps(_mm_loadu_ps(source.x + i), _mm_mul_ps(vx, dt_lanes)));
+            _mm_storeu_ps(target.y + i, _mm_add_ps(_mm_loadu_ps(source.y + i), _mm_mul_ps(vy, dt_lanes)));
+
+            _mm_storeu_ps(target.vx + i, _mm_mul_ps(vx, drag_lanes));
+            _mm_storeu_ps(target.vy + i, _mm_sub_ps(_mm_mul_ps(vy, drag_lanes), _mm_mul_ps(gravity_lanes, dt_lanes)));
+        }
+#endif
+
+        integrate_scalar(source, target, i, count, dt, drag, gravity);
+    }
+
+    char const *integration_isa() noexcept
+    {
+#if defined(__AVX2__)
+        return "avx2";
+#elif defined(SIMULATION_SSE2)
+        return "sse2";
+#else
+        return "scalar";
+#endif
+    }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+
+#include "particle_storage.hxx"
+
+
+namespace simulation
+{
+    // Explicit Euler; 'source' and 'target' may alias exactly but not partially.
+    void integrate(const_kinematics_view source, kinematics_view target, std::size_t count, float dt, float drag, float gravity) noexcept;
+
+    // Particle 'i' by 'dt[i]' with 'drag[i]'.
+    void integrate(const_kinematics_view source, kinematics_view target, std::size_t count, float const *dt, float const *drag, float gravity) noexcept;
+
+    // "avx2", "sse2" or "scalar".
+    char const *integration_isa() noexcept;
+}
@@ -0,0 +1,276 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+#include "math/math.hxx"
+
+
+namespace simulation
+{
+    struct kinematics_view final {
+        float *x{nullptr};
+        float *y{nullptr};
+        float *vx{nullptr};
+        float *vy{nullptr};
+    };
+
+    // 12 bytes, interleaved for the renderer.
+    struct point_vertex final {
+        float x;
+        float y;
+
+        std::uint32_t color; // RGBA8, red in the lowest byte
+    };
+
+    static_assert(sizeof(point_vertex) == 12);
+
+    struct const_kinematics_view final {
+        float const *x{nullptr};
+        float const *y{nullptr};
+        float const *vx{nullptr};
+        float const *vy{nullptr};
+    };
+
+    // Full precision, or 'compact', quantized to 16 bytes.
+    enum class storage_layout : std::uint8_t {
+        full = 0, compact
+    };
+
+    // Structure of arrays, cache line aligned, in a caller provided block.
+    struct particle_storage final {
+        float *x{nullptr};
+        float *y{nullptr};
+        float *vx{nullptr};
+        float *vy{nullptr};
+
+        // The other end of the render interpolation.
+        float *previous_x{nullptr};
+        float *previous_y{nullptr};
+
+        // ns.
+        std::int64_t *death_time{nullptr};
+
+        std::uint32_t *color{nullptr}; // RGBA8, red in the lowest byte
+
+        // Keys the particle's random streams.
+        std::uint32_t *id{nullptr};
+
+        // 'full' only: packed for drawing.
+        point_vertex *vertices{nullptr};
+
+        // 'compact' only: fixed point positions, half velocities, ticks and a palette index.
+        std::uint16_t *packed_x{nullptr};
+        std::uint16_t *packed_y{nullptr};
+        std::uint16_t *packed_vx{nullptr};
+        std::uint16_t *packed_vy{nullptr};
+        std::uint16_t *death_tick{nullptr};
+        std::uint16_t *palette_index{nullptr};
+
+        particle_storage() = default;
+
+        // 'memory' is 'alignment' aligned, a power of two of at least 64.
+        particle_storage(void *memory, std::size_t capacity, std::size_t alignment = 64, storage_layout layout = storage_layout::full) noexcept
+            : capacity_{capacity}, layout_{layout}
+        {
+            auto next = static_cast<std::byte *>(memory);
+
+            auto place = [&next, capacity, alignment] (std::size_t element_size)
+            {
+                return static_cast<void *>(std::exchange(next, next + array_size(capacity, element_size, alignment)));
+            };
+
+            if (layout == storage_layout::compact) {
+                packed_x = static_cast<std::uint16_t *>(place(sizeof(std::uint16_t)));
+                packed_y = static_cast<std::uint16_t *>(place(sizeof(std::uint16_t)));
+                packed_vx = static_cast<std::uint16_t *>(place(sizeof(std::uint16_t)));
+                packed_vy = static_cast<std::uint16_t *>(place(sizeof(std::uint16_t)));
+                death_tick = static_cast<std::uint16_t *>(place(sizeof(std::uint16_t)));
+                palette_index = static_cast<std::uint16_t *>(place(sizeof(std::uint16_t)));
+            }
+
+            else {
+                x = static_cast<float *>(place(sizeof(float)));
+                y = static_cast<float *>(place(sizeof(float)));
+                vx = static_cast<float *>(place(sizeof(float)));
+                vy = static_cast<float *>(place(sizeof(float)));
+
+                previous_x = static_cast<float *>(place(sizeof(float)));
+                previous_y = static_cast<float *>(place(sizeof(float)));
+
+                death_time = static_cast<std::int64_t *>(place(sizeof(std::int64_t)));
+
+                color = static_cast<std::uint32_t *>(place(sizeof(std::uint32_t)));
+            }
+
+            id = static_cast<std::uint32_t *>(place(sizeof(std::uint32_t)));
+
+            if (layout == storage_layout::full)
+                vertices = static_cast<point_vertex *>(place(sizeof(point_vertex)));
+        }
+
+        static std::size_t constexpr PARTICLE_SIZE{6 * sizeof(float) + sizeof(std::int64_t) + 2 * sizeof(std::uint32_t) + sizeof(point_vertex)};
+
+        static std::size_t constexpr COMPACT_PARTICLE_SIZE{6 * sizeof(std::uint16_t) + sizeof(std::uint32_t)};
+
+        static_assert(COMPACT_PARTICLE_SIZE == 16);
+
+        static std::size_t constexpr required_size(std::size_t capacity, std::size_t alignment = 64, storage_layout layout = storage_layout::full) noexcept
+        {
+            if (layout == storage_layout::compact) {
+                return 6 * array_size(capacity, sizeof(std::uint16_t), alignment) + array_size(capacity, sizeof(std::uint32_t), alignment);
+            }
+
+            return 6 * array_size(capacity, sizeof(float), alignment) + array_size(capacity, sizeof(std::int64_t), alignment)
+                 + 2 * array_size(capacity, sizeof(std::uint32_t), alignment) + array_size(capacity, sizeof(point_vertex), alignment);
+        }
+
+        std::size_t capacity() const noexcept { return capacity_; }
+
+        storage_layout layout() const noexcept { return layout_; }
+
+        template<class F>
+        void for_each_range(std::size_t first, std::size_t last, F &&f) const
+        {
+            auto range = [first, last, &f] (auto *array)
+            {
+                if (array != nullptr)
+                    f(static_cast<void *>(array + first), (last - first) * sizeof(*array));
+            };
+
+            range(x);
+            range(y);
+            range(vx);
+            range(vy);
+
+            range(previous_x);
+            range(previous_y);
+
+            range(death_time);
+
+            range(color);
+
+            range(packed_x);
+            range(packed_y);
+            range(packed_vx);
+            range(packed_vy);
+            range(death_tick);
+            range(palette_index);
+
+            range(id);
+
+            range(vertices);
+        }
+
+        kinematics_view kinematics(std::size_t offset = 0) noexcept
+        {
+            return {x + offset, y + offset, vx + offset, vy + offset};
+        }
+
+        const_kinematics_view kinematics(std::size_t offset = 0) const noexcept
+        {
+            return {x + offset, y + offset, vx + offset, vy + offset};
+        }
+
+    private:
+
+        std::size_t capacity_{0};
+
+        storage_layout layout_{storage_layout::full};
+
+        static std::size_t constexpr array_size(std::size_t capacity, std::size_t element_size, std::size_t alignment) noexcept
+        {
+            return (capacity * element_size + alignment - 1) / alignment * alignment;
+        }
+    };
+
+    inline std::uint32_t pack_color(glm::vec4 const &color) noexcept
+    {
+        auto to_unorm8 = [] (float value)
+        {
+            return static_cast<std::uint32_t>(glm::clamp(value, 0.f, 1.f) * 255.f + .5f);
+        };
+
+        return to_unorm8(color.r) | (to_unorm8(color.g) << 8) | (to_unorm8(color.b) << 16) | (to_unorm8(color.a) << 24);
+    }
+
+    inline glm::vec4 unpack_color(std::uint32_t color) noexcept
+    {
+        auto constexpr scale = 1.f / 255.f;
+
+        return glm::vec4{
+            static_cast<float>(color & 0xFF) * scale,
+            static_cast<float>((color >> 8) & 0xFF) * scale,
+            static_cast<float>((color >> 16) & 0xFF) * scale,
+            static_cast<float>((color >> 24) & 0xFF) * scale
+        };
+    }
+
+    // Rounded to the nearest step and clamped to the ends.
+    inline std::uint16_t pack_fixed(float value, float min, float max) noexcept
+    {
+        return static_cast<std::uint16_t>(std::clamp((value - min) * (65535.f / (max - min)) + .5f, 0.f, 65535.f));
+    }
+
+    inline float unpack_fixed(std::uint16_t bits, float min, float max) noexcept
+    {
+        return min + static_cast<float>(bits) * ((max - min) / 65535.f);
+    }
+
+    // Rounded to the nearest even; beyond its range becomes infinity.
+    inline std::uint16_t pack_half(float value) noexcept
+    {
+        auto const bits = std::bit_cast<std::uint32_t>(value);
+        auto const sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000);
+
+        auto magnitude = bits & 0x7FFF'FFFF;
+
+        // 65536 and beyond, infinities and NaNs.
+        if (magnitude >= 0x4780'0000)
+            return sign | (magnitude > 0x7F80'0000 ? 0x7E00 : 0x7C00);
+
+        // Below the smallest normal half.
+        if (magnitude < 0x3880'0000)
+            return sign | static_cast<std::uint16_t>(std::bit_cast<std::uint32_t>(std::bit_cast<float>(magnitude) + .5f) - 0x3F00'0000);
+
+        // A carry into the exponent is right too.
+        magnitude += 0xC800'0FFF + ((magnitude >> 13) & 1);
+
+        return sign | static_cast<std::uint16_t>(magnitude >> 13);
+    }
+
+    inline float unpack_half(std::uint16_t half) noexcept
+    {
+        auto bits = std::uint32_t{half & 0x7FFFu} << 13;
+        auto const exponent = bits & 0x0F80'0000;
+
+        bits += 0x3800'0000;
+
+        // Infinities and NaNs.
+        if (exponent == 0x0F80'0000)
+            bits += 0x3800'0000;
+
+        // Zeros and subnormals, renormalized.
+        else if (exponent == 0)
+            bits = std::bit_cast<std::uint32_t>(std::bit_cast<float>(bits + 0x0080'0000) - 0x1p-14f);
+
+        return std::bit_cast<float>(bits | (std::uint32_t{half & 0x8000u} << 16));
+    }
+
+    // 16-bit ticks of 2^20 ns, wrapping every 68 s.
+    inline std::uint16_t pack_death_time(std::int64_t time) noexcept
+    {
+        return static_cast<std::uint16_t>((time + (std::int64_t{1} << 19)) >> 20);
+    }
+
+    // ns.
+    inline std::int64_t unpack_death_time(std::uint16_t tick, std::int64_t now) noexcept
+    {
+        auto const now_tick = now >> 20;
+
+        return (now_tick + static_cast<std::int16_t>(static_cast<std::uint16_t>(tick - static_cast<std::uint16_t>(now_tick)))) * (std::int64_t{1} << 20);
+    }
+}
@@ -0,0 +1,62 @@
+#include <cmath>
+
+#include "spatial_grid.hxx"
+
+
+namespace simulation
+{
+    spatial_grid::spatial_grid(float width, float height, float cell_size, std::size_t capacity)
+        : columns{std::max(static_cast<std::uint32_t>(std::ceil(width / cell_size)), 1u)},
+          rows{std::max(static_cast<std::uint32_t>(std::ceil(height / cell_size)), 1u)},
+          inverse_cell_size{1.f / cell_size},
+          cursors{std::make_unique<std::atomic_uint32_t[]>(std::size_t{columns} * rows)},
+          cell_begin(std::size_t{columns} * rows + 1, 0), cell_of_particle(capacity), indices(capacity) { }
+
+    void spatial_grid::clear() noexcept
+    {
+        for (auto cell = 0u; cell < cells_count(); ++cell)
+            cursors[cell].store(0, std::memory_order_relaxed);
+    }
+
+    void spatial_grid::count(float const *x, float const *y, std::uint32_t begin, std::uint32_t end) noexcept
+    {
+        for (auto i = begin; i < end; ++i) {
+            auto const cell = cell_of(x[i], y[i]);
+
+            cell_of_particle[i] = cell;
+            cursors[cell].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void spatial_grid::prefix_sum() noexcept
+    {
+        auto sum = 0u;
+
+        for (auto cell = 0u; cell < cells_count(); ++cell) {
+            auto const count = cursors[cell].load(std::memory_order_relaxed);
+
+            cell_begin[cell] = sum;
+            cursors[cell].store(sum, std::memory_order_relaxed);
+
+            sum += count;
+        }
+
+        cell_begin[cells_count()] = sum;
+    }
+
+    void spatial_grid::scatter(std::uint32_t begin, std::uint32_t end) noexcept
+    {
+        for (auto i = begin; i < end; ++i)
+            indices[cursors[cell_of_particle[i]].fetch_add(1, std::memory_order_relaxed)] = i;
+    }
+
+    void spatial_grid::sort_cells(std::uint32_t first_cell, std::uint32_t last_cell) noexcept
+    {
+        for (auto cell = first_cell; cell < last_cell; ++cell) {
+            auto const first = std::next(std::begin(indices), cell_begin[cell]);
+            auto const last = std::next(std::begin(indices), cell_begin[cell + 1]);
+
+            std::sort(first, last);
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+
+namespace simulation
+{
+    // Counting sort grid: 'clear' -> 'count' -> 'prefix_sum' -> 'scatter' -> 'sort_cells'.
+    class spatial_grid final {
+    public:
+
+        spatial_grid(float width, float height, float cell_size, std::size_t capacity);
+
+        std::uint32_t columns_count() const noexcept { return columns; }
+        std::uint32_t rows_count() const noexcept { return rows; }
+
+        std::uint32_t cells_count() const noexcept { return columns * rows; }
+
+        float cell_size() const noexcept { return 1.f / inverse_cell_size; }
+
+        std::uint32_t cell_of(float x, float y) const noexcept { return row_of(y) * columns + column_of(x); }
+
+        void clear() noexcept;
+
+        // Bins the particles '[begin, end)'.
+        void count(float const *x, float const *y, std::uint32_t begin, std::uint32_t end) noexcept;
+
+        void prefix_sum() noexcept;
+
+        void scatter(std::uint32_t begin, std::uint32_t end) noexcept;
+
+        // Makes the cell order the particles order.
+        void sort_cells(std::uint32_t first_cell, std::uint32_t last_cell) noexcept;
+
+        // '(dx, dy)' points from the particle to '(x, y)'.
+        template<class F>
+        void for_each_neighbour(float const *xs, float const *ys, float x, float y, float radius, F &&f) const
+        {
+            auto const first_column = column_of(x - radius), last_column = column_of(x + radius);
+            auto const first_row = row_of(y - radius), last_row = row_of(y + radius);
+
+            auto const squared_radius = radius * radius;
+
+            for (auto row = first_row; row <= last_row; ++row) {
+                auto const row_cell = row * columns;
+
+                // A row of cells is one run of 'indices'.
+                for (auto i = cell_begin[row_cell + first_column]; i < cell_begin[row_cell + last_column + 1]; ++i) {
+                    auto const index = indices[i];
+
+                    auto const dx = x - xs[index];
+                    auto const dy = y - ys[index];
+                    auto const squared_distance = dx * dx + dy * dy;
+
+                    if (squared_distance <= squared_radius)
+                        f(index, dx, dy, squared_distance);
+                }
+            }
+        }
+
+    private:
+
+        std::uint32_t columns;
+        std::uint32_t rows;
+
+        float inverse_cell_size;
+
+        // Then the scatter cursors.
+        std::unique_ptr<std::atomic_uint32_t[]> cursors;
+
+        // Plus the end of the last cell.
+        std::vector<std::uint32_t> cell_begin;
+
+        std::vector<std::uint32_t> cell_of_particle;
+        std::vector<std::uint32_t> indices;
+
+        std::uint32_t column_of(float x) const noexcept
+        {
+            return static_cast<std::uint32_t>(std::clamp(x * inverse_cell_size, 0.f, static_cast<float>(columns - 1)));
+        }
+
+        std::uint32_t row_of(float y) const noexcept
+        {
+            return static_cast<std::uint32_t>(std::clamp(y * inverse_cell_size, 0.f, static_cast<float>(rows - 1)));
+        }
+    };
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+
+namespace utility
+{
+    // Also covers the widest SIMD register.
+    template<class T, std::size_t Alignment = 64>
+    struct aligned_allocator {
+        static_assert(Alignment >= alignof(T) && (Alignment & (Alignment - 1)) == 0);
+
+        using value_type = T;
+
+        template<class U>
+        struct rebind {
+            using other = aligned_allocator<U, Alignment>;
+        };
+
+        aligned_allocator() noexcept = default;
+
+        template<class U>
+        aligned_allocator(aligned_allocator<U, Alignment> const &) noexcept { }
+
+        [[nodiscard]] T *allocate(std::size_t n)
+        {
+            return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t{Alignment}));
+        }
+
+        void deallocate(T *pointer, std::size_t) noexcept
+        {
+            ::operator delete(pointer, std::align_val_t{Alignment});
+        }
+
+        template<class U>
+        bool operator== (aligned_allocator<U, Alignment> const &) const noexcept { return true; }
+
+        template<class U>
+        bool operator!= (aligned_allocator<U, Alignment> const &) const noexcept { return false; }
+    };
+
+    template<class T>
+    using aligned_vector = std::vector<T, aligned_allocator<T>>;
+}
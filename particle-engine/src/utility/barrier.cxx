@@ -1,13 +1,86 @@
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
 #include "barrier.hxx"
+#include "profiler.hxx"
+#include "spin_wait.hxx"
+
 
+namespace
+{
+    std::int64_t now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    auto constexpr NO_ARRIVAL = std::numeric_limits<std::int64_t>::max();
+}
 
 namespace utility
 {
+    char const *to_string(barrier_kind kind) noexcept
+    {
+        switch (kind) {
+            case barrier_kind::blocking:    return "blocking";
+            case barrier_kind::hybrid:      return "hybrid";
+
+            default:                        return "unknown";
+        }
+    }
+
+    barrier::barrier(std::size_t count, barrier_kind kind)
+        : kind_{kind}, count{count}, threshold{count}, generation{0}, drop_it{false}, remaining{count},
+          participants{std::make_unique<participant_statistics[]>(count)}
+    {
+        first_arrivals[0] = NO_ARRIVAL;
+        first_arrivals[1] = NO_ARRIVAL;
+
+        if (count <= std::max(std::thread::hardware_concurrency(), 1u))
+            spin_limit = SPIN_LIMIT;
+    }
+
     void barrier::wait()
+    {
+        PROFILE_SCOPE(barrier_wait);
+
+        if (kind_ == barrier_kind::hybrid)
+            wait_hybrid(-1);
+
+        else wait_blocking(-1);
+    }
+
+    void barrier::wait(std::size_t participant)
+    {
+        PROFILE_SCOPE(barrier_wait);
+
+        auto const arrival = now();
+        auto const first_arrival = kind_ == barrier_kind::hybrid ? wait_hybrid(arrival) : wait_blocking(arrival);
+
+        auto const wait_time = now() - arrival;
+        auto const skew = std::max(arrival - first_arrival, std::int64_t{0});
+
+        auto &&statistics = participants[participant].statistics;
+
+        ++statistics.waits_count;
+
+        statistics.total_wait += wait_time;
+        statistics.max_wait = std::max(statistics.max_wait, wait_time);
+
+        statistics.total_skew += skew;
+        statistics.max_skew = std::max(statistics.max_skew, skew);
+    }
+
+    std::int64_t barrier::wait_blocking(std::int64_t arrival)
     {
         std::unique_lock<std::mutex> lock{mutex};
         auto lgen = generation;
 
+        if (count == threshold)
+            first_arrivals[0].store(arrival, std::memory_order_relaxed);
+
+        auto const first_arrival = first_arrivals[0].load(std::memory_order_relaxed);
+
         if (--count == 0) {
             ++generation;
             count = threshold;
@@ -15,6 +88,53 @@ namespace utility
         }
 
         else cv.wait(lock, [this, lgen] { return lgen != generation || drop_it; });
+
+        return first_arrival;
+    }
+
+    std::int64_t barrier::wait_hybrid(std::int64_t arrival)
+    {
+        auto const current = state.load(std::memory_order_acquire);
+
+        if ((current & DROPPED_BIT) != 0)
+            return arrival;
+
+        auto &&first_arrival = first_arrivals[current & 1];
+
+        // So the last arrival releases with the earliest time in.
+        if (arrival >= 0) {
+            for (auto first = first_arrival.load(std::memory_order_relaxed); arrival < first;) {
+                if (first_arrival.compare_exchange_weak(first, arrival, std::memory_order_relaxed))
+                    break;
+            }
+        }
+
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            auto const first = first_arrival.load(std::memory_order_relaxed);
+
+            // Nobody of the next generation arrives before the release below.
+            first_arrivals[(current + 1) & 1].store(NO_ARRIVAL, std::memory_order_relaxed);
+            remaining.store(threshold, std::memory_order_relaxed);
+
+            // Fails only if dropped meanwhile, which releases as well.
+            auto expected = current;
+            state.compare_exchange_strong(expected, (current + 1) & ~DROPPED_BIT, std::memory_order_release, std::memory_order_relaxed);
+            state.notify_all();
+
+            return first;
+        }
+
+        for (auto spins = 0u; spins < spin_limit; ++spins) {
+            if (state.load(std::memory_order_acquire) != current)
+                return first_arrival.load(std::memory_order_relaxed);
+
+            cpu_relax();
+        }
+
+        for (auto value = state.load(std::memory_order_acquire); value == current; value = state.load(std::memory_order_acquire))
+            state.wait(current, std::memory_order_acquire);
+
+        return first_arrival.load(std::memory_order_relaxed);
     }
 
     void barrier::drop()
@@ -22,5 +142,18 @@ namespace utility
         std::lock_guard<std::mutex> lock{mutex};
         drop_it = true;
         cv.notify_all();
+
+        state.fetch_or(DROPPED_BIT, std::memory_order_release);
+        state.notify_all();
+    }
+
+    std::vector<barrier_statistics> barrier::statistics() const
+    {
+        std::vector<barrier_statistics> statistics;
+
+        for (auto participant = 0u; participant < threshold; ++participant)
+            statistics.push_back(participants[participant].statistics);
+
+        return statistics;
     }
 }
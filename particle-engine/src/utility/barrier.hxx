@@ -1,21 +1,59 @@
 #pragma once
 
+#include <cstdint>
+#include <cstddef>
 #include <atomic>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
 #include <condition_variable>
 
 
 namespace utility
 {
+    enum class barrier_kind : std::uint8_t {
+        // Mutex and condition variable.
+        blocking = 0,
+
+        // Lock-free arrival, a brief spin, then 'std::atomic::wait'.
+        hybrid
+    };
+
+    char const *to_string(barrier_kind kind) noexcept;
+
+    // ns.
+    struct barrier_statistics final {
+        std::uint64_t waits_count{0};
+
+        // From the arrival to the release.
+        std::int64_t total_wait{0};
+        std::int64_t max_wait{0};
+
+        // From the first arrival of the same generation to this one.
+        std::int64_t total_skew{0};
+        std::int64_t max_skew{0};
+    };
+
     class barrier {
     public:
-        barrier(std::size_t count) : count{count}, threshold{count}, generation{0}, drop_it{false} { }
+        barrier(std::size_t count, barrier_kind kind = barrier_kind::blocking);
 
         void wait();
 
+        // One thread at a time per participant.
+        void wait(std::size_t participant);
+
         void drop();
 
+        barrier_kind kind() const noexcept { return kind_; }
+
+        // Exact once the participants are done waiting.
+        std::vector<barrier_statistics> statistics() const;
+
     private:
+        barrier_kind kind_;
+
         std::mutex mutex;
         std::condition_variable cv;
 
@@ -24,5 +62,27 @@ namespace utility
         std::size_t generation;
 
         std::atomic_bool drop_it;
+
+        // The generation, or'ed with 'DROPPED_BIT' once dropped.
+        alignas(64) std::atomic_uint32_t state{0};
+        alignas(64) std::atomic_size_t remaining;
+
+        std::atomic_int64_t first_arrivals[2];
+
+        // Zero if more participants than hardware threads.
+        std::uint32_t spin_limit{0};
+
+        static std::uint32_t constexpr SPIN_LIMIT{1024};
+        static std::uint32_t constexpr DROPPED_BIT{1u << 31};
+
+        struct alignas(64) participant_statistics final {
+            barrier_statistics statistics;
+        };
+
+        std::unique_ptr<participant_statistics[]> participants;
+
+        // The first arrival of the generation, given the own one.
+        std::int64_t wait_blocking(std::int64_t arrival);
+        std::int64_t wait_hybrid(std::int64_t arrival);
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+
+namespace utility
+{
+    struct latency_summary final {
+        std::uint64_t count{0};
+
+        // ns; the percentiles are the middles of their buckets.
+        std::int64_t mean{0};
+        std::int64_t p50{0};
+        std::int64_t p90{0};
+        std::int64_t p99{0};
+        std::int64_t max{0};
+    };
+
+    // Log-linear histogram of durations, ns, within about 3% and allocation free.
+    class latency_histogram final {
+    public:
+
+        void record(std::int64_t value) noexcept
+        {
+            value = std::max(value, std::int64_t{0});
+
+            increment(buckets[bucket(static_cast<std::uint64_t>(value))]);
+            increment(count_);
+
+            sum.store(sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+
+            if (value > max.load(std::memory_order_relaxed))
+                max.store(value, std::memory_order_relaxed);
+        }
+
+        std::uint64_t count() const noexcept { return count_.load(std::memory_order_relaxed); }
+
+        // Zero if nothing was recorded.
+        std::int64_t percentile(double fraction) const noexcept
+        {
+            auto const count = this->count();
+
+            if (count == 0)
+                return 0;
+
+            auto const rank = std::max(static_cast<std::uint64_t>(std::ceil(std::clamp(fraction, 0., 1.) * static_cast<double>(count))), std::uint64_t{1});
+
+            std::uint64_t cumulative = 0;
+
+            for (auto index = 0u; index < BUCKETS_COUNT; ++index) {
+                cumulative += buckets[index].load(std::memory_order_relaxed);
+
+                if (cumulative >= rank)
+                    return std::min(middle(index), max.load(std::memory_order_relaxed));
+            }
+
+            return max.load(std::memory_order_relaxed);
+        }
+
+        latency_summary summary() const noexcept
+        {
+            auto const count = this->count();
+
+            return latency_summary{
+                count, count != 0 ? sum.load(std::memory_order_relaxed) / static_cast<std::int64_t>(count) : 0,
+                percentile(.50), percentile(.90), percentile(.99), max.load(std::memory_order_relaxed)
+            };
+        }
+
+    private:
+
+        static std::uint32_t constexpr SUB_BUCKET_BITS{4};
+        static std::uint32_t constexpr SUB_BUCKETS_COUNT{1u << SUB_BUCKET_BITS};
+
+        static std::uint32_t constexpr BUCKETS_COUNT{SUB_BUCKETS_COUNT * (64 - SUB_BUCKET_BITS + 1)};
+
+        std::array<std::atomic_uint64_t, BUCKETS_COUNT> buckets{};
+
+        std::atomic_uint64_t count_{0};
+        std::atomic_int64_t sum{0};
+        std::atomic_int64_t max{0};
+
+        static void increment(std::atomic_uint64_t &counter) noexcept
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        static std::uint32_t bucket(std::uint64_t value) noexcept
+        {
+            if (value < SUB_BUCKETS_COUNT)
+                return static_cast<std::uint32_t>(value);
+
+            auto const shift = static_cast<std::uint32_t>(std::bit_width(value)) - SUB_BUCKET_BITS - 1;
+
+            return (shift + 1) * SUB_BUCKETS_COUNT + static_cast<std::uint32_t>(value >> shift) - SUB_BUCKETS_COUNT;
+        }
+
+        static std::int64_t middle(std::uint32_t index) noexcept
+        {
+            if (index < SUB_BUCKETS_COUNT)
+                return index;
+
+            auto const shift = index / SUB_BUCKETS_COUNT - 1;
+            auto const lower = std::uint64_t{SUB_BUCKETS_COUNT + index % SUB_BUCKETS_COUNT} << shift;
+
+            return static_cast<std::int64_t>(lower + (std::uint64_t{1} << shift) / 2);
+        }
+    };
+}
@@ -0,0 +1,128 @@
+#include <system_error>
+#include <cerrno>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+    #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "mapped_file.hxx"
+
+
+namespace
+{
+#if defined(_WIN32)
+    [[noreturn]] void throw_last_error(std::string const &what)
+    {
+        throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), what);
+    }
+#else
+    [[noreturn]] void throw_last_error(std::string const &what)
+    {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+#endif
+}
+
+namespace utility
+{
+#if defined(_WIN32)
+    mapped_file::mapped_file(std::string const &path)
+    {
+        auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+        if (file == INVALID_HANDLE_VALUE)
+            throw_last_error("failed to open '" + path + "'");
+
+        LARGE_INTEGER file_size;
+
+        if (!GetFileSizeEx(file, &file_size)) {
+            CloseHandle(file);
+            throw_last_error("failed to get the size of '" + path + "'");
+        }
+
+        size_ = static_cast<std::size_t>(file_size.QuadPart);
+
+        // An empty file can not be mapped; it maps to nothing instead.
+        if (size_ == 0) {
+            CloseHandle(file);
+            return;
+        }
+
+        auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+        CloseHandle(file);
+
+        if (mapping == nullptr)
+            throw_last_error("failed to map '" + path + "'");
+
+        base = static_cast<std::byte const *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+        // The view keeps the mapping alive.
+        CloseHandle(mapping);
+
+        if (base == nullptr)
+            throw_last_error("failed to map '" + path + "'");
+    }
+
+    mapped_file::~mapped_file()
+    {
+        if (base != nullptr)
+            UnmapViewOfFile(base);
+    }
+#else
+    mapped_file::mapped_file(std::string const &path)
+    {
+        auto descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if (descriptor < 0)
+            throw_last_error("failed to open '" + path + "'");
+
+        struct stat status;
+
+        if (fstat(descriptor, &status) != 0) {
+            auto const error = errno;
+            close(descriptor);
+
+            throw std::system_error(error, std::generic_category(), "failed to get the size of '" + path + "'");
+        }
+
+        size_ = static_cast<std::size_t>(status.st_size);
+
+        // An empty file can not be mapped; it maps to nothing instead.
+        if (size_ == 0) {
+            close(descriptor);
+            return;
+        }
+
+        auto memory = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        auto const error = errno;
+
+        // The mapping keeps the file alive.
+        close(descriptor);
+
+        if (memory == MAP_FAILED)
+            throw std::system_error(error, std::generic_category(), "failed to map '" + path + "'");
+
+        base = static_cast<std::byte const *>(memory);
+
+#if defined(MADV_WILLNEED)
+        // Start reading the file in ahead of the first touches.
+        madvise(memory, size_, MADV_WILLNEED);
+#endif
+    }
+
+    mapped_file::~mapped_file()
+    {
+        if (base != nullptr)
+            munmap(const_cast<std::byte *>(base), size_);
+    }
+#endif
+}
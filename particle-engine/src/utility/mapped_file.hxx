@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+
+namespace utility
+{
+    // A whole file mapped read-only.
+    class mapped_file final {
+    public:
+
+        // Throws std::system_error on failure.
+        explicit mapped_file(std::string const &path);
+
+        ~mapped_file();
+
+        mapped_file(mapped_file const &) = delete;
+        mapped_file &operator= (mapped_file const &) = delete;
+
+        std::byte const *data() const noexcept { return base; }
+
+        std::size_t size() const noexcept { return size_; }
+
+    private:
+
+        std::byte const *base{nullptr};
+
+        std::size_t size_{0};
+    };
+}
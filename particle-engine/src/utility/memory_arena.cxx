@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <system_error>
+#include <cstdint>
+#include <cerrno>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+    #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+#include "memory_arena.hxx"
+
+
+namespace
+{
+    std::size_t round_up(std::size_t value, std::size_t alignment) noexcept
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+#if defined(_WIN32)
+    [[noreturn]] void throw_last_error(char const *what)
+    {
+        throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), what);
+    }
+#else
+    [[noreturn]] void throw_last_error(char const *what)
+    {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+#endif
+}
+
+namespace utility
+{
+    char const *to_string(page_policy policy) noexcept
+    {
+        switch (policy) {
+            case page_policy::transparent_huge:
+                return "transparent huge pages";
+
+            case page_policy::explicit_huge:
+                return "explicit huge pages";
+
+            default:
+                return "regular pages";
+        }
+    }
+
+#if defined(_WIN32)
+    std::size_t memory_arena::page_size_of(page_policy policy) noexcept
+    {
+        if (policy == page_policy::explicit_huge) {
+            if (auto const large_page_size = GetLargePageMinimum(); large_page_size != 0)
+                return large_page_size;
+        }
+
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+
+        return info.dwPageSize;
+    }
+
+    memory_arena::memory_arena(std::size_t size, page_policy policy)
+    {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+
+        page_size_ = info.dwPageSize;
+
+        // Large pages need the 'lock pages in memory' privilege.
+        if (policy == page_policy::explicit_huge) {
+            if (auto const large_page_size = GetLargePageMinimum(); large_page_size != 0) {
+                auto const large_size = round_up(size, large_page_size);
+
+                base = static_cast<std::byte *>(VirtualAlloc(nullptr, large_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+
+                if (base != nullptr) {
+                    size_ = large_size;
+                    page_size_ = large_page_size;
+                    policy_ = page_policy::explicit_huge;
+
+                    return;
+                }
+            }
+        }
+
+        // There are no transparent huge pages to ask for.
+        size_ = round_up(size, page_size_);
+        policy_ = page_policy::regular;
+
+        base = static_cast<std::byte *>(VirtualAlloc(nullptr, size_, MEM_RESERVE, PAGE_NOACCESS));
+
+        if (base == nullptr)
+            throw_last_error("failed to reserve the memory arena");
+    }
+
+    memory_arena::~memory_arena()
+    {
+        VirtualFree(base, 0, MEM_RELEASE);
+    }
+
+    void memory_arena::commit(void *begin, std::size_t size)
+    {
+        if (size == 0 || policy_ == page_policy::explicit_huge)
+            return;
+
+        auto const offset = static_cast<std::size_t>(static_cast<std::byte *>(begin) - base);
+
+        auto const first = offset / page_size_ * page_size_;
+        auto const last = std::min(round_up(offset + size, page_size_), size_);
+
+        if (VirtualAlloc(base + first, last - first, MEM_COMMIT, PAGE_READWRITE) == nullptr)
+            throw_last_error("failed to commit the memory arena");
+    }
+#else
+    std::size_t memory_arena::page_size_of(page_policy policy) noexcept
+    {
+#if defined(MAP_HUGETLB)
+        if (policy == page_policy::explicit_huge)
+            return HUGE_PAGE_SIZE;
+#endif
+
+#if defined(MADV_HUGEPAGE)
+        if (policy != page_policy::regular)
+            return HUGE_PAGE_SIZE;
+#endif
+
+        return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    memory_arena::memory_arena(std::size_t size, page_policy policy)
+    {
+        page_size_ = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+
+#if defined(MAP_HUGETLB)
+        // No MAP_NORESERVE: a short pool fails here, not on first touch.
+        if (policy == page_policy::explicit_huge) {
+            auto const huge_size = round_up(size, HUGE_PAGE_SIZE);
+
+            if (auto memory = mmap(nullptr, huge_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0); memory != MAP_FAILED) {
+                base = static_cast<std::byte *>(memory);
+                size_ = huge_size;
+                page_size_ = HUGE_PAGE_SIZE;
+                policy_ = page_policy::explicit_huge;
+
+                return;
+            }
+        }
+#endif
+
+#if defined(MADV_HUGEPAGE)
+        auto const transparent = policy != page_policy::regular;
+#else
+        auto const transparent = false;
+#endif
+
+        // So every whole 2 MiB can be one huge page.
+        auto const alignment = transparent ? HUGE_PAGE_SIZE : page_size_;
+
+        size_ = round_up(size, alignment);
+
+        auto const mapped_size = size_ + alignment - page_size_;
+
+        auto memory = mmap(nullptr, mapped_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+        if (memory == MAP_FAILED)
+            throw_last_error("failed to reserve the memory arena");
+
+        auto const mapped = static_cast<std::byte *>(memory);
+        auto const address = reinterpret_cast<std::uintptr_t>(mapped);
+
+        base = mapped + (round_up(address, alignment) - address);
+
+        if (auto const head = static_cast<std::size_t>(base - mapped); head != 0)
+            munmap(mapped, head);
+
+        if (auto const tail = static_cast<std::size_t>(mapped + mapped_size - (base + size_)); tail != 0)
+            munmap(base + size_, tail);
+
+#if defined(MADV_HUGEPAGE)
+        if (transparent) {
+            madvise(base, size_, MADV_HUGEPAGE);
+
+            page_size_ = HUGE_PAGE_SIZE;
+            policy_ = page_policy::transparent_huge;
+        }
+#endif
+    }
+
+    memory_arena::~memory_arena()
+    {
+        munmap(base, size_);
+    }
+
+    void memory_arena::commit(void *begin, std::size_t size)
+    {
+        if (size == 0)
+            return;
+
+        auto const offset = static_cast<std::size_t>(static_cast<std::byte *>(begin) - base);
+
+        auto const first = offset / page_size_ * page_size_;
+        auto const last = std::min(round_up(offset + size, page_size_), size_);
+
+        if (mprotect(base + first, last - first, PROT_READ | PROT_WRITE) != 0)
+            throw_last_error("failed to commit the memory arena");
+    }
+#endif
+}
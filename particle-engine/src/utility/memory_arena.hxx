@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+
+namespace utility
+{
+    enum class page_policy : std::uint8_t {
+        regular,
+
+        // Transparent huge pages where the kernel has them.
+        transparent_huge,
+
+        // From the huge pages pool, or 'transparent_huge' if it can not serve.
+        explicit_huge
+    };
+
+    char const *to_string(page_policy policy) noexcept;
+
+    // Address space reserved up front and committed piece by piece.
+    class memory_arena final {
+    public:
+
+        static std::size_t constexpr HUGE_PAGE_SIZE{std::size_t{2} << 20};
+
+        // Throws std::system_error if the address space can not be reserved.
+        memory_arena(std::size_t size, page_policy policy);
+
+        ~memory_arena();
+
+        memory_arena(memory_arena const &) = delete;
+        memory_arena &operator= (memory_arena const &) = delete;
+
+        std::byte *data() const noexcept { return base; }
+
+        std::size_t size() const noexcept { return size_; }
+
+        // Commit granularity.
+        std::size_t page_size() const noexcept { return page_size_; }
+
+        // It may end up with regular pages instead.
+        static std::size_t page_size_of(page_policy policy) noexcept;
+
+        utility::page_policy policy() const noexcept { return policy_; }
+
+        // Thread-safe and idempotent; throws std::system_error when out of memory.
+        void commit(void *begin, std::size_t size);
+
+    private:
+
+        std::byte *base{nullptr};
+
+        std::size_t size_{0};
+        std::size_t page_size_{0};
+
+        utility::page_policy policy_{page_policy::regular};
+    };
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <bit>
+
+
+namespace utility
+{
+    // Bounded lock-free MPSC queue, after D. Vyukov's bounded MPMC queue.
+    template<class T>
+    class mpsc_queue final {
+    public:
+
+        // The capacity is rounded up to a power of two.
+        explicit mpsc_queue(std::size_t capacity)
+            : mask{std::bit_ceil(std::max(capacity, std::size_t{2})) - 1}, cells{std::make_unique<cell[]>(mask + 1)}
+        {
+            for (std::size_t i = 0; i <= mask; ++i)
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        std::size_t capacity() const noexcept { return mask + 1; }
+
+        // Any thread. Returns false if the queue is full.
+        bool try_push(T const &value) noexcept
+        {
+            auto position = enqueue_position.load(std::memory_order_relaxed);
+
+            for (;;) {
+                auto &&cell = cells[position & mask];
+
+                auto const sequence = cell.sequence.load(std::memory_order_acquire);
+                auto const difference = static_cast<std::int64_t>(sequence - position);
+
+                if (difference == 0) {
+                    if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                        break;
+                }
+
+                else if (difference < 0)
+                    return false;
+
+                else position = enqueue_position.load(std::memory_order_relaxed);
+            }
+
+            auto &&cell = cells[position & mask];
+
+            cell.value = value;
+            cell.sequence.store(position + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        // Consumer only.
+        bool try_pop(T &value) noexcept
+        {
+            auto &&cell = cells[dequeue_position & mask];
+
+            if (cell.sequence.load(std::memory_order_acquire) != dequeue_position + 1)
+                return false;
+
+            value = cell.value;
+            cell.sequence.store(dequeue_position + mask + 1, std::memory_order_release);
+
+            ++dequeue_position;
+
+            return true;
+        }
+
+        // Consumer only: the number of values popped so far.
+        std::uint64_t popped_count() const noexcept { return dequeue_position; }
+
+    private:
+
+        struct cell final {
+            std::atomic_uint64_t sequence;
+            T value;
+        };
+
+        std::size_t const mask;
+
+        std::unique_ptr<cell[]> cells;
+
+        alignas(64) std::atomic_uint64_t enqueue_position{0};
+
+        alignas(64) std::uint64_t dequeue_position{0};
+    };
+}
@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "profiler.hxx"
+
+
+namespace
+{
+    using namespace utility::profiling;
+
+    struct event final {
+        std::int64_t begin;
+        std::int64_t end;
+
+        zone zone_;
+    };
+
+    // Single writer: plain load-store pairs add up without read-modify-writes.
+    struct thread_record final {
+        std::uint32_t index;
+
+        // Under 'registry::mutex'.
+        std::string name;
+
+        std::array<std::atomic_uint64_t, ZONES_COUNT> zone_counts{};
+        std::array<std::atomic_int64_t, ZONES_COUNT> zone_times{};
+        std::array<std::atomic_int64_t, ZONES_COUNT> zone_max_times{};
+
+        std::array<std::atomic_uint64_t, COUNTERS_COUNT> counters{};
+
+        // 'events_count' only grows.
+        std::unique_ptr<event[]> events{std::make_unique<event[]>(EVENTS_PER_THREAD)};
+        std::atomic_uint64_t events_count{0};
+
+        std::array<std::uint64_t, ZONES_COUNT> summarized_zone_counts{};
+        std::array<std::int64_t, ZONES_COUNT> summarized_zone_times{};
+        std::array<std::uint64_t, COUNTERS_COUNT> summarized_counters{};
+
+        explicit thread_record(std::uint32_t index) : index{index}, name{"thread " + std::to_string(index)} { }
+    };
+
+    struct registry final {
+        std::mutex mutex;
+
+        // Outlive their threads, which are usually gone by the trace export.
+        std::vector<std::unique_ptr<thread_record>> records;
+    };
+
+    registry &get_registry()
+    {
+        static registry instance;
+        return instance;
+    }
+
+    auto const epoch = std::chrono::steady_clock::now();
+
+    thread_local thread_record *this_thread_record{nullptr};
+
+    thread_record &current_record()
+    {
+        if (this_thread_record == nullptr) {
+            auto &&registry = get_registry();
+
+            std::lock_guard<std::mutex> lock{registry.mutex};
+
+            auto const index = static_cast<std::uint32_t>(registry.records.size());
+
+            this_thread_record = registry.records.emplace_back(std::make_unique<thread_record>(index)).get();
+        }
+
+        return *this_thread_record;
+    }
+
+    template<class T, class U>
+    void add_relaxed(std::atomic<T> &value, U delta) noexcept
+    {
+        value.store(value.load(std::memory_order_relaxed) + static_cast<T>(delta), std::memory_order_relaxed);
+    }
+
+    std::string escape_json(std::string const &text)
+    {
+        std::string escaped;
+
+        for (auto c : text) {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+
+            escaped += c;
+        }
+
+        return escaped;
+    }
+}
+
+namespace utility::profiling
+{
+    char const *to_string(zone zone) noexcept
+    {
+        switch (zone) {
+            case zone::spawn_block:         return "spawn_block";
+            case zone::simulate_block:      return "simulate_block";
+            case zone::simulate_slice:      return "simulate_slice";
+            case zone::world_steps:         return "world_steps";
+            case zone::block_output_wait:   return "block_output_wait";
+            case zone::grid_count:          return "grid_count";
+            case zone::grid_scatter:        return "grid_scatter";
+            case zone::grid_sort:           return "grid_sort";
+            case zone::publish:             return "publish";
+            case zone::record_submit:       return "record_submit";
+            case zone::barrier_wait:        return "barrier_wait";
+            case zone::input_dispatch:      return "input_dispatch";
+
+            default:                        return "unknown";
+        }
+    }
+
+    char const *to_string(counter counter) noexcept
+    {
+        switch (counter) {
+            case counter::particles_integrated: return "particles_integrated";
+            case counter::particles_spawned:    return "particles_spawned";
+            case counter::particles_culled:     return "particles_culled";
+            case counter::particles_exploded:   return "particles_exploded";
+            case counter::particles_aged:       return "particles_aged";
+            case counter::particles_dropped:    return "particles_dropped";
+            case counter::block_output_spins:   return "block_output_spins";
+
+            default:                            return "unknown";
+        }
+    }
+
+    std::int64_t now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    void record(zone zone, std::int64_t begin, std::int64_t end) noexcept
+    {
+        auto &&record = current_record();
+
+        auto const index = static_cast<std::size_t>(zone);
+        auto const duration = end - begin;
+
+        add_relaxed(record.zone_counts[index], 1);
+        add_relaxed(record.zone_times[index], duration);
+
+        if (duration > record.zone_max_times[index].load(std::memory_order_relaxed))
+            record.zone_max_times[index].store(duration, std::memory_order_relaxed);
+
+        auto const events_count = record.events_count.load(std::memory_order_relaxed);
+
+        record.events[events_count % EVENTS_PER_THREAD] = event{begin, end, zone};
+        record.events_count.store(events_count + 1, std::memory_order_release);
+    }
+
+    void add(counter counter, std::uint64_t value) noexcept
+    {
+        add_relaxed(current_record().counters[static_cast<std::size_t>(counter)], value);
+    }
+
+    void set_thread_name(std::string name)
+    {
+        auto &&record = current_record();
+
+        std::lock_guard<std::mutex> lock{get_registry().mutex};
+
+        record.name = std::move(name);
+    }
+
+    std::vector<thread_summary> take_summary()
+    {
+        auto &&registry = get_registry();
+
+        std::lock_guard<std::mutex> lock{registry.mutex};
+
+        std::vector<thread_summary> summary;
+
+        for (auto &&record : registry.records) {
+            thread_summary thread{record->name};
+
+            auto active = false;
+
+            for (auto i = 0u; i < ZONES_COUNT; ++i) {
+                auto const count = record->zone_counts[i].load(std::memory_order_relaxed);
+                auto const time = record->zone_times[i].load(std::memory_order_relaxed);
+
+                thread.zones[i].count = count - std::exchange(record->summarized_zone_counts[i], count);
+                thread.zones[i].total_time = time - std::exchange(record->summarized_zone_times[i], time);
+                thread.zones[i].max_time = record->zone_max_times[i].load(std::memory_order_relaxed);
+
+                active = active || thread.zones[i].count != 0;
+            }
+
+            for (auto i = 0u; i < COUNTERS_COUNT; ++i) {
+                auto const value = record->counters[i].load(std::memory_order_relaxed);
+
+                thread.counters[i] = value - std::exchange(record->summarized_counters[i], value);
+
+                active = active || thread.counters[i] != 0;
+            }
+
+            if (active)
+                summary.push_back(std::move(thread));
+        }
+
+        return summary;
+    }
+
+    std::string format_summary(std::vector<thread_summary> const &summary, std::chrono::nanoseconds period)
+    {
+        std::ostringstream stream;
+        stream << std::fixed << std::setprecision(3);
+
+        auto const period_time = static_cast<double>(std::max(period.count(), std::int64_t{1}));
+
+        stream << std::left << std::setw(20) << "zone" << std::right << std::setw(10) << "calls" << std::setw(12) << "total ms"
+               << std::setw(10) << "busy %" << std::setw(12) << "mean us" << std::setw(12) << "max us" << '\n';
+
+        for (auto i = 0u; i < ZONES_COUNT; ++i) {
+            zone_statistics total;
+
+            for (auto &&thread : summary) {
+                total.count += thread.zones[i].count;
+                total.total_time += thread.zones[i].total_time;
+                total.max_time = std::max(total.max_time, thread.zones[i].max_time);
+            }
+
+            if (total.count == 0)
+                continue;
+
+            auto const total_time = static_cast<double>(total.total_time);
+
+            // Above 100% means more than one thread busy at a time.
+            stream << std::left << std::setw(20) << to_string(static_cast<zone>(i)) << std::right << std::setw(10) << total.count
+                   << std::setw(12) << total_time * 1e-6 << std::setw(10) << total_time / period_time * 100.
+                   << std::setw(12) << total_time / static_cast<double>(total.count) * 1e-3
+                   << std::setw(12) << static_cast<double>(total.max_time) * 1e-3 << '\n';
+        }
+
+        for (auto i = 0u; i < COUNTERS_COUNT; ++i) {
+            std::uint64_t total = 0;
+
+            for (auto &&thread : summary)
+                total += thread.counters[i];
+
+            if (total == 0)
+                continue;
+
+            stream << std::left << std::setw(22) << to_string(static_cast<counter>(i)) << std::right << std::setw(12) << total;
+
+            for (auto &&thread : summary) {
+                if (thread.counters[i] != 0)
+                    stream << "  " << thread.name << ": " << thread.counters[i];
+            }
+
+            stream << '\n';
+        }
+
+        return stream.str();
+    }
+
+    void write_chrome_trace(std::string const &path)
+    {
+        auto &&registry = get_registry();
+
+        std::lock_guard<std::mutex> lock{registry.mutex};
+
+        std::ofstream file{path};
+
+        file << std::fixed << std::setprecision(3);
+        file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+
+        auto first = true;
+
+        auto separator = [&file, &first]
+        {
+            file << (std::exchange(first, false) ? "" : ",\n");
+        };
+
+        for (auto &&record : registry.records) {
+            separator();
+            file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << record->index
+                 << ",\"args\":{\"name\":\"" << escape_json(record->name) << "\"}}";
+
+            auto const events_count = record->events_count.load(std::memory_order_acquire);
+
+            for (auto i = events_count - std::min<std::uint64_t>(events_count, EVENTS_PER_THREAD); i < events_count; ++i) {
+                auto &&event = record->events[i % EVENTS_PER_THREAD];
+
+                // Complete events, microseconds.
+                separator();
+                file << "{\"name\":\"" << to_string(event.zone_) << "\",\"cat\":\"engine\",\"ph\":\"X\",\"pid\":1,\"tid\":" << record->index
+                     << ",\"ts\":" << static_cast<double>(event.begin) * 1e-3 << ",\"dur\":" << static_cast<double>(event.end - event.begin) * 1e-3 << '}';
+            }
+        }
+
+        file << "\n]}\n";
+
+        if (!file)
+            throw std::runtime_error("failed to write '" + path + "'");
+    }
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <string>
+#include <array>
+#include <vector>
+
+
+// Hot path timers and counters; compiled out unless 'PARTICLE_ENGINE_PROFILING'.
+#ifndef PARTICLE_ENGINE_PROFILING
+    #define PARTICLE_ENGINE_PROFILING 0
+#endif
+
+#define PROFILE_CONCATENATE_IMPL(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_IMPL(a, b)
+
+#if PARTICLE_ENGINE_PROFILING
+    #define PROFILE_SCOPE(zone_name) \
+        utility::profiling::scoped_timer const PROFILE_CONCATENATE(profile_scope_, __LINE__){utility::profiling::zone::zone_name}
+
+    #define PROFILE_COUNT(counter_name, value) \
+        utility::profiling::add(utility::profiling::counter::counter_name, static_cast<std::uint64_t>(value))
+
+    #define PROFILE_THREAD_NAME(name) utility::profiling::set_thread_name(name)
+#else
+    // Keeps the arguments referenced, for unused warnings.
+    #define PROFILE_SCOPE(zone_name) static_cast<void>(0)
+    #define PROFILE_COUNT(counter_name, value) static_cast<void>(sizeof(value))
+    #define PROFILE_THREAD_NAME(name) static_cast<void>(sizeof(name))
+#endif
+
+
+namespace utility::profiling
+{
+    enum class zone : std::uint8_t {
+        spawn_block = 0,
+        simulate_block,
+        simulate_slice,
+        world_steps,
+        block_output_wait,
+        grid_count,
+        grid_scatter,
+        grid_sort,
+        publish,
+        record_submit,
+        barrier_wait,
+        input_dispatch,
+
+        count
+    };
+
+    enum class counter : std::uint8_t {
+        particles_integrated = 0,
+        particles_spawned,
+        // Particles a step did not carry over, and the exploding ones of them.
+        particles_culled,
+        particles_exploded,
+
+        // Death times tested, in buckets the expiry index could not rule out.
+        particles_aged,
+
+        // Particles evicted because a frame was at capacity.
+        particles_dropped,
+
+        // Spin iterations waiting for the predecessor's output offset.
+        block_output_spins,
+
+        count
+    };
+
+    auto constexpr ZONES_COUNT = static_cast<std::size_t>(zone::count);
+    auto constexpr COUNTERS_COUNT = static_cast<std::size_t>(counter::count);
+
+    char const *to_string(zone zone) noexcept;
+    char const *to_string(counter counter) noexcept;
+
+    // ns since the profiling epoch.
+    std::int64_t now() noexcept;
+
+    void record(zone zone, std::int64_t begin, std::int64_t end) noexcept;
+
+    void add(counter counter, std::uint64_t value) noexcept;
+
+    void set_thread_name(std::string name);
+
+    class scoped_timer final {
+    public:
+
+        explicit scoped_timer(zone zone) noexcept : zone_{zone}, begin{now()} { }
+
+        ~scoped_timer() { record(zone_, begin, now()); }
+
+        scoped_timer(scoped_timer const &) = delete;
+        scoped_timer &operator= (scoped_timer const &) = delete;
+
+    private:
+
+        zone zone_;
+        std::int64_t begin;
+    };
+
+    struct zone_statistics final {
+        std::uint64_t count{0};
+        std::int64_t total_time{0}; // ns
+        std::int64_t max_time{0}; // ns, over the whole run
+    };
+
+    struct thread_summary final {
+        std::string name;
+
+        std::array<zone_statistics, ZONES_COUNT> zones{};
+        std::array<std::uint64_t, COUNTERS_COUNT> counters{};
+    };
+
+    // Since the previous call; one caller at a time.
+    std::vector<thread_summary> take_summary();
+
+    std::string format_summary(std::vector<thread_summary> const &summary, std::chrono::nanoseconds period);
+
+    // Chrome trace event JSON; throws std::runtime_error on failure.
+    void write_chrome_trace(std::string const &path);
+
+    // Older ones are overwritten.
+    auto constexpr EVENTS_PER_THREAD = std::size_t{1} << 16;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+#endif
+
+
+namespace utility
+{
+    // Frees pipeline resources for the sibling hyper-thread.
+    inline void cpu_relax() noexcept
+    {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        asm volatile("yield");
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    // Pauses first, then yields, not to starve the thread it waits for.
+    class spin_wait final {
+    public:
+
+        void operator() () noexcept
+        {
+            if (iterations_ < SPIN_LIMIT) {
+                ++iterations_;
+                cpu_relax();
+            }
+
+            else std::this_thread::yield();
+        }
+
+        std::uint32_t iterations() const noexcept { return iterations_; }
+
+    private:
+
+        static std::uint32_t constexpr SPIN_LIMIT{64};
+
+        std::uint32_t iterations_{0};
+    };
+}
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+    #define NOMINMAX
+    #endif
+    #include <windows.h>
+#elif defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+#include "topology.hxx"
+
+
+namespace
+{
+    std::uint32_t parse_cpu(std::string_view list, std::string_view value)
+    {
+        std::uint32_t cpu = 0;
+
+        if (auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), cpu); ec != std::errc{} || ptr != value.data() + value.size())
+            throw std::invalid_argument("invalid CPU list '" + std::string{list} + "'");
+
+        return cpu;
+    }
+
+#if defined(__linux__)
+    // The first line of a sysfs file, or nothing.
+    std::string read_line(std::string const &path)
+    {
+        std::ifstream file{path};
+        std::string line;
+
+        std::getline(file, line);
+
+        return line;
+    }
+#endif
+}
+
+namespace utility
+{
+    std::vector<std::uint32_t> parse_cpu_list(std::string_view list)
+    {
+        std::vector<std::uint32_t> cpus;
+
+        while (!list.empty() && (list.back() == '\n' || list.back() == ' '))
+            list.remove_suffix(1);
+
+        for (std::size_t begin = 0, end = 0; begin < list.size(); begin = end + 1) {
+            end = std::min(list.find(',', begin), list.size());
+
+            auto const range = list.substr(begin, end - begin);
+            auto const dash = range.find('-');
+
+            auto const first = parse_cpu(list, range.substr(0, dash));
+            auto const last = dash == std::string_view::npos ? first : parse_cpu(list, range.substr(dash + 1));
+
+            if (last < first)
+                throw std::invalid_argument("invalid CPU list '" + std::string{list} + "'");
+
+            for (auto cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(cpu);
+        }
+
+        std::sort(std::begin(cpus), std::end(cpus));
+        cpus.erase(std::unique(std::begin(cpus), std::end(cpus)), std::end(cpus));
+
+        return cpus;
+    }
+
+    std::vector<std::uint32_t> available_cpus()
+    {
+        std::vector<std::uint32_t> cpus;
+
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (auto cpu = 0u; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &set))
+                    cpus.push_back(cpu);
+            }
+        }
+#endif
+
+        if (cpus.empty()) {
+            for (auto cpu = 0u; cpu < std::max(std::thread::hardware_concurrency(), 1u); ++cpu)
+                cpus.push_back(cpu);
+        }
+
+        return cpus;
+    }
+
+    std::vector<numa_node> numa_nodes()
+    {
+        auto const cpus = available_cpus();
+
+        std::vector<numa_node> nodes;
+
+#if defined(__linux__)
+        try {
+            for (auto index : parse_cpu_list(read_line("/sys/devices/system/node/online"))) {
+                auto const node_cpus = parse_cpu_list(read_line("/sys/devices/system/node/node" + std::to_string(index) + "/cpulist"));
+
+                numa_node node{index, {}};
+
+                std::set_intersection(std::cbegin(cpus), std::cend(cpus), std::cbegin(node_cpus), std::cend(node_cpus), std::back_inserter(node.cpus));
+
+                if (!node.cpus.empty())
+                    nodes.push_back(std::move(node));
+            }
+        }
+
+        catch (std::invalid_argument const &) {
+            nodes.clear();
+        }
+#endif
+
+        if (nodes.empty())
+            nodes.push_back(numa_node{0, cpus});
+
+        return nodes;
+    }
+
+    std::vector<numa_node> emulate_numa_nodes(std::uint32_t nodes_count, std::vector<std::uint32_t> const &cpus)
+    {
+        nodes_count = std::max(nodes_count, 1u);
+
+        auto const cpus_count = static_cast<std::uint32_t>(cpus.size());
+
+        std::vector<numa_node> nodes(nodes_count);
+
+        for (auto index = 0u; index < nodes_count; ++index) {
+            nodes[index].index = index;
+
+            auto const first = index * cpus_count / nodes_count;
+            auto const last = std::max((index + 1) * cpus_count / nodes_count, first + 1);
+
+            for (auto i = first; i < last && i < cpus_count; ++i)
+                nodes[index].cpus.push_back(cpus[i]);
+
+            if (nodes[index].cpus.empty() && cpus_count != 0)
+                nodes[index].cpus.push_back(cpus[index % cpus_count]);
+        }
+
+        return nodes;
+    }
+
+    bool pin_current_thread(std::vector<std::uint32_t> const &cpus) noexcept
+    {
+        if (cpus.empty())
+            return false;
+
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+
+        for (auto cpu : cpus) {
+            if (cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &set);
+        }
+
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+        DWORD_PTR mask = 0;
+
+        // The first processor group only.
+        for (auto cpu : cpus) {
+            if (cpu < sizeof(mask) * 8)
+                mask |= DWORD_PTR{1} << cpu;
+        }
+
+        return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+        return false;
+#endif
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+
+namespace utility
+{
+    struct numa_node final {
+        std::uint32_t index{0};
+
+        // Of the CPUs the process may run on.
+        std::vector<std::uint32_t> cpus;
+    };
+
+    // Ascending.
+    std::vector<std::uint32_t> available_cpus();
+
+    // From sysfs on Linux; a single node otherwise.
+    std::vector<numa_node> numa_nodes();
+
+    // Even, contiguous groups of 'cpus', to emulate NUMA nodes.
+    std::vector<numa_node> emulate_numa_nodes(std::uint32_t nodes_count, std::vector<std::uint32_t> const &cpus);
+
+    // E.g. '0-3,8,10-11'; throws std::invalid_argument if malformed.
+    std::vector<std::uint32_t> parse_cpu_list(std::string_view list);
+
+    // False if the host does not let it.
+    bool pin_current_thread(std::vector<std::uint32_t> const &cpus) noexcept;
+}
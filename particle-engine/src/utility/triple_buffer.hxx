@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+
+
+namespace utility
+{
+    // Wait-free SPSC publication of three user owned slots.
+    class triple_buffer final {
+    public:
+
+        static std::uint32_t constexpr SLOTS_COUNT{3};
+
+        // Slot 'initial' is published from the start.
+        explicit triple_buffer(std::uint32_t initial = 0) noexcept
+            : middle{initial | FRESH_BIT}, back_{(initial + 1) % SLOTS_COUNT}, published_{initial}, front_{(initial + 2) % SLOTS_COUNT} { }
+
+        // Producer only.
+        std::uint32_t back() const noexcept { return back_; }
+
+        // Producer only; read-only.
+        std::uint32_t published() const noexcept { return published_; }
+
+        // Producer only: returns the new 'back' slot.
+        std::uint32_t publish() noexcept
+        {
+            published_ = back_;
+            back_ = middle.exchange(back_ | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+
+            return back_;
+        }
+
+        // Consumer only: the newest published slot.
+        std::uint32_t acquire() noexcept
+        {
+            if ((middle.load(std::memory_order_relaxed) & FRESH_BIT) != 0)
+                front_ = middle.exchange(front_, std::memory_order_acq_rel) & INDEX_MASK;
+
+            return front_;
+        }
+
+        // Consumer only.
+        std::uint32_t front() const noexcept { return front_; }
+
+    private:
+
+        static std::uint32_t constexpr FRESH_BIT{0x4};
+        static std::uint32_t constexpr INDEX_MASK{0x3};
+
+        alignas(64) std::atomic_uint32_t middle;
+
+        alignas(64) std::uint32_t back_;
+        std::uint32_t published_;
+
+        alignas(64) std::uint32_t front_;
+    };
+}
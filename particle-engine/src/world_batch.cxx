@@ -0,0 +1,94 @@
+#include <stdexcept>
+
+#include "world_batch.hxx"
+#include "utility/profiler.hxx"
+
+
+namespace app
+{
+    world_batch::world_batch(std::uint32_t worlds_count, app::engine_config const &config)
+    {
+        if (worlds_count == 0)
+            throw std::invalid_argument("a batch needs a world at least");
+
+        if (config.numa_aware)
+            throw std::invalid_argument("batched worlds run on any worker, there are no NUMA slices");
+
+        arena = std::make_unique<utility::memory_arena>(worlds_count * particle_engine::frames_size(config, utility::memory_arena::page_size_of(config.page_policy)),
+                                                        config.page_policy);
+
+        // By the pages the arena got, which may be smaller than asked for.
+        auto const segment_size = particle_engine::frames_size(config, arena->page_size());
+
+        auto const workers_count = config.workers_count != 0 ? config.workers_count
+                                 : !config.cpus.empty() ? static_cast<std::uint32_t>(config.cpus.size()) : particle_engine::default_workers_count();
+
+        std::vector<std::vector<std::uint32_t>> worker_cpus;
+
+        for (auto worker_index = 0u; worker_index < workers_count && !config.cpus.empty(); ++worker_index)
+            worker_cpus.push_back({config.cpus[worker_index % config.cpus.size()]});
+
+        pool = std::make_unique<jobs::job_system>(workers_count, worker_cpus);
+
+        worker_contexts.reserve(workers_count);
+
+        for (auto worker_index = 0u; worker_index < workers_count; ++worker_index)
+            worker_contexts.emplace_back(worker_index);
+
+        worlds.reserve(worlds_count);
+
+        for (auto world_index = 0u; world_index < worlds_count; ++world_index)
+            worlds.emplace_back(new app::particle_engine{config, pool.get(), arena.get(), world_index * segment_size});
+
+        run_task = jobs::make_task(
+            [this] (std::uint32_t begin, std::uint32_t end, std::uint32_t worker_index)
+            {
+                auto steps_count = std::uint64_t{0};
+
+                for (auto world_index = begin; world_index < end; ++world_index) {
+                    PROFILE_SCOPE(world_steps);
+
+                    steps_count += worlds[world_index]->run_steps(worker_contexts[worker_index]);
+                }
+
+                run_steps_count.fetch_add(steps_count, std::memory_order_relaxed);
+            },
+            [this] (std::uint32_t)
+            {
+                runs_count.fetch_add(1, std::memory_order_release);
+                runs_count.notify_one();
+            }
+        );
+    }
+
+    std::uint64_t world_batch::update(std::chrono::nanoseconds dt)
+    {
+        for (auto &&world : worlds)
+            world->update(dt);
+
+        return run();
+    }
+
+    std::uint64_t world_batch::run()
+    {
+        auto const runs = runs_count.load(std::memory_order_relaxed);
+
+        run_steps_count.store(0, std::memory_order_relaxed);
+
+        pool->submit(*run_task, worlds_count());
+
+        runs_count.wait(runs, std::memory_order_acquire);
+
+        return run_steps_count.load(std::memory_order_relaxed);
+    }
+
+    memory_statistics world_batch::memory_stats() const noexcept
+    {
+        memory_statistics stats{arena->size(), 0, arena->policy()};
+
+        for (auto &&world : worlds)
+            stats.committed_bytes += world->memory_stats().committed_bytes;
+
+        return stats;
+    }
+}
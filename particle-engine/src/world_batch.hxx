@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "particle_engine.hxx"
+
+
+namespace app
+{
+    // Many small worlds on one pool, each stepped whole by the worker that picks it.
+    class world_batch final {
+    public:
+
+        // Throws std::invalid_argument with 'numa_aware' or no world.
+        world_batch(std::uint32_t worlds_count, app::engine_config const &config = {});
+
+        world_batch(world_batch const &) = delete;
+        world_batch &operator= (world_batch const &) = delete;
+
+        // Its steps wait for 'run'.
+        app::particle_engine &world(std::uint32_t index) noexcept { return *worlds[index]; }
+
+        std::uint32_t worlds_count() const noexcept { return static_cast<std::uint32_t>(worlds.size()); }
+
+        std::uint64_t update(std::chrono::nanoseconds dt);
+
+        // Returns the steps run; not from a pool worker.
+        std::uint64_t run();
+
+        std::uint32_t workers_count() const noexcept { return pool->workers_count(); }
+
+        memory_statistics memory_stats() const noexcept;
+
+        jobs::job_system &job_system() noexcept { return *pool; }
+
+    private:
+
+        std::unique_ptr<utility::memory_arena> arena;
+
+        std::unique_ptr<jobs::job_system> pool;
+
+        // Lent to the world a worker runs.
+        std::vector<app::worker_context> worker_contexts;
+
+        std::vector<std::unique_ptr<app::particle_engine>> worlds;
+
+        std::unique_ptr<jobs::task> run_task;
+
+        std::atomic_uint64_t run_steps_count{0};
+
+        std::atomic_uint32_t runs_count{0};
+    };
+}